@@ -0,0 +1,100 @@
+#include "dynet/beam-search.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "dynet/except.h"
+#include "dynet/tensor.h"
+
+using namespace std;
+
+namespace dynet {
+
+using namespace expr;
+
+BeamSearchDecoder::BeamSearchDecoder(RNNBuilder& rnn, EmbedFunction embed, LogProbFunction log_probs,
+                                     unsigned beam_size, unsigned eos, unsigned max_len) :
+  rnn(rnn), embed(embed), log_probs(log_probs), beam_size(beam_size), eos(eos), max_len(max_len) {
+  DYNET_ARG_CHECK(beam_size > 0, "BeamSearchDecoder needs a beam size of at least 1");
+}
+
+vector<BeamHypothesis> BeamSearchDecoder::decode(ComputationGraph& cg, unsigned sos, const vector<Expression>& h_0) {
+  vector<BeamHypothesis> live(1), finished;
+  live[0].score = 0.f;
+  vector<unsigned> prev_words(1, sos);
+  // The RNN state of the live hypotheses is carried from one step to the
+  // next on the host, with the hypotheses along the batch dimension, since
+  // everything the step computed is reverted
+  vector<Dim> state_dims;
+  vector<vector<float>> state_vals;
+  for (unsigned t = 0; t < max_len && !live.empty() && finished.size() < beam_size; ++t) {
+    const unsigned n = live.size();
+    cg.checkpoint();
+    if (t == 0) {
+      rnn.start_new_sequence(h_0);
+    } else {
+      vector<Expression> s(state_vals.size());
+      for (unsigned k = 0; k < s.size(); ++k)
+        s[k] = input(cg, state_dims[k], state_vals[k]);
+      rnn.start_new_sequence(s);
+    }
+    Expression lp = log_probs(rnn.add_input(embed(cg, prev_words)));
+    const Tensor& lp_value = cg.incremental_forward(lp);
+    DYNET_ARG_CHECK(lp_value.d.nd == 1 && lp_value.d.bd == n,
+                    "BeamSearchDecoder expected log probabilities with " << n << " batch elements, but got " << lp_value.d);
+
+    // The best continuations of the beam are among the best continuations
+    // of each hypothesis
+    const unsigned k = std::min(beam_size, lp_value.d[0]);
+    pair<Tensor, IndexTensor> top = TensorTools::topk(lp_value, k);
+    vector<float> top_lps = as_vector(top.first);
+    vector<Eigen::DenseIndex> top_words = as_vector(top.second);
+    vector<float> scores(n * k);
+    for (unsigned i = 0; i < n * k; ++i)
+      scores[i] = live[i / k].score + top_lps[i];
+    vector<unsigned> order(n * k);
+    iota(order.begin(), order.end(), 0);
+    const unsigned m = std::min(beam_size, n * k);
+    partial_sort(order.begin(), order.begin() + m, order.end(),
+                 [&scores](unsigned a, unsigned b) { return scores[a] > scores[b]; });
+
+    vector<BeamHypothesis> next;
+    vector<unsigned> parents;
+    prev_words.clear();
+    for (unsigned j = 0; j < m; ++j) {
+      const unsigned parent = order[j] / k, word = top_words[order[j]];
+      BeamHypothesis hyp = {live[parent].words, scores[order[j]]};
+      hyp.words.push_back(word);
+      if (word == eos) {
+        finished.push_back(hyp);
+      } else {
+        next.push_back(hyp);
+        parents.push_back(parent);
+        prev_words.push_back(word);
+      }
+    }
+    if (!next.empty() && t + 1 < max_len) {
+      vector<Expression> s = rnn.final_s();
+      state_dims.resize(s.size());
+      state_vals.resize(s.size());
+      for (unsigned i = 0; i < s.size(); ++i) {
+        Expression picked = pick_batch_elems(s[i], parents);
+        state_vals[i] = as_vector(cg.incremental_forward(picked));
+        state_dims[i] = picked.dim();
+      }
+    }
+    cg.revert();
+    live.swap(next);
+  }
+
+  // Unfinished hypotheses only make up for missing finished ones
+  if (finished.size() < beam_size)
+    finished.insert(finished.end(), live.begin(), live.end());
+  stable_sort(finished.begin(), finished.end(),
+              [](const BeamHypothesis& a, const BeamHypothesis& b) { return a.score > b.score; });
+  if (finished.size() > beam_size)
+    finished.resize(beam_size);
+  return finished;
+}
+
+} // namespace dynet
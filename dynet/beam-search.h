@@ -0,0 +1,91 @@
+/**
+ * \file beam-search.h
+ * \brief Batched beam search over an RNNBuilder
+ *
+ * All the live hypotheses of the beam are packed into the batch dimension,
+ * so every decoding step is a single batched RNN step followed by a single
+ * batched output layer. The best continuations of every hypothesis are found
+ * with TensorTools::topk, and the states of the survivors are gathered with
+ * pick_batch_elems. Each step is built between ComputationGraph::checkpoint()
+ * and revert(), so the graph does not grow with the length of the output.
+ */
+
+#ifndef DYNET_BEAM_SEARCH_H_
+#define DYNET_BEAM_SEARCH_H_
+
+#include <functional>
+#include <vector>
+
+#include "dynet/dynet.h"
+#include "dynet/expr.h"
+#include "dynet/rnn.h"
+
+namespace dynet {
+
+/**
+ * \brief A complete or partial output of the decoder
+ */
+struct BeamHypothesis {
+  std::vector<unsigned> words; /**< Output words, starting after the start symbol and including the end symbol if it was reached */
+  float score; /**< Sum of the log probabilities of the words */
+};
+
+/**
+ * \brief Beam search decoder with one batched RNN step per output position
+ * \details The RNN is fed the embedding of the previous word, and the output
+ *          layer maps its output to log probabilities over the vocabulary.
+ *          Both are given as functions over batches:
+ *
+ *          - `embed(cg, words)` returns the inputs of the RNN for a batch of
+ *            previous words, with one batch element per word,
+ *          - `log_probs(h)` returns the log probabilities of the next word,
+ *            {V} with one batch element per batch element of h.
+ *
+ *          Everything built during a step is discarded when the step ends, so
+ *          any expression the two functions capture (e.g. parameters) must
+ *          be created before calling decode().
+ */
+class BeamSearchDecoder {
+ public:
+  typedef std::function<expr::Expression(ComputationGraph&, const std::vector<unsigned>&)> EmbedFunction;
+  typedef std::function<expr::Expression(const expr::Expression&)> LogProbFunction;
+
+  /**
+   * \param rnn RNN builder to decode with
+   * \param embed Embeds a batch of previous words
+   * \param log_probs Output layer, returning log probabilities
+   * \param beam_size Number of hypotheses to keep
+   * \param eos End of sequence symbol
+   * \param max_len Maximum number of words in an output, end symbol included
+   */
+  BeamSearchDecoder(RNNBuilder& rnn, EmbedFunction embed, LogProbFunction log_probs,
+                    unsigned beam_size, unsigned eos, unsigned max_len);
+
+  /**
+   * \brief Decode one sequence
+   * \details `rnn.new_graph(cg)` must have been called. On return, the RNN
+   *          holds no usable state.
+   *
+   * \param cg Computation graph
+   * \param sos Start of sequence symbol, fed as the first input
+   * \param h_0 Initial state of the RNN, as for `start_new_sequence`
+   *
+   * \return Up to beam_size hypotheses, best first. Hypotheses that did not
+   *         reach the end symbol within max_len words are included if there
+   *         are not enough finished ones.
+   */
+  std::vector<BeamHypothesis> decode(ComputationGraph& cg, unsigned sos,
+                                     const std::vector<expr::Expression>& h_0 = {});
+
+ private:
+  RNNBuilder& rnn;
+  EmbedFunction embed;
+  LogProbFunction log_probs;
+  unsigned beam_size;
+  unsigned eos;
+  unsigned max_len;
+};
+
+} // namespace dynet
+
+#endif
@@ -1,6 +1,9 @@
 #include "dynet/cfsm-builder.h"
+#include "dynet/devices.h"
 #include "dynet/except.h"
+#include "dynet/globals.h"
 
+#include <cmath>
 #include <fstream>
 #include <iostream>
 
@@ -17,6 +20,31 @@ inline bool not_ws(char x) { return (x != ' ' && x != '\t'); }
 
 SoftmaxBuilder::~SoftmaxBuilder() {}
 
+Expression SoftmaxBuilder::neg_log_softmax(const Expression& rep, const vector<unsigned>& wordidxs) {
+  const unsigned bd = rep.dim().bd;
+  DYNET_ARG_CHECK(bd == 1 || bd == wordidxs.size(),
+                  "Number of words (" << wordidxs.size() << ") does not match the batch size of " << rep.dim() << " in SoftmaxBuilder::neg_log_softmax");
+  vector<Expression> losses(wordidxs.size());
+  for (unsigned i = 0; i < wordidxs.size(); ++i)
+    losses[i] = neg_log_softmax(bd == 1 ? rep : pick_batch_elem(rep, i), wordidxs[i]);
+  return concatenate_to_batch(losses);
+}
+
+Expression SoftmaxBuilder::merge_batch_elems(const vector<Expression>& parts,
+                                             const vector<vector<unsigned>>& positions) {
+  vector<unsigned> order;
+  for (auto& pos : positions)
+    order.insert(order.end(), pos.begin(), pos.end());
+  vector<unsigned> inverse(order.size());
+  bool in_order = true;
+  for (unsigned k = 0; k < order.size(); ++k) {
+    inverse[order[k]] = k;
+    in_order = in_order && order[k] == k;
+  }
+  Expression merged = (parts.size() == 1 ? parts[0] : concatenate_to_batch(parts));
+  return in_order ? merged : pick_batch_elems(merged, inverse);
+}
+
 StandardSoftmaxBuilder::StandardSoftmaxBuilder() {}
 
 StandardSoftmaxBuilder::StandardSoftmaxBuilder(unsigned rep_dim, unsigned vocab_size, Model& model) {
@@ -31,22 +59,24 @@ void StandardSoftmaxBuilder::new_graph(ComputationGraph& cg) {
 }
 
 Expression StandardSoftmaxBuilder::neg_log_softmax(const Expression& rep, unsigned wordidx) {
+  // The fused node never stores the scores of the whole vocabulary, but it
+  // only has a CPU implementation
+  if (default_device->type == DeviceType::CPU)
+    return affine_pickneglogsoftmax(b, w, rep, wordidx);
   return pickneglogsoftmax(affine_transform({b, w, rep}), wordidx);
 }
 
+Expression StandardSoftmaxBuilder::neg_log_softmax(const Expression& rep, const vector<unsigned>& wordidxs) {
+  if (default_device->type == DeviceType::CPU)
+    return affine_pickneglogsoftmax(b, w, rep, wordidxs);
+  return pickneglogsoftmax(affine_transform({b, w, rep}), wordidxs);
+}
+
 unsigned StandardSoftmaxBuilder::sample(const Expression& rep) {
-  Expression dist_expr = softmax(affine_transform({b, w, rep}));
-  vector<float> dist = as_vector(pcg->incremental_forward(dist_expr));
-  unsigned c = 0;
-  double p = rand01();
-  for (; c < dist.size(); ++c) {
-    p -= dist[c];
-    if (p < 0.0) { break; }
-  }
-  if (c == dist.size()) {
-    --c;
-  }
-  return c;
+  // Sample straight from the scores on the device, without normalizing them
+  // or copying them out
+  Expression scores = affine_transform({b, w, rep});
+  return as_vector(TensorTools::categorical_sample_log_prob(pcg->incremental_forward(scores)))[0];
 }
 
 Expression StandardSoftmaxBuilder::full_log_distribution(const Expression& rep) {
@@ -109,31 +139,66 @@ Expression ClassFactoredSoftmaxBuilder::neg_log_softmax(const Expression& rep, u
   return cnlp + wnlp;
 }
 
+Expression ClassFactoredSoftmaxBuilder::neg_log_softmax(const Expression& rep, const vector<unsigned>& wordidxs) {
+  const unsigned bd = wordidxs.size();
+  DYNET_ARG_CHECK(rep.dim().bd == 1 || rep.dim().bd == bd,
+                  "Number of words (" << bd << ") does not match the batch size of " << rep.dim() << " in ClassFactoredSoftmaxBuilder::neg_log_softmax");
+  // Group the batch elements by cluster, in order of first appearance.
+  // Singleton clusters need no word-level prediction.
+  vector<unsigned> clusteridxs(bd);
+  vector<int> cidx2group(cdict.size(), -1);
+  vector<unsigned> group2cidx;
+  vector<vector<unsigned>> positions;
+  vector<unsigned> singletons;
+  for (unsigned i = 0; i < bd; ++i) {
+    int clusteridx = (wordidxs[i] < widx2cidx.size() ? widx2cidx[wordidxs[i]] : -1);
+    DYNET_ARG_CHECK(clusteridx >= 0,
+                            "Word ID " << wordidxs[i] << " missing from clusters in ClassFactoredSoftmaxBuilder::neg_log_softmax");
+    clusteridxs[i] = clusteridx;
+    if (singleton_cluster[clusteridx]) {
+      singletons.push_back(i);
+      continue;
+    }
+    if (cidx2group[clusteridx] < 0) {
+      cidx2group[clusteridx] = positions.size();
+      group2cidx.push_back(clusteridx);
+      positions.push_back(vector<unsigned>());
+    }
+    positions[cidx2group[clusteridx]].push_back(i);
+  }
+  Expression h = rep;
+  if (bd > 1 && rep.dim().bd == 1)
+    h = concatenate_to_batch(vector<Expression>(bd, rep));
+  Expression cnlp = pickneglogsoftmax(affine_transform({cbias, r2c, h}), clusteridxs);
+  if (positions.empty()) return cnlp;
+
+  vector<Expression> wnlps;
+  for (unsigned g = 0; g < positions.size(); ++g) {
+    const unsigned c = group2cidx[g];
+    vector<unsigned> wordrows;
+    for (auto i : positions[g])
+      wordrows.push_back(widx2cwidx[wordidxs[i]]);
+    Expression hc = (positions[g].size() == bd ? h : pick_batch_elems(h, positions[g]));
+    Expression wscores = affine_transform({get_rc2wbias(c), get_rc2w(c), hc});
+    wnlps.push_back(pickneglogsoftmax(wscores, wordrows));
+  }
+  if (!singletons.empty()) {
+    wnlps.push_back(zeroes(*pcg, Dim({1}, singletons.size())));
+    positions.push_back(singletons);
+  }
+  return cnlp + merge_batch_elems(wnlps, positions);
+}
+
 unsigned ClassFactoredSoftmaxBuilder::sample(const Expression& rep) {
   // TODO check that new_graph has been called
   Expression cscores = affine_transform({cbias, r2c, rep});
-  Expression cdist_expr = softmax(cscores);
-  auto cdist = as_vector(pcg->incremental_forward(cdist_expr));
-  unsigned c = 0;
-  double p = rand01();
-  for (; c < cdist.size(); ++c) {
-    p -= cdist[c];
-    if (p < 0.0) { break; }
-  }
-  if (c == cdist.size()) --c;
+  unsigned c = as_vector(TensorTools::categorical_sample_log_prob(pcg->incremental_forward(cscores)))[0];
   unsigned w = 0;
   if (!singleton_cluster[c]) {
     Expression& cwbias = get_rc2wbias(c);
     Expression& r2cw = get_rc2w(c);
     Expression wscores = affine_transform({cwbias, r2cw, rep});
-    Expression wdist_expr = softmax(wscores);
-    auto wdist = as_vector(pcg->incremental_forward(wdist_expr));
-    p = rand01();
-    for (; w < wdist.size(); ++w) {
-      p -= wdist[w];
-      if (p < 0.0) { break; }
-    }
-    if (w == wdist.size()) --w;
+    w = as_vector(TensorTools::categorical_sample_log_prob(pcg->incremental_forward(wscores)))[0];
   }
   return cidx2words[c][w];
 }
@@ -228,7 +293,121 @@ void ClassFactoredSoftmaxBuilder::initialize_expressions() {
 
 DYNET_SERIALIZE_IMPL(ClassFactoredSoftmaxBuilder)
 
+SampledSoftmaxBuilder::SampledSoftmaxBuilder() {}
+
+SampledSoftmaxBuilder::SampledSoftmaxBuilder(unsigned rep_dim, const vector<float>& unigram_counts,
+                                             unsigned num_samples, Model& model) :
+    num_samples(num_samples), sampler(unigram_counts) {
+  DYNET_ARG_CHECK(num_samples > 0, "SampledSoftmaxBuilder needs at least one sample");
+  const unsigned vocab_size = unigram_counts.size();
+  p_w = model.add_lookup_parameters(vocab_size, {rep_dim});
+  // Start out self-normalized, i.e. with log(sum_w exp(score(w))) = 0
+  p_b = model.add_lookup_parameters(vocab_size, {1}, ParameterInitConst(-std::log((float)vocab_size)));
+}
+
+void SampledSoftmaxBuilder::new_graph(ComputationGraph& cg) {
+  pcg = &cg;
+  // The full output layer is only loaded if the exact distribution is needed
+  w = Expression();
+  b = Expression();
+}
+
+void SampledSoftmaxBuilder::sampled_scores(const Expression& rep, const vector<unsigned>& wordidxs,
+                                           Expression& true_scores, vector<unsigned>& ids,
+                                           vector<float>& counts, Expression& sample_scores) {
+  const unsigned bd = wordidxs.size();
+  DYNET_ARG_CHECK(rep.dim().bd == 1 || rep.dim().bd == bd,
+                  "Number of words (" << bd << ") does not match the batch size of " << rep.dim() << " in SampledSoftmaxBuilder");
+  const float log_k = std::log((float)num_samples);
+  vector<float> true_corr(bd);
+  for (unsigned i = 0; i < bd; ++i) {
+    DYNET_ARG_CHECK(wordidxs[i] < sampler.size(),
+                    "Word ID " << wordidxs[i] << " out of range in SampledSoftmaxBuilder (vocabulary size " << sampler.size() << ")");
+    true_corr[i] = -log_k - std::log(sampler.prob(wordidxs[i]));
+  }
+  true_scores = dot_product(lookup(*pcg, p_w, wordidxs), rep) + lookup(*pcg, p_b, wordidxs)
+              + input(*pcg, Dim({1}, bd), true_corr);
+
+  // The same samples serve the whole batch, so their rows of the output
+  // layer form a single matrix
+  sampler.sample_bag(num_samples, ids, counts);
+  const unsigned ns = ids.size();
+  vector<float> sample_corr(ns);
+  for (unsigned j = 0; j < ns; ++j)
+    sample_corr[j] = -log_k - std::log(sampler.prob(ids[j]));
+  Expression ws = reshape(lookup(*pcg, p_w, ids), {rep.dim()[0], ns});
+  Expression bs = reshape(lookup(*pcg, p_b, ids), {ns}) + input(*pcg, {ns}, sample_corr);
+  sample_scores = affine_transform({bs, transpose(ws), rep});
+}
+
+Expression SampledSoftmaxBuilder::full_scores(const Expression& rep) {
+  if (!w.pg) {
+    w = parameter(*pcg, p_w);
+    b = reshape(parameter(*pcg, p_b), {sampler.size()});
+  }
+  return reshape(transpose(rep) * w, {sampler.size()}) + b;
+}
+
+Expression SampledSoftmaxBuilder::neg_log_softmax(const Expression& rep, unsigned wordidx) {
+  return neg_log_softmax(rep, vector<unsigned>(1, wordidx));
+}
+
+Expression SampledSoftmaxBuilder::neg_log_softmax(const Expression& rep, const vector<unsigned>& wordidxs) {
+  Expression true_scores, sample_scores;
+  vector<unsigned> ids;
+  vector<float> counts;
+  sampled_scores(rep, wordidxs, true_scores, ids, counts, sample_scores);
+  // A word drawn k times stands for k copies of itself in the normalizer,
+  // except in the batch elements where it is the correct word (an
+  // "accidental hit"), where it is left out
+  const unsigned bd = wordidxs.size(), ns = ids.size();
+  vector<float> adjust(ns * bd);
+  for (unsigned i = 0; i < bd; ++i) {
+    for (unsigned j = 0; j < ns; ++j)
+      adjust[i * ns + j] = (ids[j] == wordidxs[i] ? -1e30f : std::log(counts[j]));
+  }
+  Expression scores = concatenate({true_scores, sample_scores + input(*pcg, Dim({ns}, bd), adjust)});
+  return pickneglogsoftmax(scores, vector<unsigned>(bd, 0));
+}
+
+unsigned SampledSoftmaxBuilder::sample(const Expression& rep) {
+  return as_vector(TensorTools::categorical_sample_log_prob(pcg->incremental_forward(full_scores(rep))))[0];
+}
+
+Expression SampledSoftmaxBuilder::full_log_distribution(const Expression& rep) {
+  return log_softmax(full_scores(rep));
+}
+
+DYNET_SERIALIZE_COMMIT(SampledSoftmaxBuilder,
+                       DYNET_SERIALIZE_DERIVED_DEFINE(SoftmaxBuilder, num_samples, sampler, p_w, p_b))
+DYNET_SERIALIZE_IMPL(SampledSoftmaxBuilder)
+
+NCESoftmaxBuilder::NCESoftmaxBuilder() {}
+
+NCESoftmaxBuilder::NCESoftmaxBuilder(unsigned rep_dim, const vector<float>& unigram_counts,
+                                     unsigned num_samples, Model& model) :
+    SampledSoftmaxBuilder(rep_dim, unigram_counts, num_samples, model) {}
+
+Expression NCESoftmaxBuilder::neg_log_softmax(const Expression& rep, unsigned wordidx) {
+  return neg_log_softmax(rep, vector<unsigned>(1, wordidx));
+}
+
+Expression NCESoftmaxBuilder::neg_log_softmax(const Expression& rep, const vector<unsigned>& wordidxs) {
+  Expression true_scores, sample_scores;
+  vector<unsigned> ids;
+  vector<float> counts;
+  sampled_scores(rep, wordidxs, true_scores, ids, counts, sample_scores);
+  // -log P(data | true word) - sum_noise count * log P(noise | noise word)
+  Expression noise = dot_product(input(*pcg, {(unsigned)ids.size()}, counts), log(logistic(-sample_scores)));
+  return -log(logistic(true_scores)) - noise;
+}
+
+DYNET_SERIALIZE_COMMIT(NCESoftmaxBuilder, DYNET_SERIALIZE_DERIVED_EQ_DEFINE(SampledSoftmaxBuilder))
+DYNET_SERIALIZE_IMPL(NCESoftmaxBuilder)
+
 } // namespace dynet
 
 BOOST_CLASS_EXPORT_IMPLEMENT(dynet::StandardSoftmaxBuilder)
 BOOST_CLASS_EXPORT_IMPLEMENT(dynet::ClassFactoredSoftmaxBuilder)
+BOOST_CLASS_EXPORT_IMPLEMENT(dynet::SampledSoftmaxBuilder)
+BOOST_CLASS_EXPORT_IMPLEMENT(dynet::NCESoftmaxBuilder)
@@ -8,6 +8,7 @@
 #include "dynet/expr.h"
 #include "dynet/dict.h"
 #include "dynet/io-macros.h"
+#include "dynet/sampler.h"
 
 namespace dynet {
 
@@ -21,6 +22,10 @@ public:
   // -log(p(w | rep))
   virtual expr::Expression neg_log_softmax(const expr::Expression& rep, unsigned wordidx) = 0;
 
+  // -log(p(w_i | rep_i)) for a batch of words, one per batch element of rep.
+  // The default implementation computes every batch element on its own.
+  virtual expr::Expression neg_log_softmax(const expr::Expression& rep, const std::vector<unsigned>& wordidxs);
+
   // samples a word from p(w | rep)
   virtual unsigned sample(const expr::Expression& rep) = 0;
 
@@ -28,6 +33,12 @@ public:
   // The ith dimension gives log p(w_i | rep). This function may be SLOW. Avoid if possible.
   virtual expr::Expression full_log_distribution(const expr::Expression& rep) = 0;
 
+protected:
+  // Reassembles losses computed for groups of batch elements: parts[k] holds
+  // the batch elements positions[k] of the result, in that order
+  static expr::Expression merge_batch_elems(const std::vector<expr::Expression>& parts,
+                                            const std::vector<std::vector<unsigned>>& positions);
+
   DYNET_SERIALIZE_COMMIT_EMPTY()
 };
 
@@ -36,6 +47,7 @@ public:
   StandardSoftmaxBuilder(unsigned rep_dim, unsigned vocab_size, Model& model);
   void new_graph(ComputationGraph& cg);
   expr::Expression neg_log_softmax(const expr::Expression& rep, unsigned wordidx);
+  expr::Expression neg_log_softmax(const expr::Expression& rep, const std::vector<unsigned>& wordidxs);
   unsigned sample(const expr::Expression& rep);
   expr::Expression full_log_distribution(const expr::Expression& rep);
 
@@ -62,6 +74,9 @@ class ClassFactoredSoftmaxBuilder : public SoftmaxBuilder {
 
   void new_graph(ComputationGraph& cg);
   expr::Expression neg_log_softmax(const expr::Expression& rep, unsigned wordidx);
+  // One class-level affine for the whole batch, then one word-level affine
+  // per distinct cluster in the batch
+  expr::Expression neg_log_softmax(const expr::Expression& rep, const std::vector<unsigned>& wordidxs);
   unsigned sample(const expr::Expression& rep);
   expr::Expression full_log_distribution(const expr::Expression& rep);
   void initialize_expressions();
@@ -102,9 +117,68 @@ class ClassFactoredSoftmaxBuilder : public SoftmaxBuilder {
   std::vector<expr::Expression> rc2biases;
   DYNET_SERIALIZE_DECLARE()
 };
+
+// Sampled softmax (Jean et al., 2015): during training, the softmax is only
+// normalized over the correct word and num_samples negative words drawn from
+// the unigram distribution, with the scores corrected for the sampling, so
+// the cost of a step does not grow with the vocabulary. The output layer is
+// made of lookup parameters, so only the rows that were used are updated.
+// The negative samples are drawn once per call to neg_log_softmax and shared
+// by all the elements of a batch. sample() and full_log_distribution() use
+// the exact softmax.
+class SampledSoftmaxBuilder : public SoftmaxBuilder {
+public:
+  // unigram_counts holds one (not necessarily normalized) weight per word
+  SampledSoftmaxBuilder(unsigned rep_dim, const std::vector<float>& unigram_counts,
+                        unsigned num_samples, Model& model);
+  void new_graph(ComputationGraph& cg);
+  expr::Expression neg_log_softmax(const expr::Expression& rep, unsigned wordidx);
+  expr::Expression neg_log_softmax(const expr::Expression& rep, const std::vector<unsigned>& wordidxs);
+  unsigned sample(const expr::Expression& rep);
+  expr::Expression full_log_distribution(const expr::Expression& rep);
+
+protected:
+  SampledSoftmaxBuilder();
+  // Scores of the words in wordidxs and of the sampled words in ids, both
+  // shifted by -log(num_samples * q(w)), where q is the sampling distribution
+  void sampled_scores(const expr::Expression& rep, const std::vector<unsigned>& wordidxs,
+                      expr::Expression& true_scores, std::vector<unsigned>& ids,
+                      std::vector<float>& counts, expr::Expression& sample_scores);
+  expr::Expression full_scores(const expr::Expression& rep);
+
+  unsigned num_samples;
+  AliasSampler sampler;
+  LookupParameter p_w;
+  LookupParameter p_b;
+  expr::Expression w;
+  expr::Expression b;
+  ComputationGraph* pcg;
+
+  DYNET_SERIALIZE_DECLARE()
+};
+
+// Noise-contrastive estimation (Mnih and Teh, 2012): during training, every
+// word is classified against num_samples noise words drawn from the unigram
+// distribution with a logistic loss, which teaches the model scores that are
+// close to self-normalized. Parameters, sampling and the exact sample() and
+// full_log_distribution() are shared with SampledSoftmaxBuilder.
+class NCESoftmaxBuilder : public SampledSoftmaxBuilder {
+public:
+  NCESoftmaxBuilder(unsigned rep_dim, const std::vector<float>& unigram_counts,
+                    unsigned num_samples, Model& model);
+  expr::Expression neg_log_softmax(const expr::Expression& rep, unsigned wordidx);
+  expr::Expression neg_log_softmax(const expr::Expression& rep, const std::vector<unsigned>& wordidxs);
+
+private:
+  NCESoftmaxBuilder();
+
+  DYNET_SERIALIZE_DECLARE()
+};
 }  // namespace dynet
 
 BOOST_CLASS_EXPORT_KEY(dynet::StandardSoftmaxBuilder)
 BOOST_CLASS_EXPORT_KEY(dynet::ClassFactoredSoftmaxBuilder)
+BOOST_CLASS_EXPORT_KEY(dynet::SampledSoftmaxBuilder)
+BOOST_CLASS_EXPORT_KEY(dynet::NCESoftmaxBuilder)
 
 #endif
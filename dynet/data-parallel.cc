@@ -0,0 +1,42 @@
+#include "dynet/data-parallel.h"
+
+#include "dynet/except.h"
+
+using namespace std;
+
+namespace dynet {
+
+void ThreadBarrier::wait() {
+  unique_lock<mutex> lock(mtx);
+  const unsigned gen = generation;
+  if (++waiting == n) {
+    waiting = 0;
+    ++generation;
+    cv.notify_all();
+  } else {
+    cv.wait(lock, [this, gen] { return gen != generation; });
+  }
+}
+
+DataParallelState::DataParallelState(unsigned num_threads, unsigned num_shards, const DeviceMempoolSizes& mem) :
+  num_threads(num_threads), thread_devices(num_threads), shard_grads(num_shards), shard_rngs(num_shards) {
+  if (default_device == nullptr || default_device->type != DeviceType::CPU)
+    DYNET_INVALID_ARG("Data-parallel training requires dynet to be initialized on the CPU");
+  for (unsigned t = 0; t < num_threads; ++t)
+    thread_devices[t] = new Device_CPU(devices.size() + t, mem, false);
+  for (unsigned s = 0; s < num_shards; ++s)
+    shard_grads[s] = new ThreadGradients(thread_devices[s % num_threads]);
+}
+
+DataParallelState::~DataParallelState() {
+  for (auto g : shard_grads) delete g;
+  for (auto d : thread_devices) delete d;
+}
+
+void DataParallelState::reduce(unsigned t, unsigned stride) {
+  for (unsigned s = 0; s + stride < shard_grads.size(); s += 2 * stride)
+    if (s % num_threads == t)
+      shard_grads[s]->add(*shard_grads[s + stride]);
+}
+
+} // namespace dynet
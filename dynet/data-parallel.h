@@ -0,0 +1,180 @@
+/**
+ * \file data-parallel.h
+ * \brief Synchronous data-parallel training with deterministic gradient all-reduce
+ *
+ * Each minibatch is cut into a fixed number of shards. Worker threads compute
+ * the gradients of their shards into private buffers (see thread-gradients.h),
+ * using their own FXS/DEDFS pools. The shard gradients are then summed with a
+ * pairwise tree reduction in shared memory, and a single Trainer::update is
+ * applied on the calling thread. Shards, their random seeds and the reduction
+ * order depend only on the number of shards, so the trained model does not
+ * depend on the number of threads used.
+ */
+
+#ifndef DYNET_DATA_PARALLEL_H_
+#define DYNET_DATA_PARALLEL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "dynet/dynet.h"
+#include "dynet/devices.h"
+#include "dynet/globals.h"
+#include "dynet/training.h"
+#include "dynet/thread-gradients.h"
+
+namespace dynet {
+
+/**
+ * \brief Reusable barrier for a fixed number of threads
+ */
+class ThreadBarrier {
+ public:
+  explicit ThreadBarrier(unsigned n) : n(n), waiting(0), generation(0) {}
+  void wait();
+ private:
+  std::mutex mtx;
+  std::condition_variable cv;
+  const unsigned n;
+  unsigned waiting;
+  unsigned generation;
+};
+
+/**
+ * \brief Private state of the worker threads of run_data_parallel
+ * \details Holds one CPU device per thread and the gradient buffer and random
+ *          number generator of every shard. Shard `s` is always computed by
+ *          thread `s % num_threads`, and its buffers live on that thread's
+ *          device.
+ */
+struct DataParallelState {
+  DataParallelState(unsigned num_threads, unsigned num_shards, const DeviceMempoolSizes& mem);
+  ~DataParallelState();
+  DataParallelState(const DataParallelState&) = delete;
+  DataParallelState& operator=(const DataParallelState&) = delete;
+
+  /**
+   * \brief Add shard gradients pairwise for one level of the reduction tree
+   * \details Shard `s` receives shard `s + stride` whenever `s` is a multiple
+   *          of `2 * stride`. Only the pairs whose destination is owned by
+   *          thread `t` are handled.
+   */
+  void reduce(unsigned t, unsigned stride);
+
+  unsigned num_threads;
+  std::vector<Device_CPU*> thread_devices;
+  std::vector<ThreadGradients*> shard_grads;
+  std::vector<std::mt19937> shard_rngs;
+};
+
+/**
+ * \brief Run one epoch of synchronous data-parallel training
+ * \details Data is shuffled and cut into minibatches of `batch_size`. Each
+ *          minibatch is split into `num_shards` contiguous shards, which are
+ *          processed by `learners.size()` threads calling
+ *          `LearnFromDatum(datum, true)`. Once the shard gradients have been
+ *          all-reduced, `trainer.update(1.0 / n)` is called, `n` being the
+ *          size of the minibatch. Learners must call backward() but not update
+ *          the trainer, and must not share graph-building state since they run
+ *          concurrently. The result is the same for any number of learners up
+ *          to `num_shards`; every shard keeps its own gradient buffers, so
+ *          memory grows with `num_shards`.
+ *
+ * \param learners One learner per thread, e.g. `mp::ILearner<D, S>` instances
+ * \param trainer Trainer used for the update
+ * \param data Training data
+ * \param batch_size Number of data per update
+ * \param num_shards Number of shards each minibatch is split into
+ * \param mem Sizes of the FXS/DEDFS/PS pools of each thread, in MB
+ *
+ * \return Sum of the losses returned by the learners
+ */
+template <class Learner, class D>
+auto run_data_parallel(const std::vector<Learner*>& learners, Trainer& trainer, const std::vector<D>& data,
+                       unsigned batch_size, unsigned num_shards = 32,
+                       const DeviceMempoolSizes& mem = DeviceMempoolSizes(96))
+    -> decltype(learners[0]->LearnFromDatum(data[0], true)) {
+  typedef decltype(learners[0]->LearnFromDatum(data[0], true)) S;
+  const unsigned num_threads = learners.size();
+  DYNET_ARG_CHECK(num_threads > 0 && num_threads <= num_shards,
+                  "run_data_parallel requires between 1 and num_shards learners, got " << num_threads);
+  DYNET_ARG_CHECK(batch_size > 0, "run_data_parallel requires a positive batch size");
+
+  std::vector<unsigned> order(data.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), *rndeng);
+
+  DataParallelState state(num_threads, num_shards, mem);
+  ThreadBarrier barrier(num_threads + 1);
+  std::vector<unsigned> shard_begin(num_shards + 1);
+  std::vector<S> shard_losses(num_shards);
+  std::vector<std::exception_ptr> errors(num_threads);
+  bool done = false;
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      default_device = state.thread_devices[t];
+      while (true) {
+        barrier.wait();
+        if (done) break;
+        for (unsigned s = t; s < num_shards; s += num_threads) {
+          state.shard_grads[s]->clear();
+          shard_losses[s] = S();
+          if (errors[t]) continue;
+          rndeng = &state.shard_rngs[s];
+          thread_gradients = state.shard_grads[s];
+          try {
+            for (unsigned i = shard_begin[s]; i < shard_begin[s + 1]; ++i)
+              shard_losses[s] += learners[t]->LearnFromDatum(data[order[i]], true);
+          } catch (...) {
+            errors[t] = std::current_exception();
+          }
+        }
+        thread_gradients = nullptr;
+        for (unsigned stride = 1; stride < num_shards; stride *= 2) {
+          barrier.wait();
+          state.reduce(t, stride);
+        }
+        barrier.wait();
+      }
+    });
+  }
+
+  S total_loss = S();
+  for (unsigned begin = 0; begin < order.size(); begin += batch_size) {
+    const unsigned n = std::min(batch_size, (unsigned)order.size() - begin);
+    for (unsigned s = 0; s <= num_shards; ++s)
+      shard_begin[s] = begin + (unsigned)((unsigned long)n * s / num_shards);
+    for (auto & rng : state.shard_rngs)
+      rng.seed((*rndeng)());
+    barrier.wait();
+    for (unsigned stride = 1; stride < num_shards; stride *= 2)
+      barrier.wait();
+    barrier.wait();
+    if (std::any_of(errors.begin(), errors.end(), [](const std::exception_ptr& e) { return (bool)e; }))
+      break;
+    for (unsigned s = 0; s < num_shards; ++s)
+      total_loss += shard_losses[s];
+    state.shard_grads[0]->accumulate_into_model();
+    trainer.update(1.0 / n);
+  }
+  done = true;
+  barrier.wait();
+  for (auto & thread : threads)
+    thread.join();
+
+  for (auto & error : errors)
+    if (error) std::rethrow_exception(error);
+  return total_loss;
+}
+
+} // namespace dynet
+
+#endif
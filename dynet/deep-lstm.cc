@@ -125,9 +125,6 @@ Expression DeepLSTMBuilder::add_input_impl(int prev, const Expression& x) {
     else
 //      i_ait = vars[BI] + vars[X2I] * in;
       i_ait = affine_transform({vars[BI], vars[X2I], in});
-    Expression i_it = logistic(i_ait);
-    // forget
-    Expression i_ft = 1.f - i_it;
     // write memory cell
     Expression i_awt;
     if (has_prev_state)
@@ -136,14 +133,22 @@ Expression DeepLSTMBuilder::add_input_impl(int prev, const Expression& x) {
     else
 //      i_awt = vars[BC] + vars[X2C] * in;
       i_awt = affine_transform({vars[BC], vars[X2C], in});
-    Expression i_wt = tanh(i_awt);
-    // output
-    if (has_prev_state) {
-      Expression i_nwt = cmult(i_it,i_wt);
-      Expression i_crt = cmult(i_ft,i_c_tm1);
-      ct[i] = i_crt + i_nwt;
+    if (fused_cell) {
+      Expression i_gates = concatenate({i_ait, i_awt});
+      ct[i] = has_prev_state ? lstm_cell(i_gates, i_c_tm1, true, false) : lstm_cell(i_gates, true, false);
     } else {
-      ct[i] = cmult(i_it,i_wt);
+      Expression i_it = logistic(i_ait);
+      // forget
+      Expression i_ft = 1.f - i_it;
+      Expression i_wt = tanh(i_awt);
+      // output
+      if (has_prev_state) {
+        Expression i_nwt = cmult(i_it,i_wt);
+        Expression i_crt = cmult(i_ft,i_c_tm1);
+        ct[i] = i_crt + i_nwt;
+      } else {
+        ct[i] = cmult(i_it,i_wt);
+      }
     }
 
     Expression i_aot;
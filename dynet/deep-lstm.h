@@ -47,6 +47,8 @@ struct DeepLSTMBuilder : public RNNBuilder {
   std::vector<Expression> h0;
   std::vector<Expression> c0;
   unsigned layers;
+  // if this is true, the input gate and memory cell of each step are computed by a single LSTMCell node
+  bool fused_cell = false;
 };
 
 } // namespace dynet
@@ -2,12 +2,12 @@
 
 #include <boost/algorithm/string.hpp>
 #include <iostream>
-#include <unsupported/Eigen/CXX11/Tensor>
 
 #include "dynet/cuda.h"
 #include "dynet/dynet.h"
 #include "dynet/expr.h"
 #include "dynet/except.h"
+#include "dynet/tensor.h"
 
 using namespace std;
 
@@ -103,7 +103,7 @@ Device_GPU::~Device_GPU() {}
 #endif
 
 Device_CPU::Device_CPU(int my_id, const DeviceMempoolSizes & mbs, bool shared) :
-  Device(my_id, DeviceType::CPU, &cpu_mem), shmem(mem) {
+  Device(my_id, DeviceType::CPU, &cpu_mem), shmem(mem), num_threads(1) {
   if (shared) shmem = new SharedAllocator();
   kSCALAR_MINUSONE = (float*) mem->malloc(sizeof(float));
   *kSCALAR_MINUSONE = -1;
@@ -121,6 +121,26 @@ Device_CPU::Device_CPU(int my_id, const DeviceMempoolSizes & mbs, bool shared) :
   pools[2] = new AlignedMemoryPool("CPU parameter memory", (mbs.used[2] << 20), shmem);
 }
 
-Device_CPU::~Device_CPU() {}
+Device_CPU::~Device_CPU() {
+  for (auto pool : pools) delete pool;
+  delete edevice;
+  mem->free(kSCALAR_MINUSONE);
+  mem->free(kSCALAR_ONE);
+  mem->free(kSCALAR_ZERO);
+  if (shmem != mem) delete shmem;
+}
+
+Device_CPU_Threaded::Device_CPU_Threaded(int my_id, const DeviceMempoolSizes & mbs, bool shared, unsigned nt) :
+  Device_CPU(my_id, mbs, shared) {
+  DYNET_ARG_CHECK(nt > 0, "Device_CPU_Threaded needs at least one thread");
+  num_threads = nt;
+  pool = new Eigen::ThreadPool(nt);
+  edevice = new Eigen::ThreadPoolDevice(pool, nt);
+}
+
+Device_CPU_Threaded::~Device_CPU_Threaded() {
+  delete edevice;
+  delete pool;
+}
 
 } // namespace dynet
@@ -7,6 +7,8 @@
 
 namespace Eigen {
   struct DefaultDevice;
+  struct ThreadPoolDevice;
+  class ThreadPoolInterface;
   class CudaStreamDevice;
   struct GpuDevice;
 }
@@ -73,6 +75,23 @@ class Device_CPU : public Device {
   CPUAllocator cpu_mem;
   Eigen::DefaultDevice* edevice;
   MemAllocator* shmem;
+  unsigned num_threads; /**< Number of threads used by the Eigen device */
+};
+
+/**
+ * \brief CPU device running Eigen expressions on a pool of threads
+ * \details Memory is handled exactly as by Device_CPU. Code that is
+ *          instantiated for this device (node forward/backward and parameter
+ *          updates) uses the thread pool through `edevice`; everything else
+ *          sees a Device_CPU and stays single-threaded.
+ */
+class Device_CPU_Threaded : public Device_CPU {
+ public:
+  typedef Eigen::ThreadPoolDevice EigenDevice;
+  explicit Device_CPU_Threaded(int my_id, const DeviceMempoolSizes & mb, bool shared, unsigned num_threads);
+  ~Device_CPU_Threaded();
+  Eigen::ThreadPoolInterface* pool;
+  Eigen::ThreadPoolDevice* edevice;
 };
 
 } // namespace dynet
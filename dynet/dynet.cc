@@ -14,8 +14,9 @@ namespace dynet {
 float* kSCALAR_MINUSONE;
 float* kSCALAR_ONE;
 float* kSCALAR_ZERO;
-int n_hgs = 0;
-unsigned n_cumul_hgs = 0;
+// graphs are counted per thread, each thread allocating from its own device
+thread_local int n_hgs = 0;
+thread_local unsigned n_cumul_hgs = 0;
 
 int get_number_of_active_graphs() {return n_hgs;};
 unsigned get_current_graph_id() {return n_cumul_hgs;};
@@ -126,7 +127,9 @@ void ComputationGraph::_revert(CGCheckpoint p) {
   default_device->revert(p.device_mem_checkpoint);
   // clear all nodes at position >= p.node_idx
   if ((int)nodes.size() > p.node_idx) {
-    nodes.resize(p.node_idx); // TODO verify deletion of nodes.
+    for (unsigned i = p.node_idx; i < nodes.size(); ++i)
+      delete nodes[i];
+    nodes.resize(p.node_idx);
     ee->invalidate(p.node_idx - 1); // clear precomputed forward values
   }
   // clear all parameter nodes at position >= p.par_node_idx
@@ -3,10 +3,22 @@
 #include "dynet/param-nodes.h"
 #include "dynet/globals.h"
 
+#include <algorithm>
+
 using namespace std;
 
 namespace dynet {
 
+// Devices whose pools hold the values of a graph. Graphs built on different
+// threads allocate from different devices, so only these may be freed/zeroed.
+static vector<Device*> graph_devices(const ComputationGraph& cg) {
+  vector<Device*> devs;
+  for (const Node* node : cg.nodes)
+    if (find(devs.begin(), devs.end(), node->device) == devs.end())
+      devs.push_back(node->device);
+  return devs;
+}
+
 ExecutionEngine::~ExecutionEngine() {}
 
 void SimpleExecutionEngine::invalidate() {
@@ -54,7 +66,7 @@ const Tensor& SimpleExecutionEngine::incremental_forward(VariableIndex i) {
 
   // free any old memory if this is a new CG
   if (num_nodes_evaluated == 0)
-    for(Device* dev : dynet::devices)
+    for(Device* dev : graph_devices(cg))
       dev->pools[(int)DeviceMempool::FXS]->free();
 
   if (i >= num_nodes_evaluated) {
@@ -108,7 +120,8 @@ void SimpleExecutionEngine::backward(VariableIndex from_where, bool full) {
 
   const unsigned num_nodes = from_where+1;
   ndEdfs.resize(num_nodes);
-  for(Device* device : devices)
+  const vector<Device*> devs = graph_devices(cg);
+  for(Device* device : devs)
     device->pools[(int)DeviceMempool::DEDFS]->free();
   for (unsigned i = 0; i < num_nodes; ++i) {
     const auto dim = nfxs[i].d;
@@ -119,7 +132,7 @@ void SimpleExecutionEngine::backward(VariableIndex from_where, bool full) {
     if (!ndEdfs[i].v)
       DYNET_RUNTIME_ERR("out of memory while attempting to allocate space for derivatives of node " << i);
   }
-  for(Device* device : devices)
+  for(Device* device : devs)
     device->pools[(int)DeviceMempool::DEDFS]->zero_allocated_memory();
   // initialize dE/dE = 1
   ndEdfs.back().v = kSCALAR_ONE;
@@ -115,6 +115,8 @@ Expression inverse(const Expression& x) { return Expression(x.pg, x.pg->add_func
 Expression logdet(const Expression& x) { return Expression(x.pg, x.pg->add_function<LogDet>({x.i})); }
 
 Expression trace_of_product(const Expression& x, const Expression& y) {return Expression(x.pg, x.pg->add_function<TraceOfProduct>({x.i, y.i}));}
+Expression scaled_dot_product_attention(const Expression& q, const Expression& k, const Expression& v, unsigned tile_size) { return Expression(q.pg, q.pg->add_function<ScaledDotProductAttention>({q.i, k.i, v.i}, tile_size)); }
+Expression scaled_dot_product_attention(const Expression& q, const Expression& k, const Expression& v, const Expression& mask, unsigned tile_size) { return Expression(q.pg, q.pg->add_function<ScaledDotProductAttention>({q.i, k.i, v.i, mask.i}, tile_size)); }
 
 Expression squared_norm(const Expression& x) { return Expression(x.pg, x.pg->add_function<SquaredNorm>({x.i})); }
 
@@ -157,6 +159,8 @@ Expression pickneglogsoftmax(const Expression& x, unsigned v) { return Expressio
 Expression pickneglogsoftmax(const Expression& x, const vector<unsigned> & v) { return Expression(x.pg, x.pg->add_function<PickNegLogSoftmax>({x.i}, v)); }
 Expression pickneglogsoftmax(const Expression& x, const unsigned* pv) { return Expression(x.pg, x.pg->add_function<PickNegLogSoftmax>({x.i}, pv)); }
 Expression pickneglogsoftmax(const Expression& x, const vector<unsigned> * pv) { return Expression(x.pg, x.pg->add_function<PickNegLogSoftmax>({x.i}, pv)); }
+Expression affine_pickneglogsoftmax(const Expression& b, const Expression& w, const Expression& x, unsigned v, unsigned tile_size) { return Expression(x.pg, x.pg->add_function<AffinePickNegLogSoftmax>({b.i, w.i, x.i}, v, tile_size)); }
+Expression affine_pickneglogsoftmax(const Expression& b, const Expression& w, const Expression& x, const vector<unsigned> & v, unsigned tile_size) { return Expression(x.pg, x.pg->add_function<AffinePickNegLogSoftmax>({b.i, w.i, x.i}, v, tile_size)); }
 
 Expression average_cols(const Expression& x) { return Expression(x.pg, x.pg->add_function<AverageColumns>({x.i})); }
 Expression sum_dim(const Expression& x, unsigned d) { return Expression(x.pg, x.pg->add_function<SumDimension>({x.i}, d)); }
@@ -189,5 +193,15 @@ Expression layer_norm(const Expression& x, const Expression& g, const Expression
 }
 
 Expression weight_norm(const Expression& w, const Expression& g){return Expression(w.pg, w.pg->add_function<WeightNormalization>({w.i,g.i}));}
+
+Expression lstm_cell(const Expression& gates, bool coupled, bool output_gate, float forget_bias) { return Expression(gates.pg, gates.pg->add_function<LSTMCell>({gates.i}, coupled, output_gate, forget_bias)); }
+Expression lstm_cell(const Expression& gates, const Expression& c_tm1, bool coupled, bool output_gate, float forget_bias) { return Expression(gates.pg, gates.pg->add_function<LSTMCell>({gates.i, c_tm1.i}, coupled, output_gate, forget_bias)); }
+Expression lstm_cell(const Expression& gates, const Expression& c_tm1, const Expression& p_i, const Expression& p_o, bool coupled, float forget_bias) { return Expression(gates.pg, gates.pg->add_function<LSTMCell>({gates.i, c_tm1.i, p_i.i, p_o.i}, coupled, true, forget_bias)); }
+Expression gru_cell(const Expression& gates) { return Expression(gates.pg, gates.pg->add_function<GRUCell>({gates.i})); }
+Expression gru_cell(const Expression& gates, const Expression& h_tm1, const Expression& u_z, const Expression& u_r, const Expression& u_h) { return Expression(gates.pg, gates.pg->add_function<GRUCell>({gates.i, h_tm1.i, u_z.i, u_r.i, u_h.i})); }
+Expression lstm_sequence(const Expression& xs, const Expression& w_x, const Expression& w_h, const Expression& b, float forget_bias) { return Expression(xs.pg, xs.pg->add_function<LSTMSequence>({xs.i, w_x.i, w_h.i, b.i}, forget_bias)); }
+Expression lstm_sequence(const Expression& xs, const Expression& w_x, const Expression& w_h, const Expression& b, const Expression& h_0, const Expression& c_0, float forget_bias) { return Expression(xs.pg, xs.pg->add_function<LSTMSequence>({xs.i, w_x.i, w_h.i, b.i, h_0.i, c_0.i}, forget_bias)); }
+Expression gru_sequence(const Expression& xs, const Expression& w_x, const Expression& b, const Expression& u_zr, const Expression& u_h) { return Expression(xs.pg, xs.pg->add_function<GRUSequence>({xs.i, w_x.i, b.i, u_zr.i, u_h.i})); }
+Expression gru_sequence(const Expression& xs, const Expression& w_x, const Expression& b, const Expression& u_zr, const Expression& u_h, const Expression& h_0) { return Expression(xs.pg, xs.pg->add_function<GRUSequence>({xs.i, w_x.i, b.i, u_zr.i, u_h.i, h_0.i})); }
 }
 }
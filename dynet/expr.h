@@ -10,6 +10,7 @@
  * \defgroup tensoroperations tensoroperations
  * \defgroup linalgoperations linalgoperations
  * \defgroup normoperations normoperations
+ * \defgroup recurrentoperations recurrentoperations
  * \brief The various operations that you can use in building a DyNet graph
  *
  * \details TODO: **This documentation is incomplete. See expr.h for a full list of expressions.**
@@ -1009,6 +1010,41 @@ Expression pickneglogsoftmax(const Expression& x, const std::vector<unsigned> &
  */
 Expression pickneglogsoftmax(const Expression& x, const std::vector<unsigned> * pv);
 
+/**
+ * \ingroup lossoperations
+ * \brief Negative softmax log likelihood of an affine transform
+ * \details Computes ``pickneglogsoftmax(affine_transform({b, w, x}), v)`` in a single node.
+ *          The scores are computed ``tile_size`` rows of ``w`` at a time and recomputed in the
+ *          backward pass, so only a ``tile_size`` x N block of scores is ever stored instead
+ *          of the full score matrix. This is useful for output layers over large
+ *          vocabularies. CPU only.
+ *
+ * \param b The bias vector
+ * \param w The weight matrix, with one row per element
+ * \param x The input vector
+ * \param v The element with which to calculate the loss
+ * \param tile_size The number of rows of ``w`` processed at a time
+ *
+ * \return The negative log likelihood of element ``v`` after taking the softmax
+ */
+Expression affine_pickneglogsoftmax(const Expression& b, const Expression& w, const Expression& x, unsigned v, unsigned tile_size = 1024);
+
+/**
+ * \ingroup lossoperations
+ * \brief Batched negative softmax log likelihood of an affine transform
+ * \details The batched version of ``affine_pickneglogsoftmax``, with one index per batch
+ *          element of ``x``.
+ *
+ * \param b The bias vector
+ * \param w The weight matrix, with one row per element
+ * \param x An expression with input vectors over N batch elements
+ * \param v A size-N vector indicating the index with respect to all the batch elements
+ * \param tile_size The number of rows of ``w`` processed at a time
+ *
+ * \return The negative log likelihoods over all the batch elements
+ */
+Expression affine_pickneglogsoftmax(const Expression& b, const Expression& w, const Expression& x, const std::vector<unsigned> & v, unsigned tile_size = 1024);
+
 /**
  * \ingroup lossoperations
  * \brief Hinge loss
@@ -1971,6 +2007,32 @@ Expression logdet(const Expression& x);
  */
 Expression trace_of_product(const Expression& x, const Expression& y);
 
+/**
+ * \ingroup linalgoperations
+ * \brief Scaled dot-product attention
+ * \details Attends from every column of `q` over the columns of `k` and `v` in a single node:
+ *
+ * \f$
+ *   y = V \mathrm{softmax}(K^T Q / \sqrt{d} + mask)
+ * \f$
+ *
+ * with the softmax taken over each column. The scores are computed `tile_size` keys at
+ * a time, with a running max and sum per query, and recomputed in the backward pass, so
+ * only a `tile_size` x n block of scores is ever stored instead of the full score matrix.
+ * Any of the inputs can be batched. CPU only.
+ *
+ * \param q The queries, d x n (or a single query of size d)
+ * \param k The keys, d x m
+ * \param v The values, d_v x m
+ * \param mask Added to the scores, either of size m (the same for all queries) or m x n.
+ *             Use a large negative number rather than -infinity to ignore a key.
+ * \param tile_size The number of keys processed at a time
+ *
+ * \return The attention vectors, d_v x n (or of size d_v for a single query)
+ */
+Expression scaled_dot_product_attention(const Expression& q, const Expression& k, const Expression& v, unsigned tile_size = 256);
+Expression scaled_dot_product_attention(const Expression& q, const Expression& k, const Expression& v, const Expression& mask, unsigned tile_size = 256);
+
 ////////////////////////////////////////////////
 // Normalization operations                   //
 ////////////////////////////////////////////////
@@ -2015,6 +2077,114 @@ Expression layer_norm(const Expression& x, const Expression& g, const Expression
  * \return An expression of the same dimension as `w`
  */
 Expression weight_norm(const Expression& w, const Expression& g);
+
+////////////////////////////////////////////////
+// Recurrent operations                       //
+////////////////////////////////////////////////
+
+/**
+ * \ingroup recurrentoperations
+ * \brief Fused LSTM cell
+ * \details Computes one step of an LSTM cell from the pre-activations of its gates in a single node :
+ *
+ * \f$
+ * \begin{split}
+    i_t & = \sigma(a_i + p_i \circ c_{t-1})\\
+    f_t & = \sigma(a_f + \beta) \textrm{, or } 1 - i_t \textrm{ if the gates are coupled}\\
+    c_t & = f_t \circ c_{t-1} + i_t \circ \tanh(a_g)\\
+    h_t & = \sigma(a_o + p_o \circ c_t) \circ \tanh(c_t)\\
+   \end{split}
+ * \f$
+ *
+ * This replaces the dozen or so nodes that compute the same thing from individual operations,
+ * and keeps the gate activations for the backward pass. CPU only.
+ *
+ * \param gates The stacked pre-activations \f$[a_i; a_f; a_o; a_g]\f$, or \f$[a_i; a_o; a_g]\f$ if `coupled`,
+ *              or \f$[a_i; a_g]\f$ if there is no output gate (possibly batched)
+ * \param c_tm1 The previous cell state \f$c_{t-1}\f$, or 0 if omitted (possibly batched)
+ * \param p_i Peephole weights \f$p_i\f$, 0 if omitted (no batch dimension)
+ * \param p_o Peephole weights \f$p_o\f$, 0 if omitted (no batch dimension)
+ * \param coupled Whether the forget gate is \f$1 - i_t\f$ instead of having its own pre-activation
+ * \param output_gate Whether to compute \f$h_t\f$. Without it, the gates must be coupled.
+ * \param forget_bias The constant \f$\beta\f$ added to the forget gate pre-activation
+ * \return \f$[h_t; c_t]\f$, or only \f$c_t\f$ if there is no output gate
+ */
+Expression lstm_cell(const Expression& gates, bool coupled = false, bool output_gate = true, float forget_bias = 0.f);
+Expression lstm_cell(const Expression& gates, const Expression& c_tm1, bool coupled = false, bool output_gate = true, float forget_bias = 0.f);
+Expression lstm_cell(const Expression& gates, const Expression& c_tm1, const Expression& p_i, const Expression& p_o, bool coupled = false, float forget_bias = 0.f);
+
+/**
+ * \ingroup recurrentoperations
+ * \brief Fused GRU cell
+ * \details Computes one step of a GRU in a single node, including the recurrent matrix products :
+ *
+ * \f$
+ * \begin{split}
+    z_t & = \sigma(a_z + U_z h_{t-1})\\
+    r_t & = \sigma(a_r + U_r h_{t-1})\\
+    h_t & = (1 - z_t) \circ h_{t-1} + z_t \circ \tanh(a_h + U_h (r_t \circ h_{t-1}))\\
+   \end{split}
+ * \f$
+ *
+ * The gate activations are kept for the backward pass. CPU only.
+ *
+ * \param gates The stacked input pre-activations \f$[a_z; a_r; a_h]\f$, including the biases (possibly batched)
+ * \param h_tm1 The previous hidden state \f$h_{t-1}\f$, 0 if omitted (possibly batched)
+ * \param u_z Recurrent weights \f$U_z\f$
+ * \param u_r Recurrent weights \f$U_r\f$
+ * \param u_h Recurrent weights \f$U_h\f$
+ * \return \f$h_t\f$
+ */
+Expression gru_cell(const Expression& gates);
+Expression gru_cell(const Expression& gates, const Expression& h_tm1, const Expression& u_z, const Expression& u_r, const Expression& u_h);
+
+/**
+ * \ingroup recurrentoperations
+ * \brief LSTM layer over a whole sequence
+ * \details Runs an LSTM over all the columns of `xs` in a single node :
+ *
+ * \f$
+ * \begin{split}
+    [a_i; a_f; a_o; a_g] & = W_x x_t + W_h h_{t-1} + b\\
+    c_t & = \sigma(a_f + forget\_bias) \circ c_{t-1} + \sigma(a_i) \circ \tanh(a_g)\\
+    h_t & = \sigma(a_o) \circ \tanh(c_t)\\
+   \end{split}
+ * \f$
+ *
+ * The input transformation of all timesteps is computed with one matrix product,
+ * and backpropagation through time runs inside the node. `pick(y, 0u, 2)` holds the
+ * outputs of all timesteps, with one column per timestep, and `pick(y, 1u, 2)` the
+ * memory cells. CPU only.
+ *
+ * \param xs The inputs, one column per timestep (possibly batched)
+ * \param w_x Input weights, with the gates stacked as \f$[i; f; o; g]\f$
+ * \param w_h Recurrent weights, with the gates stacked in the same order
+ * \param b Bias
+ * \param h_0 Initial hidden state, 0 if omitted (possibly batched)
+ * \param c_0 Initial memory cell, 0 if omitted (possibly batched)
+ * \param forget_bias Constant added to the forget gate pre-activation
+ * \return The tensor \f$[[h_0 \dots h_{T-1}], [c_0 \dots c_{T-1}]]\f$
+ */
+Expression lstm_sequence(const Expression& xs, const Expression& w_x, const Expression& w_h, const Expression& b, float forget_bias = 0.f);
+Expression lstm_sequence(const Expression& xs, const Expression& w_x, const Expression& w_h, const Expression& b, const Expression& h_0, const Expression& c_0, float forget_bias = 0.f);
+
+/**
+ * \ingroup recurrentoperations
+ * \brief GRU layer over a whole sequence
+ * \details Runs the GRU of `gru_cell` over all the columns of `xs` in a single
+ * node, with \f$[a_z; a_r; a_h] = W_x x_t + b\f$ computed for all timesteps with
+ * one matrix product. Use `pick(y, t, 1)` for \f$h_t\f$. CPU only.
+ *
+ * \param xs The inputs, one column per timestep (possibly batched)
+ * \param w_x Input weights, with the gates stacked as \f$[z; r; h]\f$
+ * \param b Bias
+ * \param u_zr Recurrent weights of the update and reset gates, stacked as \f$[U_z; U_r]\f$
+ * \param u_h Recurrent weights \f$U_h\f$
+ * \param h_0 Initial hidden state, 0 if omitted (possibly batched)
+ * \return The matrix \f$[h_0 \dots h_{T-1}]\f$
+ */
+Expression gru_sequence(const Expression& xs, const Expression& w_x, const Expression& b, const Expression& u_zr, const Expression& u_h);
+Expression gru_sequence(const Expression& xs, const Expression& w_x, const Expression& b, const Expression& u_zr, const Expression& u_h, const Expression& h_0);
 }
 // Because expressions are now such a fundamental part of DyNet it doesn't
 // make much sense to keep them in separate namespaces, so we import expr
@@ -156,6 +156,25 @@ Expression FastLSTMBuilder::add_input_impl(int prev, const Expression& x) {
       i_h_tm1 = h[prev][i];
       i_c_tm1 = c[prev][i];
     }
+    if (fused_cell) {
+      // [i; o; c] with the diagonal peepholes applied inside the cell
+      const unsigned hid = vars[BI].dim()[0];
+      Expression i_gates, cell;
+      if (has_prev_state) {
+        i_gates = concatenate({affine_transform({vars[BI], vars[X2I], in, vars[H2I], i_h_tm1}),
+                               affine_transform({vars[BO], vars[X2O], in, vars[H2O], i_h_tm1}),
+                               affine_transform({vars[BC], vars[X2C], in, vars[H2C], i_h_tm1})});
+        cell = lstm_cell(i_gates, i_c_tm1, vars[C2I], vars[C2O], true);
+      } else {
+        i_gates = concatenate({affine_transform({vars[BI], vars[X2I], in}),
+                               affine_transform({vars[BO], vars[X2O], in}),
+                               affine_transform({vars[BC], vars[X2C], in})});
+        cell = lstm_cell(i_gates, true);
+      }
+      in = ht[i] = pick_range(cell, 0, hid);
+      ct[i] = pick_range(cell, hid, hid * 2);
+      continue;
+    }
     // input
     Expression i_ait;
     if (has_prev_state) {
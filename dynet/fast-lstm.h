@@ -61,6 +61,8 @@ struct FastLSTMBuilder : public RNNBuilder {
   std::vector<Expression> h0;
   std::vector<Expression> c0;
   unsigned layers;
+  // if this is true, each step is computed by a single LSTMCell node
+  bool fused_cell = false;
 };
 
 } // namespace dynet
@@ -3,9 +3,9 @@
 
 namespace dynet {
 
-std::mt19937* rndeng = nullptr;
+thread_local std::mt19937* rndeng = nullptr;
 std::vector<Device*> devices;
-Device* default_device = nullptr;
+thread_local Device* default_device = nullptr;
 float weight_decay_lambda;
 
 }
@@ -8,9 +8,12 @@ namespace dynet {
 
 class Device;
 
-extern std::mt19937* rndeng;
+// rndeng and default_device are per-thread so that worker threads (see
+// hogwild.h) can build graphs against their own memory pools. Both are set
+// for the thread that calls initialize().
+extern thread_local std::mt19937* rndeng;
 extern std::vector<Device*> devices;
-extern Device* default_device;
+extern thread_local Device* default_device;
 
 } // namespace dynet
 
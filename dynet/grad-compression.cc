@@ -0,0 +1,117 @@
+#include "dynet/grad-compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#include "dynet/except.h"
+
+using namespace std;
+
+namespace dynet {
+
+template <class T>
+static void append(vector<char>& buf, const T* data, size_t n) {
+  const char* p = reinterpret_cast<const char*>(data);
+  buf.insert(buf.end(), p, p + n * sizeof(T));
+}
+
+GradientCompressor::GradientCompressor(GradientCompression type, float topk_ratio) :
+  type(type), topk_ratio(topk_ratio) {
+  DYNET_ARG_CHECK(topk_ratio > 0 && topk_ratio <= 1, "Bad top-k ratio in GradientCompressor: " << topk_ratio);
+}
+
+void GradientCompressor::encode(const ParameterStorage* p, vector<char>& buf) {
+  const size_t n = p->g.d.size();
+  if (type == GradientCompression::NONE) {
+    append(buf, p->g.v, n);
+    return;
+  }
+  // v = gradient + residual; the residual then becomes v - decode(encode(v))
+  vector<float> & v = residuals[p];
+  if (v.size() != n) v.assign(n, 0.f);
+  for (size_t i = 0; i < n; ++i) v[i] += p->g.v[i];
+
+  if (type == GradientCompression::TOPK) {
+    const uint32_t k = min(n, max((size_t)1, (size_t)ceil(topk_ratio * n)));
+    vector<uint32_t> ids(n);
+    iota(ids.begin(), ids.end(), 0);
+    nth_element(ids.begin(), ids.begin() + (k - 1), ids.end(),
+                [&v](uint32_t a, uint32_t b) { return fabs(v[a]) > fabs(v[b]); });
+    ids.resize(k);
+    sort(ids.begin(), ids.end());
+    append(buf, &k, 1);
+    append(buf, &ids[0], k);
+    for (auto i : ids) {
+      append(buf, &v[i], 1);
+      v[i] = 0.f;
+    }
+  } else if (type == GradientCompression::INT8) {
+    float max_abs = 0.f;
+    for (auto x : v) max_abs = max(max_abs, fabs(x));
+    const float scale = max_abs / 127.f;
+    append(buf, &scale, 1);
+    const size_t pos = buf.size();
+    buf.resize(pos + n);
+    for (size_t i = 0; i < n; ++i) {
+      const int8_t q = scale > 0.f ? (int8_t)lrintf(v[i] / scale) : 0;
+      buf[pos + i] = (char)q;
+      v[i] -= q * scale;
+    }
+  } else if (type == GradientCompression::SIGN) {
+    float sum_abs = 0.f;
+    for (auto x : v) sum_abs += fabs(x);
+    const float scale = sum_abs / n;
+    append(buf, &scale, 1);
+    const size_t pos = buf.size();
+    buf.resize(pos + (n + 7) / 8, 0);
+    for (size_t i = 0; i < n; ++i) {
+      if (v[i] >= 0.f) {
+        buf[pos + i / 8] |= (char)(1 << (i % 8));
+        v[i] -= scale;
+      } else {
+        v[i] += scale;
+      }
+    }
+  } else {
+    DYNET_INVALID_ARG("Unknown gradient compression " << (uint32_t)type);
+  }
+}
+
+void GradientCompressor::decode(GradientCompression type, const char* data, size_t nbytes, float* g, size_t n) {
+  if (type == GradientCompression::NONE) {
+    DYNET_ARG_CHECK(nbytes == n * sizeof(float), "Bad size of uncompressed gradient: " << nbytes);
+    const float* f = reinterpret_cast<const float*>(data);
+    for (size_t i = 0; i < n; ++i) g[i] += f[i];
+  } else if (type == GradientCompression::TOPK) {
+    uint32_t k;
+    DYNET_ARG_CHECK(nbytes >= sizeof(k), "Truncated top-k gradient");
+    memcpy(&k, data, sizeof(k));
+    DYNET_ARG_CHECK(k <= n && nbytes == sizeof(k) + k * (sizeof(uint32_t) + sizeof(float)),
+                    "Bad size of top-k gradient: " << nbytes);
+    const uint32_t* ids = reinterpret_cast<const uint32_t*>(data + sizeof(k));
+    const float* vals = reinterpret_cast<const float*>(ids + k);
+    for (uint32_t j = 0; j < k; ++j) {
+      DYNET_ARG_CHECK(ids[j] < n, "Index " << ids[j] << " out of range in top-k gradient");
+      g[ids[j]] += vals[j];
+    }
+  } else if (type == GradientCompression::INT8) {
+    DYNET_ARG_CHECK(nbytes == sizeof(float) + n, "Bad size of 8-bit gradient: " << nbytes);
+    float scale;
+    memcpy(&scale, data, sizeof(scale));
+    const int8_t* q = reinterpret_cast<const int8_t*>(data + sizeof(scale));
+    for (size_t i = 0; i < n; ++i) g[i] += q[i] * scale;
+  } else if (type == GradientCompression::SIGN) {
+    DYNET_ARG_CHECK(nbytes == sizeof(float) + (n + 7) / 8, "Bad size of 1-bit gradient: " << nbytes);
+    float scale;
+    memcpy(&scale, data, sizeof(scale));
+    const unsigned char* bits = reinterpret_cast<const unsigned char*>(data + sizeof(scale));
+    for (size_t i = 0; i < n; ++i)
+      g[i] += (bits[i / 8] >> (i % 8)) & 1 ? scale : -scale;
+  } else {
+    DYNET_INVALID_ARG("Unknown gradient compression " << (uint32_t)type);
+  }
+}
+
+} // namespace dynet
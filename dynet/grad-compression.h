@@ -0,0 +1,65 @@
+/**
+ * \file grad-compression.h
+ * \brief Lossy compression of dense gradients before they are exchanged
+ *
+ * All schemes use error feedback: whatever a message fails to transmit is
+ * kept as a residual and added to the gradient of the same parameter before
+ * the next message is encoded, so no part of the gradient is lost, only
+ * delayed.
+ */
+
+#ifndef DYNET_GRAD_COMPRESSION_H_
+#define DYNET_GRAD_COMPRESSION_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "dynet/model.h"
+
+namespace dynet {
+
+enum class GradientCompression : uint32_t {
+  NONE = 0, /**< Raw floats */
+  TOPK = 1, /**< Only the largest entries in magnitude, as (index, value) pairs */
+  INT8 = 2, /**< One byte per entry, scaled by the largest magnitude */
+  SIGN = 3  /**< One bit per entry, scaled by the mean magnitude */
+};
+
+/**
+ * \brief Encodes dense gradients, keeping the residual of every parameter
+ */
+class GradientCompressor {
+ public:
+  /**
+   * \param type Compression scheme
+   * \param topk_ratio Fraction of the entries sent by GradientCompression::TOPK
+   */
+  explicit GradientCompressor(GradientCompression type, float topk_ratio = 0.01);
+
+  /**
+   * \brief Append the encoding of `p->g` plus its residual to `buf`
+   * \details The residual of `p` is updated to what the encoding misses.
+   */
+  void encode(const ParameterStorage* p, std::vector<char>& buf);
+
+  /**
+   * \brief Add the gradient encoded in `[data, data + nbytes)` to the `n` floats at `g`
+   */
+  static void decode(GradientCompression type, const char* data, size_t nbytes, float* g, size_t n);
+
+  /**
+   * \brief Drop all residuals
+   */
+  void reset() { residuals.clear(); }
+
+  const GradientCompression type;
+  const float topk_ratio;
+
+ private:
+  std::unordered_map<const ParameterStorage*, std::vector<float> > residuals;
+};
+
+} // namespace dynet
+
+#endif
@@ -94,6 +94,52 @@ Expression GRUBuilder::set_s_impl(int prev, const std::vector<Expression>& s_new
 }
 
 Expression GRUBuilder::add_input_impl(int prev, const Expression& x) {
+  return add_input_step(prev, x, Expression());
+}
+
+// The input transformations of the first layer for all timesteps, stacked
+// as [z; r; h]
+Expression GRUBuilder::project_inputs_impl(const Expression& xs) {
+  if (dropout_rate) return Expression();
+  const vector<Expression>& vars = param_vars[0];
+  return concatenate({affine_transform({vars[BZ], vars[X2Z], xs}),
+                      affine_transform({vars[BR], vars[X2R], xs}),
+                      affine_transform({vars[BH], vars[X2H], xs})});
+}
+
+Expression GRUBuilder::add_projected_input_impl(int prev, const Expression& x_proj) {
+  return add_input_step(prev, Expression(), x_proj);
+}
+
+// Each layer runs over the whole sequence in one GRUSequence node, and the
+// state of each step is picked from its output
+vector<Expression> GRUBuilder::add_sequence_impl(int prev, const Expression& xs) {
+  if (!sequence_node || dropout_rate) return vector<Expression>();
+  const unsigned n = xs.dim().cols(), t0 = h.size();
+  const bool has_initial_state = (h0.size() > 0);
+  h.resize(t0 + n, vector<Expression>(layers));
+  Expression in = xs;
+  for (unsigned i = 0; i < layers; ++i) {
+    const vector<Expression>& vars = param_vars[i];
+    Expression w_x = concatenate({vars[X2Z], vars[X2R], vars[X2H]});
+    Expression b = concatenate({vars[BZ], vars[BR], vars[BH]});
+    Expression u_zr = concatenate({vars[H2Z], vars[H2R]});
+    if (prev >= 0 || has_initial_state)
+      in = gru_sequence(in, w_x, b, u_zr, vars[H2H], prev < 0 ? h0[i] : h[prev][i]);
+    else
+      in = gru_sequence(in, w_x, b, u_zr, vars[H2H]);
+    for (unsigned t = 0; t < n; ++t)
+      h[t0 + t][i] = pick(in, t, 1);
+  }
+  vector<Expression> ys(n);
+  for (unsigned t = 0; t < n; ++t)
+    ys[t] = h[t0 + t].back();
+  return ys;
+}
+
+// If x_proj is given, it holds the input transformations of the first layer
+// computed by project_inputs_impl, and x is not used
+Expression GRUBuilder::add_input_step(int prev, const Expression& x, const Expression& x_proj) {
   //if(dropout_rate != 0.f)
   //throw std::runtime_error("GRUBuilder doesn't support dropout yet");
   const bool has_initial_state = (h0.size() > 0);
@@ -102,6 +148,7 @@ Expression GRUBuilder::add_input_impl(int prev, const Expression& x) {
   Expression in = x;
   for (unsigned i = 0; i < layers; ++i) {
     const vector<Expression>& vars = param_vars[i];
+    const bool projected = (i == 0 && x_proj.pg != nullptr);
     Expression h_tprev;
     // prev_zero means that h_tprev should be treated as 0
     bool prev_zero = false;
@@ -109,9 +156,21 @@ Expression GRUBuilder::add_input_impl(int prev, const Expression& x) {
       h_tprev = (prev < 0) ? h0[i] : h[prev][i];
     } else { prev_zero = true; }
     if (dropout_rate) in = dropout(in, dropout_rate);
+    if (fused_cell) {
+      Expression gates = projected ? x_proj :
+                         concatenate({affine_transform({vars[BZ], vars[X2Z], in}),
+                                      affine_transform({vars[BR], vars[X2R], in}),
+                                      affine_transform({vars[BH], vars[X2H], in})});
+      in = ht[i] = prev_zero ? gru_cell(gates) : gru_cell(gates, h_tprev, vars[H2Z], vars[H2R], vars[H2H]);
+      continue;
+    }
     // update gate
     Expression zt;
-    if (prev_zero)
+    if (projected && prev_zero)
+      zt = pick_range(x_proj, 0, hidden_dim);
+    else if (projected)
+      zt = affine_transform({pick_range(x_proj, 0, hidden_dim), vars[H2Z], h_tprev});
+    else if (prev_zero)
       zt = affine_transform({vars[BZ], vars[X2Z], in});
     else
       zt = affine_transform({vars[BZ], vars[X2Z], in, vars[H2Z], h_tprev});
@@ -120,7 +179,11 @@ Expression GRUBuilder::add_input_impl(int prev, const Expression& x) {
     Expression ft = 1.f - zt;
     // reset gate
     Expression rt;
-    if (prev_zero)
+    if (projected && prev_zero)
+      rt = pick_range(x_proj, hidden_dim, hidden_dim * 2);
+    else if (projected)
+      rt = affine_transform({pick_range(x_proj, hidden_dim, hidden_dim * 2), vars[H2R], h_tprev});
+    else if (prev_zero)
       rt = affine_transform({vars[BR], vars[X2R], in});
     else
       rt = affine_transform({vars[BR], vars[X2R], in, vars[H2R], h_tprev});
@@ -129,13 +192,16 @@ Expression GRUBuilder::add_input_impl(int prev, const Expression& x) {
     // candidate activation
     Expression ct;
     if (prev_zero) {
-      ct = affine_transform({vars[BH], vars[X2H], in});
+      ct = projected ? pick_range(x_proj, hidden_dim * 2, hidden_dim * 3) : affine_transform({vars[BH], vars[X2H], in});
       ct = tanh(ct);
       Expression nwt = cmult(zt, ct);
       in = ht[i] = nwt;
     } else {
       Expression ght = cmult(rt, h_tprev);
-      ct = affine_transform({vars[BH], vars[X2H], in, vars[H2H], ght});
+      if (projected)
+        ct = affine_transform({pick_range(x_proj, hidden_dim * 2, hidden_dim * 3), vars[H2H], ght});
+      else
+        ct = affine_transform({vars[BH], vars[X2H], in, vars[H2H], ght});
       ct = tanh(ct);
       Expression nwt = cmult(zt, ct);
       Expression crt = cmult(ft, h_tprev);
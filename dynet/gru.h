@@ -28,6 +28,12 @@ struct GRUBuilder : public RNNBuilder {
   // first index is layer, then ...
   std::vector<std::vector<Expression>> param_vars;
 
+  // if this is true, each step is computed by a single GRUCell node
+  bool fused_cell = false;
+  // if this is true, add_inputs runs each layer over the sequence as a single GRUSequence node,
+  // unless dropout is set
+  bool sequence_node = false;
+
 
  protected:
   void new_graph_impl(ComputationGraph& cg, bool update) override;
@@ -35,6 +41,10 @@ struct GRUBuilder : public RNNBuilder {
   Expression add_input_impl(int prev, const Expression& x) override;
   Expression set_h_impl(int prev, const std::vector<Expression>& h_new) override;
   Expression set_s_impl(int prev, const std::vector<Expression>& s_new) override;
+  Expression project_inputs_impl(const Expression& xs) override;
+  Expression add_projected_input_impl(int prev, const Expression& x_proj) override;
+  Expression add_input_step(int prev, const Expression& x, const Expression& x_proj);
+  std::vector<Expression> add_sequence_impl(int prev, const Expression& xs) override;
 
   // first index is time, second is layer
   std::vector<std::vector<Expression>> h;
@@ -0,0 +1,62 @@
+#include "dynet/hogwild.h"
+
+#include <cmath>
+
+#include "dynet/except.h"
+#include "dynet/globals.h"
+#include "dynet/tensor.h"
+
+using namespace std;
+
+namespace dynet {
+
+HogwildWorker::HogwildWorker(Model& m, int id, const DeviceMempoolSizes& mem, unsigned seed) :
+  device(nullptr), rng(seed), grads(nullptr), clips(0), updates(0) {
+  if (default_device == nullptr || default_device->type != DeviceType::CPU)
+    DYNET_INVALID_ARG("Hogwild training requires dynet to be initialized on the CPU");
+  device = new Device_CPU(id, mem, false);
+  grads.device = device;
+  for (auto i : m.updated_parameters_list())
+    updated.insert(m.parameters_list()[i]);
+  for (auto i : m.updated_lookup_parameters_list())
+    updated.insert(m.lookup_parameters_list()[i]);
+}
+
+HogwildWorker::~HogwildWorker() {
+  delete device;
+}
+
+void HogwildWorker::bind() {
+  default_device = device;
+  rndeng = &rng;
+  thread_gradients = &grads;
+}
+
+void HogwildWorker::update(const SimpleSGDTrainer& trainer, real scale) {
+  float gscale = 1;
+  if (trainer.clipping_enabled) {
+    float gg = sqrt(grads.squared_l2norm());
+    if (std::isnan(gg) || std::isinf(gg))
+      DYNET_RUNTIME_ERR("Magnitude of gradient is bad: " << gg);
+    if (scale * gg > trainer.clip_threshold) {
+      ++clips;
+      gscale = trainer.clip_threshold / (scale * gg);
+    }
+  }
+  // No locks here: concurrent workers may overwrite each other's updates to
+  // the same parameter, which Hogwild tolerates by design.
+  const float lr = trainer.eta * scale * gscale / trainer.model->weight_decay.current_weight_decay();
+  for (auto p : grads.non_zero_params)
+    if (updated.count(p))
+      p->values.vec() -= grads.grads[p].vec() * lr;
+  for (auto & kv : grads.non_zero_grads) {
+    if (!updated.count(kv.first)) continue;
+    auto & rows = grads.lookup_grads[kv.first];
+    for (auto i : kv.second)
+      kv.first->values[i].vec() -= rows[i].vec() * lr;
+  }
+  grads.clear();
+  ++updates;
+}
+
+} // namespace dynet
@@ -0,0 +1,150 @@
+/**
+ * \file hogwild.h
+ * \brief Lock-free multithreaded training on a shared Model
+ *
+ * Hogwild! (Niu et al., 2011) runs SGD from several threads at once. Every
+ * thread builds its own ComputationGraph against a private CPU device (its
+ * own FXS/DEDFS memory pools), accumulates gradients into private buffers and
+ * then writes its update into the shared parameters without taking a lock.
+ * Updates are sparse for lookup parameters, so threads only touch the rows
+ * that their own examples used. This works best for sparse models, where
+ * two threads rarely write the same parameters at the same time.
+ */
+
+#ifndef DYNET_HOGWILD_H_
+#define DYNET_HOGWILD_H_
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "dynet/dynet.h"
+#include "dynet/devices.h"
+#include "dynet/model.h"
+#include "dynet/training.h"
+#include "dynet/thread-gradients.h"
+
+namespace dynet {
+
+/**
+ * \brief State of one Hogwild worker thread
+ * \details Owns a CPU device whose pools are private to the worker, a random
+ *          number generator and the gradient buffers. Workers must be created
+ *          on the thread that called initialize(), and bound with `bind()` on
+ *          the thread that will use them.
+ */
+class HogwildWorker {
+ public:
+  /**
+   * \param m Model shared by all workers
+   * \param id Id of the worker device (must not collide with `devices`)
+   * \param mem Sizes of the pools of the worker device, in MB
+   * \param seed Seed of the random number generator of this worker
+   */
+  HogwildWorker(Model& m, int id, const DeviceMempoolSizes& mem, unsigned seed);
+  ~HogwildWorker();
+  HogwildWorker(const HogwildWorker&) = delete;
+  HogwildWorker& operator=(const HogwildWorker&) = delete;
+
+  /**
+   * \brief Make the calling thread build graphs on this worker
+   * \details Sets the thread-local default_device, rndeng and
+   *          thread_gradients of the calling thread.
+   */
+  void bind();
+
+  /**
+   * \brief Apply the accumulated gradients to the shared Model
+   * \details Performs an SGD step with the learning rate and clipping settings
+   *          of `trainer`, without any locking, then clears the gradients.
+   *
+   * \param trainer Trainer providing learning rate and clipping threshold
+   * \param scale The scaling factor for the gradients
+   */
+  void update(const SimpleSGDTrainer& trainer, real scale = 1.0);
+
+  Device_CPU* device;
+  std::mt19937 rng;
+  ThreadGradients grads;
+  unsigned clips;
+  unsigned updates;
+
+ private:
+  std::unordered_set<const ParameterStorageBase*> updated;
+};
+
+/**
+ * \brief Run one epoch of Hogwild training
+ * \details Starts one thread per learner. Threads repeatedly take the next
+ *          datum in (shuffled) order, call `LearnFromDatum(datum, true)` on
+ *          their own learner, and apply the resulting gradients with
+ *          HogwildWorker::update. Learners must not share any graph-building
+ *          state (e.g. RNN builders), since they run concurrently; they are
+ *          expected to call backward() but not to call a trainer themselves.
+ *          L2 weight decay is not advanced during the epoch.
+ *
+ * \param learners One learner per thread, e.g. `mp::ILearner<D, S>` instances
+ * \param trainer Trainer providing learning rate and clipping threshold
+ * \param data Training data
+ * \param mem Sizes of the FXS/DEDFS/PS pools of each worker, in MB
+ *
+ * \return Sum of the losses returned by the learners
+ */
+template <class Learner, class D>
+auto run_hogwild(const std::vector<Learner*>& learners, SimpleSGDTrainer& trainer, const std::vector<D>& data,
+                 const DeviceMempoolSizes& mem = DeviceMempoolSizes(96))
+    -> decltype(learners[0]->LearnFromDatum(data[0], true)) {
+  typedef decltype(learners[0]->LearnFromDatum(data[0], true)) S;
+  const unsigned num_threads = learners.size();
+  DYNET_ARG_CHECK(num_threads > 0, "run_hogwild requires at least one learner");
+
+  std::vector<unsigned> order(data.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), *rndeng);
+
+  std::vector<HogwildWorker*> workers(num_threads);
+  for (unsigned t = 0; t < num_threads; ++t)
+    workers[t] = new HogwildWorker(*trainer.model, devices.size() + t, mem, (*rndeng)());
+
+  std::atomic<unsigned> next(0);
+  std::vector<S> losses(num_threads, S());
+  std::vector<std::exception_ptr> errors(num_threads);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      try {
+        workers[t]->bind();
+        for (unsigned i = next++; i < order.size(); i = next++) {
+          losses[t] += learners[t]->LearnFromDatum(data[order[i]], true);
+          workers[t]->update(trainer);
+        }
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    });
+  }
+  for (auto & thread : threads)
+    thread.join();
+
+  S total_loss = S();
+  for (unsigned t = 0; t < num_threads; ++t) {
+    total_loss += losses[t];
+    trainer.clips += workers[t]->clips;
+    trainer.clips_since_status += workers[t]->clips;
+    trainer.updates += workers[t]->updates;
+    trainer.updates_since_status += workers[t]->updates;
+    delete workers[t];
+  }
+  for (auto & error : errors)
+    if (error) std::rethrow_exception(error);
+  return total_loss;
+}
+
+} // namespace dynet
+
+#endif
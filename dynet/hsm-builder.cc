@@ -61,8 +61,9 @@ void Cluster::initialize(Model& model) {
     p_bias = model.add_parameters({output_size}, ParameterInitConst(0.f));
   }
 
+  // The tree is read before rep_dim is known, so pass it down here
   for (Cluster* child : children) {
-    child->initialize(model);
+    child->initialize(rep_dim, model);
   }
 }
 
@@ -106,6 +107,24 @@ Expression Cluster::neg_log_softmax(Expression h, unsigned r, ComputationGraph&
   }
 }
 
+Expression Cluster::neg_log_softmax(Expression h, const vector<unsigned>& rs, ComputationGraph& cg) const {
+  if (output_size == 1) {
+    return zeroes(cg, Dim({1}, rs.size()));
+  }
+  else if (output_size == 2) {
+    // 1 - logistic(x) = logistic(-x)
+    vector<float> signs(rs.size());
+    for (unsigned i = 0; i < rs.size(); ++i)
+      signs[i] = (rs[i] == 1 ? -1.f : 1.f);
+    Expression p = logistic(cmult(predict(h, cg), input(cg, Dim({1}, rs.size()), signs)));
+    return -log(p);
+  }
+  else {
+    Expression dist = predict(h, cg);
+    return pickneglogsoftmax(dist, rs);
+  }
+}
+
 unsigned Cluster::sample(expr::Expression h, ComputationGraph& cg) const {
   if (output_size == 1) {
     return 0;
@@ -175,7 +194,7 @@ DYNET_SERIALIZE_IMPL(Cluster)
 HierarchicalSoftmaxBuilder::HierarchicalSoftmaxBuilder(unsigned rep_dim,
                              const std::string& cluster_file,
                              Dict& word_dict,
-                             Model& model) {
+                             Model& model) : pcg(NULL) {
   root = read_cluster_file(cluster_file, word_dict);
   root->initialize(rep_dim, model);
 }
@@ -193,7 +212,7 @@ void HierarchicalSoftmaxBuilder::new_graph(ComputationGraph& cg) {
 }
 
 Expression HierarchicalSoftmaxBuilder::neg_log_softmax(const Expression& rep, unsigned wordidx) {
-  if(pcg != NULL)
+  if(pcg == NULL)
     DYNET_INVALID_ARG("In HierarchicalSoftmaxBuilder, you must call new_graph before calling neg_log_softmax!");
   Cluster* path = widx2path[wordidx];
 
@@ -219,8 +238,57 @@ Expression HierarchicalSoftmaxBuilder::neg_log_softmax(const Expression& rep, un
   return sum(log_probs);
 }
 
+Expression HierarchicalSoftmaxBuilder::neg_log_softmax(const Expression& rep, const vector<unsigned>& wordidxs) {
+  if(pcg == NULL)
+    DYNET_INVALID_ARG("In HierarchicalSoftmaxBuilder, you must call new_graph before calling neg_log_softmax!");
+  const unsigned bd = wordidxs.size();
+  DYNET_ARG_CHECK(rep.dim().bd == 1 || rep.dim().bd == bd,
+                  "Number of words (" << bd << ") does not match the batch size of " << rep.dim() << " in HierarchicalSoftmaxBuilder::neg_log_softmax");
+  for (auto w : wordidxs)
+    DYNET_ARG_CHECK(w < widx2path.size() && widx2path[w] != NULL,
+                    "Word ID " << w << " missing from clusters in HierarchicalSoftmaxBuilder::neg_log_softmax");
+  Expression h = rep;
+  if (bd > 1 && rep.dim().bd == 1)
+    h = concatenate_to_batch(vector<Expression>(bd, rep));
+  return neg_log_softmax(root, h, wordidxs);
+}
+
+Expression HierarchicalSoftmaxBuilder::neg_log_softmax(const Cluster* node, const Expression& h,
+                                                       const vector<unsigned>& wordidxs) {
+  const unsigned bd = wordidxs.size();
+  vector<unsigned> rs(bd);
+  if (node->num_children() == 0) {
+    for (unsigned i = 0; i < bd; ++i)
+      rs[i] = node->get_index(wordidxs[i]);
+    return node->neg_log_softmax(h, rs, *pcg);
+  }
+  // Split the batch between the children, in order of first appearance
+  const unsigned depth = node->get_path().size();
+  vector<int> child2group(node->num_children(), -1);
+  vector<unsigned> group2child;
+  vector<vector<unsigned>> positions;
+  vector<vector<unsigned>> words;
+  for (unsigned i = 0; i < bd; ++i) {
+    rs[i] = node->get_index(widx2path[wordidxs[i]]->get_path()[depth]);
+    if (child2group[rs[i]] < 0) {
+      child2group[rs[i]] = positions.size();
+      group2child.push_back(rs[i]);
+      positions.push_back(vector<unsigned>());
+      words.push_back(vector<unsigned>());
+    }
+    positions[child2group[rs[i]]].push_back(i);
+    words[child2group[rs[i]]].push_back(wordidxs[i]);
+  }
+  vector<Expression> child_nlps;
+  for (unsigned g = 0; g < positions.size(); ++g) {
+    Expression hc = (positions[g].size() == bd ? h : pick_batch_elems(h, positions[g]));
+    child_nlps.push_back(neg_log_softmax(node->get_child(group2child[g]), hc, words[g]));
+  }
+  return node->neg_log_softmax(h, rs, *pcg) + merge_batch_elems(child_nlps, positions);
+}
+
 unsigned HierarchicalSoftmaxBuilder::sample(const expr::Expression& rep) {
-  if(pcg != NULL)
+  if(pcg == NULL)
     DYNET_INVALID_ARG("In HierarchicalSoftmaxBuilder, you must call new_graph before calling sample!");
 
   const Cluster* node = root;
@@ -39,6 +39,7 @@ public:
   void new_graph(ComputationGraph& cg);
   unsigned sample(expr::Expression h, ComputationGraph& cg) const;
   expr::Expression neg_log_softmax(expr::Expression h, unsigned r, ComputationGraph& cg) const;
+  expr::Expression neg_log_softmax(expr::Expression h, const std::vector<unsigned>& rs, ComputationGraph& cg) const;
 
   unsigned get_index(unsigned word) const;
   unsigned get_word(unsigned index) const;
@@ -70,6 +71,10 @@ class HierarchicalSoftmaxBuilder : public SoftmaxBuilder {
   // -log(p(c | rep) * p(w | c, rep))
   expr::Expression neg_log_softmax(const expr::Expression& rep, unsigned wordidx);
 
+  // the same for a batch of words; every tree node on the path of at least
+  // one of the words is computed once for all the words that go through it
+  expr::Expression neg_log_softmax(const expr::Expression& rep, const std::vector<unsigned>& wordidxs);
+
   // samples a word from p(w,c | rep)
   unsigned sample(const expr::Expression& rep);
 
@@ -77,6 +82,9 @@ class HierarchicalSoftmaxBuilder : public SoftmaxBuilder {
 
  private:
   Cluster* read_cluster_file(const std::string& cluster_file, Dict& word_dict);
+  // -log p(w_i | h_i) below node, for words that are all under node
+  expr::Expression neg_log_softmax(const Cluster* node, const expr::Expression& h,
+                                   const std::vector<unsigned>& wordidxs);
   std::vector<Cluster*> widx2path; // will be NULL if not found
   Dict path_symbols;
 
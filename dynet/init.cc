@@ -13,12 +13,18 @@
 #include <device_launch_parameters.h>
 #endif
 
+#if HAVE_MKL
+#include <mkl.h>
+#elif HAVE_OPENBLAS
+#include <cblas.h>
+#endif
+
 using namespace std;
 
 namespace dynet {
 
 DynetParams::DynetParams() : random_seed(0), mem_descriptor("512"), weight_decay(0),
-  shared_parameters(false)
+  shared_parameters(false), num_threads(1), blas_threads(0)
 #if HAVE_CUDA
   , ngpus_requested(false), ids_requested(false), requested_gpus(-1)
 #endif
@@ -85,6 +91,28 @@ DynetParams extract_dynet_params(int& argc, char**& argv, bool shared_parameters
       }
     }
 
+    // Number of CPU threads
+    else if (arg == "--dynet-threads" || arg == "--dynet_threads") {
+      if ((argi + 1) > argc) {
+        throw std::invalid_argument("[dynet] --dynet-threads expects an argument (number of threads per operation on the CPU)");
+      } else {
+        string a2 = argv[argi + 1];
+        istringstream c(a2); c >> params.num_threads;
+        remove_args(argc, argv, argi, 2);
+      }
+    }
+
+    // Number of BLAS threads
+    else if (arg == "--dynet-blas-threads" || arg == "--dynet_blas_threads") {
+      if ((argi + 1) > argc) {
+        throw std::invalid_argument("[dynet] --dynet-blas-threads expects an argument (number of threads of the BLAS library)");
+      } else {
+        string a2 = argv[argi + 1];
+        istringstream c(a2); c >> params.blas_threads;
+        remove_args(argc, argv, argi, 2);
+      }
+    }
+
 #if HAVE_CUDA
     // Number of GPUs
     else if (arg == "--dynet_gpus" || arg == "--dynet-gpus") {
@@ -171,6 +199,20 @@ void initialize(DynetParams& params) {
   cerr << "[dynet] random seed: " << params.random_seed << endl;
   rndeng = new mt19937(params.random_seed);
 
+  if (params.num_threads == 0)
+    throw std::invalid_argument("[dynet] --dynet-threads must be at least 1\n");
+
+  // Set the number of BLAS threads
+  if (params.blas_threads > 0) {
+#if HAVE_MKL
+    mkl_set_num_threads(params.blas_threads);
+#elif HAVE_OPENBLAS
+    openblas_set_num_threads(params.blas_threads);
+#else
+    cerr << "[dynet] WARNING: --dynet-blas-threads has no effect, dynet was not built with a BLAS library" << endl;
+#endif
+  }
+
   // Set weight decay rate
   if (params.weight_decay < 0 || params.weight_decay >= 1)
     throw std::invalid_argument("[dynet] weight decay parameter must be between 0 and 1 (probably very small like 1e-6)\n");
@@ -184,6 +226,9 @@ void initialize(DynetParams& params) {
   if (gpudevices.size() > 0) {
     for (auto gpu : gpudevices)
       devices.push_back(gpu);
+  } else if (params.num_threads > 1) {
+    cerr << "[dynet] using " << params.num_threads << " CPU threads\n";
+    devices.push_back(new Device_CPU_Threaded(devices.size(), params.mem_descriptor, params.shared_parameters, params.num_threads));
   } else {
     devices.push_back(new Device_CPU(devices.size(), params.mem_descriptor, params.shared_parameters));
   }
@@ -19,6 +19,8 @@ struct DynetParams {
   std::string mem_descriptor = "512"; /**< Total memory to be allocated for Dynet */
   float weight_decay = 0; /**< Weight decay rate for L2 regularization */
   bool shared_parameters = false; /**< TO DOCUMENT */
+  unsigned num_threads = 1; /**< Number of threads used by the CPU device for each operation */
+  unsigned blas_threads = 0; /**< Number of threads of the BLAS library, if any (0 keeps its default) */
   bool ngpus_requested = false; /**< GPUs requested by number */
   bool ids_requested = false; /**< GPUs requested by ids */
   int requested_gpus = -1; /**< Number of requested GPUs */
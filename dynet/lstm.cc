@@ -13,13 +13,27 @@ using namespace dynet::expr;
 namespace dynet {
 
 enum { X2I, H2I, C2I, BI, X2O, H2O, C2O, BO, X2C, H2C, BC };
+// stacked layout: WI = [X2I H2I C2I], WO = [X2O H2O C2O], WC = [X2C H2C]
+enum { WI, S_BI, WO, S_BO, WC, S_BC };
 
 LSTMBuilder::LSTMBuilder(unsigned layers,
                          unsigned input_dim,
                          unsigned hidden_dim,
-                         Model& model) : layers(layers), input_dim(input_dim), hid(hidden_dim) {
+                         Model& model,
+                         bool stacked) : layers(layers), input_dim(input_dim), hid(hidden_dim), stacked(stacked) {
   unsigned layer_input_dim = input_dim;
   for (unsigned i = 0; i < layers; ++i) {
+    if (stacked) {
+      Parameter p_wi = model.add_parameters({hidden_dim, layer_input_dim + 2 * hidden_dim});
+      Parameter p_bi = model.add_parameters({hidden_dim}, ParameterInitConst(0.f));
+      Parameter p_wo = model.add_parameters({hidden_dim, layer_input_dim + 2 * hidden_dim});
+      Parameter p_bo = model.add_parameters({hidden_dim}, ParameterInitConst(0.f));
+      Parameter p_wc = model.add_parameters({hidden_dim, layer_input_dim + hidden_dim});
+      Parameter p_bc = model.add_parameters({hidden_dim}, ParameterInitConst(0.f));
+      layer_input_dim = hidden_dim;
+      params.push_back({p_wi, p_bi, p_wo, p_bo, p_wc, p_bc});
+      continue;
+    }
     // i
     Parameter p_x2i = model.add_parameters({hidden_dim, layer_input_dim});
     Parameter p_h2i = model.add_parameters({hidden_dim, hidden_dim});
@@ -52,6 +66,12 @@ void LSTMBuilder::new_graph_impl(ComputationGraph& cg, bool update) {
 
   for (unsigned i = 0; i < layers; ++i) {
     auto& p = params[i];
+    if (stacked) {
+      vector<Expression> vars;
+      for (auto& p_j : p) vars.push_back(update ? parameter(cg, p_j) : const_parameter(cg, p_j));
+      param_vars.push_back(vars);
+      continue;
+    }
 
     //i
     Expression i_x2i = update ? parameter(cg, p[X2I]) : const_parameter(cg, p[X2I]);
@@ -78,17 +98,20 @@ void LSTMBuilder::new_graph_impl(ComputationGraph& cg, bool update) {
 //         layers+1..2*layers = h
 void LSTMBuilder::start_new_sequence_impl(const vector<Expression>& hinit) {
   // Check input dim and hidden dim
-  if (input_dim != params[0][X2I].dim()[1]) {
+  const Dim& d_x2i = params[0][stacked ? WI : X2I].dim();
+  const unsigned p_hid = d_x2i[0];
+  const unsigned p_input_dim = stacked ? d_x2i[1] - 2 * p_hid : d_x2i[1];
+  if (input_dim != p_input_dim) {
     cerr << "Warning : LSTMBuilder input dimension " << input_dim
-         << " doesn't match with parameter dimension " << params[0][X2I].dim()[1]
-         << ". Setting input_dim to " << params[0][X2I].dim()[1] << endl;
-    input_dim = params[0][X2I].dim()[1];
+         << " doesn't match with parameter dimension " << p_input_dim
+         << ". Setting input_dim to " << p_input_dim << endl;
+    input_dim = p_input_dim;
   }
-  if (hid != params[0][X2I].dim()[0]) {
+  if (hid != p_hid) {
     cerr << "Warning : LSTMBuilder hidden dimension " << hid
-         << " doesn't match with parameter dimension " << params[0][X2I].dim()[0]
-         << ". Setting hid to " << params[0][X2I].dim()[0] << endl;
-    hid = params[0][X2I].dim()[0];
+         << " doesn't match with parameter dimension " << p_hid
+         << ". Setting hid to " << p_hid << endl;
+    hid = p_hid;
   }
 
   h.clear();
@@ -171,6 +194,27 @@ Expression LSTMBuilder::set_s_impl(int prev, const std::vector<Expression>& s_ne
 }
 
 Expression LSTMBuilder::add_input_impl(int prev, const Expression& x) {
+  return add_input_step(prev, x, Expression());
+}
+
+// The input transformations of the first layer for all timesteps, stacked
+// as [i; c; o]. The stacked layout already computes each gate with one
+// product per step, so it steps through add_input_impl instead.
+Expression LSTMBuilder::project_inputs_impl(const Expression& xs) {
+  if (stacked || dropout_rate > 0.f) return Expression();
+  const vector<Expression>& vars = param_vars[0];
+  return concatenate({affine_transform({vars[BI], vars[X2I], xs}),
+                      affine_transform({vars[BC], vars[X2C], xs}),
+                      affine_transform({vars[BO], vars[X2O], xs})});
+}
+
+Expression LSTMBuilder::add_projected_input_impl(int prev, const Expression& x_proj) {
+  return add_input_step(prev, Expression(), x_proj);
+}
+
+// If x_proj is given, it holds the input transformations of the first layer
+// computed by project_inputs_impl, and x is not used
+Expression LSTMBuilder::add_input_step(int prev, const Expression& x, const Expression& x_proj) {
   h.push_back(vector<Expression>(layers));
   c.push_back(vector<Expression>(layers));
   vector<Expression>& ht = h.back();
@@ -178,6 +222,7 @@ Expression LSTMBuilder::add_input_impl(int prev, const Expression& x) {
   Expression in = x;
   for (unsigned i = 0; i < layers; ++i) {
     const vector<Expression>& vars = param_vars[i];
+    const bool projected = (i == 0 && x_proj.pg != nullptr);
     Expression i_h_tm1, i_c_tm1;
     bool has_prev_state = (prev >= 0 || has_initial_state);
     if (prev < 0) {
@@ -198,6 +243,10 @@ Expression LSTMBuilder::add_input_impl(int prev, const Expression& x) {
       in = cmult(in, masks[i][0]);
 
     }
+    if (stacked) {
+      in = ht[i] = add_input_stacked(i, in, i_h_tm1, i_c_tm1, has_prev_state, ct[i]);
+      continue;
+    }
     // h
     if (has_prev_state && dropout_rate_h > 0.f)
       i_h_tm1 = cmult(i_h_tm1, masks[i][1]);
@@ -211,27 +260,40 @@ Expression LSTMBuilder::add_input_impl(int prev, const Expression& x) {
 
     // input
     Expression i_ait;
-    if (has_prev_state)
+    if (projected && has_prev_state)
+      i_ait = affine_transform({pick_range(x_proj, 0, hid), vars[H2I], i_h_tm1, vars[C2I], i_dropped_c_tm1});
+    else if (projected)
+      i_ait = pick_range(x_proj, 0, hid);
+    else if (has_prev_state)
       i_ait = affine_transform({vars[BI], vars[X2I], in, vars[H2I], i_h_tm1, vars[C2I], i_dropped_c_tm1});
     else
       i_ait = affine_transform({vars[BI], vars[X2I], in});
-    Expression i_it = logistic(i_ait);
-    // forget
-    Expression i_ft = 1.f - i_it;
     // write memory cell
     Expression i_awt;
-    if (has_prev_state)
+    if (projected && has_prev_state)
+      i_awt = affine_transform({pick_range(x_proj, hid, hid * 2), vars[H2C], i_h_tm1});
+    else if (projected)
+      i_awt = pick_range(x_proj, hid, hid * 2);
+    else if (has_prev_state)
       i_awt = affine_transform({vars[BC], vars[X2C], in, vars[H2C], i_h_tm1});
     else
       i_awt = affine_transform({vars[BC], vars[X2C], in});
-    Expression i_wt = tanh(i_awt);
-    // output
-    if (has_prev_state) {
-      Expression i_nwt = cmult(i_it, i_wt);
-      Expression i_crt = cmult(i_ft, i_c_tm1);
-      ct[i] = i_crt + i_nwt;
+    if (fused_cell) {
+      Expression i_gates = concatenate({i_ait, i_awt});
+      ct[i] = has_prev_state ? lstm_cell(i_gates, i_c_tm1, true, false) : lstm_cell(i_gates, true, false);
     } else {
-      ct[i] = cmult(i_it, i_wt);
+      Expression i_it = logistic(i_ait);
+      // forget
+      Expression i_ft = 1.f - i_it;
+      Expression i_wt = tanh(i_awt);
+      // output
+      if (has_prev_state) {
+        Expression i_nwt = cmult(i_it, i_wt);
+        Expression i_crt = cmult(i_ft, i_c_tm1);
+        ct[i] = i_crt + i_nwt;
+      } else {
+        ct[i] = cmult(i_it, i_wt);
+      }
     }
 
     Expression i_aot;
@@ -239,7 +301,11 @@ Expression LSTMBuilder::add_input_impl(int prev, const Expression& x) {
     Expression dropped_c = ct[i];
     if (dropout_rate_c > 0.f)
       dropped_c = cmult(dropped_c, masks[i][2]);
-    if (has_prev_state)
+    if (projected && has_prev_state)
+      i_aot = affine_transform({pick_range(x_proj, hid * 2, hid * 3), vars[H2O], i_h_tm1, vars[C2O], dropped_c});
+    else if (projected)
+      i_aot = affine_transform({pick_range(x_proj, hid * 2, hid * 3), vars[C2O], dropped_c});
+    else if (has_prev_state)
       i_aot = affine_transform({vars[BO], vars[X2O], in, vars[H2O], i_h_tm1, vars[C2O], dropped_c});
     else
       i_aot = affine_transform({vars[BO], vars[X2O], in, vars[C2O], dropped_c});
@@ -250,11 +316,45 @@ Expression LSTMBuilder::add_input_impl(int prev, const Expression& x) {
   return ht.back();
 }
 
+// Same cell as above, with each gate computed as one product of a stacked
+// weight matrix and the concatenation of the gate's inputs
+Expression LSTMBuilder::add_input_stacked(unsigned i, const Expression& in, Expression i_h_tm1, Expression i_c_tm1,
+                                          bool has_prev_state, Expression& i_ct) {
+  const vector<Expression>& vars = param_vars[i];
+  // A missing previous state is zero, which keeps the weight matrices whole
+  if (!has_prev_state)
+    i_h_tm1 = i_c_tm1 = zeroes(*_cg, Dim({hid}, in.dim().bd));
+  else if (dropout_rate_h > 0.f)
+    i_h_tm1 = cmult(i_h_tm1, masks[i][1]);
+  Expression i_dropped_c_tm1 = i_c_tm1;
+  if (has_prev_state && dropout_rate_c > 0.f)
+    i_dropped_c_tm1 = cmult(i_dropped_c_tm1, masks[i][2]);
+
+  Expression i_ait = affine_transform({vars[S_BI], vars[WI], concatenate({in, i_h_tm1, i_dropped_c_tm1})});
+  Expression i_awt = affine_transform({vars[S_BC], vars[WC], concatenate({in, i_h_tm1})});
+  if (fused_cell) {
+    i_ct = lstm_cell(concatenate({i_ait, i_awt}), i_c_tm1, true, false);
+  } else {
+    Expression i_it = logistic(i_ait), i_wt = tanh(i_awt);
+    if (has_prev_state)
+      i_ct = cmult(1.f - i_it, i_c_tm1) + cmult(i_it, i_wt);
+    else
+      i_ct = cmult(i_it, i_wt);
+  }
+  Expression dropped_c = i_ct;
+  if (dropout_rate_c > 0.f)
+    dropped_c = cmult(dropped_c, masks[i][2]);
+  Expression i_ot = logistic(affine_transform({vars[S_BO], vars[WO], concatenate({in, i_h_tm1, dropped_c})}));
+  return cmult(i_ot, tanh(i_ct));
+}
+
 void LSTMBuilder::copy(const RNNBuilder & rnn) {
   const LSTMBuilder & rnn_lstm = (const LSTMBuilder&)rnn;
   DYNET_ARG_CHECK(params.size() == rnn_lstm.params.size(),
                           "Attempt to copy LSTMBuilder with different number of parameters "
                           "(" << params.size() << " != " << rnn_lstm.params.size() << ")");
+  DYNET_ARG_CHECK(stacked == rnn_lstm.stacked,
+                          "Attempt to copy LSTMBuilder with a different parameter layout");
   for (size_t i = 0; i < params.size(); ++i)
     for (size_t j = 0; j < params[i].size(); ++j)
       params[i][j] = rnn_lstm.params[i][j];
@@ -322,7 +422,8 @@ void LSTMBuilder::disable_dropout() {
 
 DYNET_SERIALIZE_COMMIT(LSTMBuilder,
 		       DYNET_SERIALIZE_DERIVED_DEFINE(RNNBuilder, params, layers, dropout_rate),
-		       DYNET_VERSION_SERIALIZE_DEFINE(1, MAX_SERIALIZE_VERSION, dropout_rate_h, dropout_rate_c, input_dim, hid))
+		       DYNET_VERSION_SERIALIZE_DEFINE(1, MAX_SERIALIZE_VERSION, dropout_rate_h, dropout_rate_c, input_dim, hid),
+		       DYNET_VERSION_SERIALIZE_DEFINE(2, MAX_SERIALIZE_VERSION, stacked))
 
 DYNET_SERIALIZE_IMPL(LSTMBuilder);
 
@@ -330,17 +431,30 @@ DYNET_SERIALIZE_IMPL(LSTMBuilder);
 
 //enum { _X2I, _H2I, _C2I, _BI, _X2F, _H2F, _C2F, _BF, _X2O, _H2O, _C2O, _BO, _X2G, _H2G, _C2G, _BG };
 enum { _X2I, _H2I, _BI, _X2F, _H2F, _BF, _X2O, _H2O, _BO, _X2G, _H2G, _BG };
+// stacked layout: W = [X2I H2I]
+enum { _W, _WB };
 enum { LN_GH, LN_BH, LN_GX, LN_BX, LN_GC, LN_BC};
 
-VanillaLSTMBuilder::VanillaLSTMBuilder() : has_initial_state(false), layers(0), input_dim(0), hid(0), dropout_rate_h(0), ln_lstm(false) { }
+VanillaLSTMBuilder::VanillaLSTMBuilder() : has_initial_state(false), layers(0), input_dim(0), hid(0), dropout_rate_h(0), ln_lstm(false), stacked(false) { }
 
 VanillaLSTMBuilder::VanillaLSTMBuilder(unsigned layers,
                                        unsigned input_dim,
                                        unsigned hidden_dim,
                                        Model& model,
-                                       bool ln_lstm) : layers(layers), input_dim(input_dim), hid(hidden_dim), ln_lstm(ln_lstm) {
+                                       bool ln_lstm,
+                                       bool stacked) : layers(layers), input_dim(input_dim), hid(hidden_dim), ln_lstm(ln_lstm), stacked(stacked) {
+  DYNET_ARG_CHECK(!(ln_lstm && stacked),
+                          "VanillaLSTMBuilder cannot stack the weights of a layer-normalized LSTM");
   unsigned layer_input_dim = input_dim;
   for (unsigned i = 0; i < layers; ++i) {
+    if (stacked) {
+      // [i; f; o; g] x [x, h]
+      Parameter p_w = model.add_parameters({hidden_dim * 4, layer_input_dim + hidden_dim});
+      Parameter p_b = model.add_parameters({hidden_dim * 4}, ParameterInitConst(0.f));
+      layer_input_dim = hidden_dim;
+      params.push_back({p_w, p_b});
+      continue;
+    }
     // [i; f; o; g]
     Parameter p_x2i = model.add_parameters({hidden_dim * 4, layer_input_dim});
     Parameter p_h2i = model.add_parameters({hidden_dim * 4, hidden_dim});
@@ -471,6 +585,72 @@ Expression VanillaLSTMBuilder::set_s_impl(int prev, const std::vector<Expression
 }
 
 Expression VanillaLSTMBuilder::add_input_impl(int prev, const Expression& x) {
+  return add_input_step(prev, x, Expression());
+}
+
+// The input transformations of the first layer for all timesteps
+Expression VanillaLSTMBuilder::project_inputs_impl(const Expression& xs) {
+  if (ln_lstm || dropout_rate > 0.f) return Expression();
+  const vector<Expression>& vars = param_vars[0];
+  if (!stacked)
+    return affine_transform({vars[_BI], vars[_X2I], xs});
+  vector<unsigned> x_cols(input_dim), h_cols(hid);
+  for (unsigned j = 0; j < input_dim; ++j) x_cols[j] = j;
+  for (unsigned j = 0; j < hid; ++j) h_cols[j] = input_dim + j;
+  proj_w_h = select_cols(vars[_W], h_cols);
+  return affine_transform({vars[_WB], select_cols(vars[_W], x_cols), xs});
+}
+
+Expression VanillaLSTMBuilder::add_projected_input_impl(int prev, const Expression& x_proj) {
+  return add_input_step(prev, Expression(), x_proj);
+}
+
+// Each layer runs over the whole sequence in one LSTMSequence node, and the
+// states of each step are picked from its output
+vector<Expression> VanillaLSTMBuilder::add_sequence_impl(int prev, const Expression& xs) {
+  if (!sequence_node || ln_lstm || dropout_rate > 0.f || dropout_rate_h > 0.f) return vector<Expression>();
+  const unsigned n = xs.dim().cols(), t0 = h.size();
+  const bool has_prev_state = (prev >= 0 || has_initial_state);
+  h.resize(t0 + n, vector<Expression>(layers));
+  c.resize(t0 + n, vector<Expression>(layers));
+  Expression in = xs;
+  for (unsigned i = 0; i < layers; ++i) {
+    const vector<Expression>& vars = param_vars[i];
+    Expression w_x, w_h, b;
+    if (stacked) {
+      const unsigned layer_input_dim = (i == 0 ? input_dim : hid);
+      vector<unsigned> x_cols(layer_input_dim), h_cols(hid);
+      for (unsigned j = 0; j < layer_input_dim; ++j) x_cols[j] = j;
+      for (unsigned j = 0; j < hid; ++j) h_cols[j] = layer_input_dim + j;
+      w_x = select_cols(vars[_W], x_cols);
+      w_h = select_cols(vars[_W], h_cols);
+      b = vars[_WB];
+    } else {
+      w_x = vars[_X2I];
+      w_h = vars[_H2I];
+      b = vars[_BI];
+    }
+    Expression y;
+    if (has_prev_state)
+      y = lstm_sequence(in, w_x, w_h, b, prev < 0 ? h0[i] : h[prev][i], prev < 0 ? c0[i] : c[prev][i], 1.f);
+    else
+      y = lstm_sequence(in, w_x, w_h, b, 1.f);
+    Expression hs = pick(y, 0u, 2), cs = pick(y, 1u, 2);
+    for (unsigned t = 0; t < n; ++t) {
+      h[t0 + t][i] = pick(hs, t, 1);
+      c[t0 + t][i] = pick(cs, t, 1);
+    }
+    in = hs;
+  }
+  vector<Expression> ys(n);
+  for (unsigned t = 0; t < n; ++t)
+    ys[t] = h[t0 + t].back();
+  return ys;
+}
+
+// If x_proj is given, it holds the input transformations of the first layer
+// computed by project_inputs_impl, and x is not used
+Expression VanillaLSTMBuilder::add_input_step(int prev, const Expression& x, const Expression& x_proj) {
   h.push_back(vector<Expression>(layers));
   c.push_back(vector<Expression>(layers));
   vector<Expression>& ht = h.back();
@@ -479,6 +659,7 @@ Expression VanillaLSTMBuilder::add_input_impl(int prev, const Expression& x) {
   for (unsigned i = 0; i < layers; ++i) {
     const vector<Expression>& vars = param_vars[i];
     const vector<Expression>& ln_vars = ln_param_vars[i];
+    const bool projected = (i == 0 && x_proj.pg != nullptr);
     Expression i_h_tm1, i_c_tm1;
     bool has_prev_state = (prev >= 0 || has_initial_state);
     if (prev < 0) {
@@ -505,7 +686,14 @@ Expression VanillaLSTMBuilder::add_input_impl(int prev, const Expression& x) {
     Expression i_aft;
     Expression i_aot;
     Expression i_agt;
-    if (ln_lstm){
+    if (projected) {
+      tmp = has_prev_state ? affine_transform({x_proj, stacked ? proj_w_h : vars[_H2I], i_h_tm1}) : x_proj;
+    } else if (stacked) {
+      // A missing previous state is zero, which keeps the weight matrix whole
+      if (!has_prev_state)
+        i_h_tm1 = zeroes(*_cg, Dim({hid}, in.dim().bd));
+      tmp = affine_transform({vars[_WB], vars[_W], concatenate({in, i_h_tm1})});
+    } else if (ln_lstm){
       if (has_prev_state)
         tmp = vars[_BI] + layer_norm(vars[_X2I] * in, ln_vars[LN_GX], ln_vars[LN_BX]) + layer_norm(vars[_H2I] * i_h_tm1, ln_vars[LN_GH], ln_vars[LN_BH]);
       else
@@ -516,6 +704,12 @@ Expression VanillaLSTMBuilder::add_input_impl(int prev, const Expression& x) {
       else
         tmp = affine_transform({vars[_BI], vars[_X2I], in});
     }
+    if (fused_cell && !ln_lstm) {
+      Expression cell = has_prev_state ? lstm_cell(tmp, i_c_tm1, false, true, 1.f) : lstm_cell(tmp, false, true, 1.f);
+      in = ht[i] = pick_range(cell, 0, hid);
+      ct[i] = pick_range(cell, hid, hid * 2);
+      continue;
+    }
     i_ait = pick_range(tmp, 0, hid);
     i_aft = pick_range(tmp, hid, hid * 2);
     i_aot = pick_range(tmp, hid * 2, hid * 3);
@@ -540,6 +734,8 @@ void VanillaLSTMBuilder::copy(const RNNBuilder & rnn) {
   DYNET_ARG_CHECK(params.size() == rnn_lstm.params.size(),
                           "Attempt to copy VanillaLSTMBuilder with different number of parameters "
                           "(" << params.size() << " != " << rnn_lstm.params.size() << ")");
+  DYNET_ARG_CHECK(stacked == rnn_lstm.stacked,
+                          "Attempt to copy VanillaLSTMBuilder with a different parameter layout");
   for (size_t i = 0; i < params.size(); ++i)
     for (size_t j = 0; j < params[i].size(); ++j)
       params[i][j] = rnn_lstm.params[i][j];
@@ -613,7 +809,8 @@ void VanillaLSTMBuilder::disable_dropout() {
 
 DYNET_SERIALIZE_COMMIT(VanillaLSTMBuilder,
   DYNET_SERIALIZE_DERIVED_DEFINE(RNNBuilder, params, layers, dropout_rate, dropout_rate_h, hid, input_dim),
-  DYNET_VERSION_SERIALIZE_DEFINE(1, MAX_SERIALIZE_VERSION, ln_params, ln_lstm))
+  DYNET_VERSION_SERIALIZE_DEFINE(1, MAX_SERIALIZE_VERSION, ln_params, ln_lstm),
+  DYNET_VERSION_SERIALIZE_DEFINE(2, MAX_SERIALIZE_VERSION, stacked))
 DYNET_SERIALIZE_IMPL(VanillaLSTMBuilder);
 
 } // namespace dynet
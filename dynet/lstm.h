@@ -47,11 +47,14 @@ struct LSTMBuilder : public RNNBuilder {
    * \param input_dim Dimention of the input \f$x_t\f$
    * \param hidden_dim Dimention of the hidden states \f$h_t\f$ and \f$c_t\f$
    * \param model Model holding the parameters
+   * \param stacked Store the weights of each gate as one matrix \f$[W_{*x} W_{*h} W_{*c}]\f$ applied to the
+   *                concatenation of its inputs, so that each gate is computed with a single matrix product
    */
   explicit LSTMBuilder(unsigned layers,
                        unsigned input_dim,
                        unsigned hidden_dim,
-                       Model& model);
+                       Model& model,
+                       bool stacked = false);
 
   Expression back() const override { return (cur == -1 ? h0.back() : h[cur].back()); }
   std::vector<Expression> final_h() const override { return (h.size() == 0 ? h0 : h.back()); }
@@ -134,6 +137,11 @@ protected:
   Expression add_input_impl(int prev, const Expression& x) override;
   Expression set_h_impl(int prev, const std::vector<Expression>& h_new) override;
   Expression set_s_impl(int prev, const std::vector<Expression>& s_new) override;
+  Expression project_inputs_impl(const Expression& xs) override;
+  Expression add_projected_input_impl(int prev, const Expression& x_proj) override;
+  Expression add_input_step(int prev, const Expression& x, const Expression& x_proj);
+  Expression add_input_stacked(unsigned i, const Expression& in, Expression i_h_tm1, Expression i_c_tm1,
+                               bool has_prev_state, Expression& i_ct);
 
 public:
   // first index is layer, then ...
@@ -159,6 +167,10 @@ public:
   unsigned hid = 0;
 
   float dropout_rate_h = 0.f, dropout_rate_c = 0.f;
+  // if this is true, params[i] holds one stacked weight matrix per gate
+  bool stacked = false;
+  // if this is true, the input gate and memory cell of each step are computed by a single LSTMCell node
+  bool fused_cell = false;
 
 private:
   DYNET_SERIALIZE_DECLARE()
@@ -196,12 +208,16 @@ struct VanillaLSTMBuilder : public RNNBuilder {
    * \param hidden_dim Dimention of the hidden states \f$h_t\f$ and \f$c_t\f$
    * \param model Model holding the parameters
    * \param ln_lstm Whether to use layer normalization
+   * \param stacked Store the input and recurrent weights as one matrix \f$[W_x W_h]\f$ applied to
+   *                \f$[x_t; h_{t-1}]\f$, so that all gates are computed with a single matrix product.
+   *                This cannot be combined with layer normalization.
    */
   explicit VanillaLSTMBuilder(unsigned layers,
                               unsigned input_dim,
                               unsigned hidden_dim,
                               Model& model,
-                              bool ln_lstm = false);
+                              bool ln_lstm = false,
+                              bool stacked = false);
 
   Expression back() const override { return (cur == -1 ? h0.back() : h[cur].back()); }
   std::vector<Expression> final_h() const override { return (h.size() == 0 ? h0 : h.back()); }
@@ -271,6 +287,13 @@ protected:
   Expression add_input_impl(int prev, const Expression& x) override;
   Expression set_h_impl(int prev, const std::vector<Expression>& h_new) override;
   Expression set_s_impl(int prev, const std::vector<Expression>& s_new) override;
+  Expression project_inputs_impl(const Expression& xs) override;
+  Expression add_projected_input_impl(int prev, const Expression& x_proj) override;
+  Expression add_input_step(int prev, const Expression& x, const Expression& x_proj);
+  std::vector<Expression> add_sequence_impl(int prev, const Expression& xs) override;
+
+  // recurrent columns of the stacked weights of the first layer, selected by project_inputs_impl
+  Expression proj_w_h;
 
 public:
   // first index is layer, then ...
@@ -298,6 +321,13 @@ public:
   unsigned input_dim, hid;
   float dropout_rate_h;
   bool ln_lstm;
+  // if this is true, params[i] = {[W_x W_h], b}
+  bool stacked;
+  // if this is true, each step of a layer without layer normalization is computed by a single LSTMCell node
+  bool fused_cell = false;
+  // if this is true, add_inputs runs each layer over the sequence as a single LSTMSequence node,
+  // unless the LSTM uses dropout or layer normalization
+  bool sequence_node = false;
 
 
 
@@ -311,9 +341,9 @@ private:
 
 
 // Class version
-DYNET_VERSION_DEFINE(dynet::LSTMBuilder, 1);
+DYNET_VERSION_DEFINE(dynet::LSTMBuilder, 2);
 // Class version
-DYNET_VERSION_DEFINE(dynet::VanillaLSTMBuilder, 1);
+DYNET_VERSION_DEFINE(dynet::VanillaLSTMBuilder, 2);
 
 
 #endif
@@ -0,0 +1,169 @@
+#ifndef DYNET_MATRIX_MULTIPLY_H_
+#define DYNET_MATRIX_MULTIPLY_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "dynet/dynet.h"
+#include "dynet/devices.h"
+#include "dynet/except.h"
+#include "dynet/tensor.h"
+
+#ifdef __CUDACC__
+#include "dynet/cuda.h"
+#endif
+
+// When dynet is built against a system BLAS (cmake -DMKL=1 or -DOPENBLAS=1),
+// CPU matrix products are handed to its sgemm instead of Eigen's own GEMM
+#if HAVE_MKL
+#include <mkl.h>
+#elif HAVE_CBLAS
+#include <cblas.h>
+#endif
+
+namespace dynet {
+
+#ifdef __CUDACC__
+inline void CUDAMatrixMultiply(const Device_GPU & dev, const Tensor& l, const Tensor& r, Tensor& y, const float* acc_scalar) {
+  if(l.d.bd == 1 && r.d.bd == y.d.bd) {
+    // If the left side has one batch, multiply by columns
+    // [x, z, b] = [x, y] * [y, z, b]
+    // -> [x, z*b] = [x, y], [y, z*b]
+    CUBLAS_CHECK(cublasSgemm(dev.cublas_handle, CUBLAS_OP_N, CUBLAS_OP_N,
+          y.d.rows(), y.d.cols() * y.d.batch_elems(), l.d.cols(),
+          kSCALAR_ONE,
+          l.v, l.d.rows(),
+          r.v, r.d.rows(),
+          acc_scalar, y.v, y.d.rows()));
+  } else {
+    // Otherwise, loop over the batches
+    DYNET_ASSERT(r.d.bd != 1 || r.d.bd != l.d.bd,
+                 "Number of batch elements in matrix multiply must match, but got: " << r.d.bd << ", " << l.d.bd);
+    for(unsigned b = 0; b < y.d.bd; ++b) {
+      CUBLAS_CHECK(cublasSgemm(dev.cublas_handle, CUBLAS_OP_N, CUBLAS_OP_N,
+            y.d.rows(), y.d.cols(), l.d.cols(),
+            kSCALAR_ONE,
+            l.batch_ptr(b), l.d.rows(),
+            r.batch_ptr(b), r.d.rows(),
+            acc_scalar, y.batch_ptr(b), y.d.rows()));
+    }
+  }
+}
+#else
+// Products with at most this many multiply-adds skip Eigen's GEMM kernel
+#define DYNET_LAZY_PRODUCT_SIZE 4096
+
+template <class L, class R>
+inline void CPUMatrixProduct(const L& l, const R& r, Eigen::Map<Eigen::MatrixXf>& y, bool acc, bool lazy) {
+  if (lazy) {
+    if (acc) y.noalias() += l.lazyProduct(r); else y.noalias() = l.lazyProduct(r);
+  } else {
+    if (acc) y.noalias() += l * r; else y.noalias() = l * r;
+  }
+}
+
+// y = op(l) * op(r), or y += op(l) * op(r) if acc is set, where op transposes
+// its argument if the corresponding flag is set
+inline void CPUMatrixMultiply(const Device_CPU & dev, const Eigen::Map<Eigen::MatrixXf>& l, bool l_trans,
+                              const Eigen::Map<Eigen::MatrixXf>& r, bool r_trans, Eigen::Map<Eigen::MatrixXf> y, bool acc) {
+  DYNET_ASSERT(!(l_trans && r_trans), "CPUMatrixMultiply does not transpose both arguments");
+#if HAVE_CBLAS
+  if (y.size() == 0) return;
+  const int inner = l_trans ? l.rows() : l.cols();
+  cblas_sgemm(CblasColMajor, l_trans ? CblasTrans : CblasNoTrans, r_trans ? CblasTrans : CblasNoTrans,
+              y.rows(), y.cols(), inner,
+              1.f, l.data(), std::max<int>(1, l.rows()),
+              r.data(), std::max<int>(1, r.rows()),
+              acc ? 1.f : 0.f, y.data(), y.rows());
+#else
+  // Tiny products are not worth the blocking and packing of Eigen's GEMM
+  const bool lazy = (size_t)y.rows() * y.cols() * (l_trans ? l.rows() : l.cols()) <= DYNET_LAZY_PRODUCT_SIZE;
+  if (l_trans) {
+    CPUMatrixProduct(l.transpose(), r, y, acc, lazy);
+  } else if (r_trans) {
+    CPUMatrixProduct(l, r.transpose(), y, acc, lazy);
+  } else {
+    CPUMatrixProduct(l, r, y, acc, lazy);
+  }
+#endif
+}
+
+// The same product as a tensor contraction, which Eigen spreads over the
+// threads of the device. A system BLAS runs its own threads, so it is used
+// directly when available.
+inline void CPUMatrixMultiply(const Device_CPU_Threaded & dev, const Eigen::Map<Eigen::MatrixXf>& l, bool l_trans,
+                              const Eigen::Map<Eigen::MatrixXf>& r, bool r_trans, Eigen::Map<Eigen::MatrixXf> y, bool acc) {
+#if HAVE_CBLAS
+  CPUMatrixMultiply((const Device_CPU &)dev, l, l_trans, r, r_trans, y, acc);
+#else
+  typedef Eigen::TensorMap<Eigen::Tensor<float, 2>> Matrix;
+  Matrix lt(const_cast<float*>(l.data()), l.rows(), l.cols()), rt(const_cast<float*>(r.data()), r.rows(), r.cols());
+  Matrix yt(y.data(), y.rows(), y.cols());
+  Eigen::array<Eigen::IndexPair<int>, 1> dims = {Eigen::IndexPair<int>(l_trans ? 0 : 1, r_trans ? 1 : 0)};
+  if (acc) yt.device(*dev.edevice) += lt.contract(rt, dims);
+  else yt.device(*dev.edevice) = lt.contract(rt, dims);
+#endif
+}
+
+// y[b] = op(l[b]) * op(r[b]), or y[b] += op(l[b]) * op(r[b]) if acc is set,
+// for every batch element b. Operands with a single batch element are
+// broadcast. If y has a single batch element while the operands do not, all
+// the products are accumulated into it.
+inline void CPUBatchedMatrixMultiply(const Device_CPU & dev, const Tensor& l, bool l_trans,
+                                     const Tensor& r, bool r_trans, Tensor& y, bool acc) {
+  const unsigned n = std::max(std::max(l.d.bd, r.d.bd), y.d.bd);
+  if (y.d.bd != n) {
+    DYNET_ASSERT(acc && y.d.bd == 1, "Bad batch dimensions in CPUBatchedMatrixMultiply: " << l.d << ", " << r.d << ", " << y.d);
+    for (unsigned b = 0; b < n; ++b)
+      CPUMatrixMultiply(dev, l.batch_matrix(b), l_trans, r.batch_matrix(b), r_trans, y.batch_matrix(b), true);
+    return;
+  }
+#if HAVE_MKL
+  // A single call for the whole batch, so MKL packs and dispatches once
+  const MKL_INT m = y.d.rows(), cols = y.d.cols(), k = l_trans ? l.d.rows() : l.d.cols();
+  const MKL_INT lda = std::max<MKL_INT>(1, l.d.rows()), ldb = std::max<MKL_INT>(1, r.d.rows()), ldc = std::max<MKL_INT>(1, m);
+  const MKL_INT group_size = n;
+  const CBLAS_TRANSPOSE ta = l_trans ? CblasTrans : CblasNoTrans, tb = r_trans ? CblasTrans : CblasNoTrans;
+  const float alpha = 1.f, beta = acc ? 1.f : 0.f;
+  std::vector<const float*> ls(n), rs(n);
+  std::vector<float*> ys(n);
+  for (unsigned b = 0; b < n; ++b) {
+    ls[b] = l.batch_ptr(b);
+    rs[b] = r.batch_ptr(b);
+    ys[b] = y.batch_ptr(b);
+  }
+  cblas_sgemm_batch(CblasColMajor, &ta, &tb, &m, &cols, &k, &alpha, &ls[0], &lda, &rs[0], &ldb,
+                    &beta, &ys[0], &ldc, 1, &group_size);
+#else
+  for (unsigned b = 0; b < n; ++b)
+    CPUMatrixMultiply(dev, l.batch_matrix(b), l_trans, r.batch_matrix(b), r_trans, y.batch_matrix(b), acc);
+#endif
+}
+
+// On a threaded device, the batch elements are spread over the threads
+inline void CPUBatchedMatrixMultiply(const Device_CPU_Threaded & dev, const Tensor& l, bool l_trans,
+                                     const Tensor& r, bool r_trans, Tensor& y, bool acc) {
+#if HAVE_MKL
+  CPUBatchedMatrixMultiply((const Device_CPU &)dev, l, l_trans, r, r_trans, y, acc);
+#else
+  const unsigned n = std::max(std::max(l.d.bd, r.d.bd), y.d.bd);
+  if (y.d.bd != n || n == 1) {
+    // All products go to the same output, so each one is parallelized instead
+    for (unsigned b = 0; b < n; ++b)
+      CPUMatrixMultiply(dev, l.batch_matrix(b), l_trans, r.batch_matrix(b), r_trans, y.batch_matrix(b), acc);
+    return;
+  }
+  const double k = l_trans ? l.d.rows() : l.d.cols();
+  const Eigen::TensorOpCost cost(sizeof(float) * (l.d.batch_size() + r.d.batch_size()),
+                                 sizeof(float) * y.d.batch_size(), 2 * k * y.d.batch_size());
+  dev.edevice->parallelFor(n, cost, [&](Eigen::Index first, Eigen::Index last) {
+    for (Eigen::Index b = first; b < last; ++b)
+      CPUMatrixMultiply((const Device_CPU &)dev, l.batch_matrix(b), l_trans, r.batch_matrix(b), r_trans, y.batch_matrix(b), acc);
+  });
+#endif
+}
+#endif
+
+} // namespace dynet
+
+#endif
@@ -34,6 +34,16 @@ namespace dynet {
     extern timespec start_time;
     extern bool stop_requested;
 
+    // Maximum number of data indices sent to a child in a single message
+    const unsigned MAX_CHUNK_SIZE = 256;
+
+    // A chunk of data indices sent through the work queue.
+    // A chunk of size 0 tells the child that the data set is finished.
+    struct WorkChunk {
+      unsigned size;
+      unsigned indices[MAX_CHUNK_SIZE];
+    };
+
     struct WorkloadHeader {
       bool is_dev_set;
       bool end_of_epoch;
@@ -97,6 +107,9 @@ namespace dynet {
     }
 
     std::string generate_queue_name();
+
+    // Capacity of the work queue, in chunks
+    const unsigned WORK_QUEUE_SIZE = 1000;
     std::string generate_shared_memory_name();
 
     dynet::real sum_values(const std::vector<dynet::real>& values);
@@ -108,9 +121,11 @@ namespace dynet {
     std::vector<Workload> create_workloads(unsigned num_children);
 
     // Called by the parent to process a chunk of data
+    // Indices are handed out to the children chunk_size at a time
     template <class S>
     S run_data_set(std::vector<unsigned>::iterator begin, std::vector<unsigned>::iterator end, const std::vector<Workload>& workloads,
-        boost::interprocess::message_queue& mq, const WorkloadHeader& header) {
+        boost::interprocess::message_queue& mq, const WorkloadHeader& header, unsigned chunk_size = 1) {
+      DYNET_ARG_CHECK(chunk_size > 0 && chunk_size <= MAX_CHUNK_SIZE, "Chunk size must be between 1 and " << MAX_CHUNK_SIZE << ", got " << chunk_size);
       const unsigned num_children = workloads.size();
 
       // Tell all the children to start up
@@ -121,18 +136,18 @@ namespace dynet {
       }
 
       // Write all the indices to the queue for the children to process
-      for (auto curr = begin; curr != end; ++curr) {
-        unsigned i = *curr;
-        mq.send(&i, sizeof(i), 0);
-        if (stop_requested) {
-          break;
-        }
+      WorkChunk chunk;
+      for (auto curr = begin; curr != end && !stop_requested; ) {
+        chunk.size = 0;
+        for (; curr != end && chunk.size < chunk_size; ++curr)
+          chunk.indices[chunk.size++] = *curr;
+        mq.send(&chunk, sizeof(unsigned) * (chunk.size + 1), 0);
       }
 
       // Send a bunch of stop messages to the children
+      chunk.size = 0;
       for (unsigned cid = 0; cid < num_children; ++cid) {
-        unsigned stop = -1U;
-        mq.send(&stop, sizeof(stop), (stop_requested ? 1 : 0));
+        mq.send(&chunk, sizeof(unsigned), (stop_requested ? 1 : 0));
       }
 
       // Wait for each child to finish training its load
@@ -150,9 +165,10 @@ namespace dynet {
 
     template<class D, class S>
     void run_parent(const std::vector<D>& train_data, const std::vector<D>& dev_data, ILearner<D, S>* learner,
-       std::vector<Workload>& workloads, unsigned num_iterations, unsigned dev_frequency, unsigned report_frequency) {
+       std::vector<Workload>& workloads, unsigned num_iterations, unsigned dev_frequency, unsigned report_frequency,
+       unsigned chunk_size = 1) {
       const unsigned num_children = workloads.size();
-      boost::interprocess::message_queue mq(boost::interprocess::open_or_create, queue_name.c_str(), 10000, sizeof(unsigned));
+      boost::interprocess::message_queue mq(boost::interprocess::open_or_create, queue_name.c_str(), WORK_QUEUE_SIZE, sizeof(WorkChunk));
       std::vector<unsigned> train_indices(train_data.size());
       std::iota(train_indices.begin(), train_indices.end(), 0);
 
@@ -177,7 +193,7 @@ namespace dynet {
 
           std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
           double fractional_iter = iter + 1.0 * distance(train_indices.begin(), end) / train_indices.size();
-          S batch_loss = run_data_set<S>(begin, end, workloads, mq, {false, end == train_indices.end(), report_frequency});
+          S batch_loss = run_data_set<S>(begin, end, workloads, mq, {false, end == train_indices.end(), report_frequency}, chunk_size);
           std::chrono::steady_clock::time_point end_time = std::chrono::steady_clock::now();
           double seconds_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() / 1000000.0;
           train_loss += batch_loss;
@@ -187,7 +203,7 @@ namespace dynet {
             break;
           }
 
-          S dev_loss = run_data_set<S>(dev_indices.begin(), dev_indices.end(), workloads, mq, {true, false, report_frequency});
+          S dev_loss = run_data_set<S>(dev_indices.begin(), dev_indices.end(), workloads, mq, {true, false, report_frequency}, chunk_size);
           bool new_best = (first_dev_run || dev_loss < best_dev_loss);
           first_dev_run = false;
           std::cerr << fractional_iter << "\t" << "dev loss = " << dev_loss << (new_best ? " (New best!)" : "") << std::endl;
@@ -217,10 +233,10 @@ namespace dynet {
         const std::vector<D>& dev_data) {
       const unsigned num_children = workloads.size();
       DYNET_ASSERT(cid >= 0 && cid < num_children, "Bad child ID " << cid << " in run_child()");
-      unsigned i;
+      WorkChunk chunk;
       unsigned priority;
       boost::interprocess::message_queue::size_type recvd_size;
-      boost::interprocess::message_queue mq(boost::interprocess::open_or_create, queue_name.c_str(), 10000, sizeof(unsigned));
+      boost::interprocess::message_queue mq(boost::interprocess::open_or_create, queue_name.c_str(), WORK_QUEUE_SIZE, sizeof(WorkChunk));
       while (true) {
         // Check if the parent wants us to exit
         bool cont = read_data<bool>(workloads[cid].p2c[0]);
@@ -236,23 +252,35 @@ namespace dynet {
         S batch_loss = S();
         unsigned batch_counter = 0;
         while (true) {
-          mq.receive(&i, sizeof(unsigned), recvd_size, priority);
-          if (i == -1U) {
+          mq.receive(&chunk, sizeof(WorkChunk), recvd_size, priority);
+          if (chunk.size == 0) {
             break;
           }
 
-          DYNET_ASSERT(i < (header.is_dev_set ? dev_data.size() : train_data.size()), "Out-of-bounds ID in MP dev/train set");
-          const D& datum = (header.is_dev_set ? dev_data[i] : train_data[i]);
-          S datum_loss = learner->LearnFromDatum(datum, !header.is_dev_set);
-          total_loss += datum_loss;
-          batch_loss += datum_loss;
-          batch_counter++;
+          // Gradients of the whole chunk are accumulated before taking the locks
+          for (unsigned c = 0; c < chunk.size; ++c) {
+            unsigned i = chunk.indices[c];
+            DYNET_ASSERT(i < (header.is_dev_set ? dev_data.size() : train_data.size()), "Out-of-bounds ID in MP dev/train set");
+            const D& datum = (header.is_dev_set ? dev_data[i] : train_data[i]);
+            S datum_loss = learner->LearnFromDatum(datum, !header.is_dev_set);
+            total_loss += datum_loss;
+            batch_loss += datum_loss;
+            batch_counter++;
+
+            if (batch_counter == header.report_frequency) {
+              if (cid == 0) {
+                std::cerr << (header.is_dev_set ? "dev" : "train") << " loss: " << batch_loss << std::endl;
+              }
+              batch_loss = S();
+              batch_counter = 0;
+            }
+          }
 
           bool do_update = !header.is_dev_set && cid == 0;
           unsigned counter = 0;
           if (!header.is_dev_set) {
             shared_object->counter_mutex.wait();
-            counter = ++shared_object->counter;
+            counter = (shared_object->counter += chunk.size);
             if (do_update) { shared_object->counter = 0; }
             shared_object->counter_mutex.post();
           }
@@ -261,13 +289,6 @@ namespace dynet {
             trainer->update(1.0 / counter); 
             shared_object->update_mutex.post();
           }
-          if (batch_counter == header.report_frequency) {
-            if (cid == 0) {
-              std::cerr << (header.is_dev_set ? "dev" : "train") << " loss: " << batch_loss << std::endl;
-            }
-            batch_loss = S();
-            batch_counter = 0;
-          }
         }
         if (header.end_of_epoch && trainer != nullptr) {
           trainer->update_epoch();
@@ -279,9 +300,13 @@ namespace dynet {
       return 0;
     }
 
+    // Data indices are handed to the children chunk_size at a time, and each
+    // child takes the counter/update locks once per chunk rather than once
+    // per datum, accumulating the gradients of the chunk in the meantime.
     template<class D, class S>
     void run_multi_process(unsigned num_children, ILearner<D, S>* learner, Trainer* trainer, const std::vector<D>& train_data,
-        const std::vector<D>& dev_data, unsigned num_iterations, unsigned dev_frequency, unsigned report_frequency) {
+        const std::vector<D>& dev_data, unsigned num_iterations, unsigned dev_frequency, unsigned report_frequency,
+        unsigned chunk_size = 1) {
       queue_name = generate_queue_name();
       boost::interprocess::message_queue::remove(queue_name.c_str());
       boost::interprocess::message_queue::remove(queue_name.c_str());
@@ -294,7 +319,7 @@ namespace dynet {
         exit(0);
       }
       else {
-        run_parent(train_data, dev_data, learner, workloads, num_iterations, dev_frequency, report_frequency);
+        run_parent(train_data, dev_data, learner, workloads, num_iterations, dev_frequency, report_frequency, chunk_size);
       }
     }
 
@@ -379,9 +404,10 @@ namespace dynet {
     void cleanup(const std::vector<Workload>& workloads);
     
     template<class D, class S>
-    S run_simple_parent(const std::vector<D>& train_data, ILearner<D, S>* learner, std::vector<Workload>& workloads) {
+    S run_simple_parent(const std::vector<D>& train_data, ILearner<D, S>* learner, std::vector<Workload>& workloads,
+        unsigned chunk_size = 1) {
       const unsigned num_children = workloads.size();
-      boost::interprocess::message_queue mq(boost::interprocess::open_or_create, queue_name.c_str(), 10000, sizeof(unsigned));
+      boost::interprocess::message_queue mq(boost::interprocess::open_or_create, queue_name.c_str(), WORK_QUEUE_SIZE, sizeof(WorkChunk));
       std::vector<unsigned> train_indices(train_data.size());
       std::iota(train_indices.begin(), train_indices.end(), 0);
 
@@ -389,7 +415,7 @@ namespace dynet {
 
       std::vector<unsigned>::iterator begin = train_indices.begin();
       std::vector<unsigned>::iterator end = train_indices.end();
-      S batch_loss = run_data_set<S>(begin, end, workloads, mq, {false, true, (unsigned)-1});
+      S batch_loss = run_data_set<S>(begin, end, workloads, mq, {false, true, (unsigned)-1}, chunk_size);
       train_loss += batch_loss;
 
       // Kill all children one by one and wait for them to exit
@@ -403,7 +429,7 @@ namespace dynet {
     }
 
     template<class D, class S>
-    S run_mp_minibatch(unsigned num_children, ILearner<D, S>* learner, const std::vector<D>& data) {
+    S run_mp_minibatch(unsigned num_children, ILearner<D, S>* learner, const std::vector<D>& data, unsigned chunk_size = 1) {
       queue_name = generate_queue_name();
       boost::interprocess::message_queue::remove(queue_name.c_str());
       boost::interprocess::message_queue::remove(queue_name.c_str());
@@ -418,7 +444,7 @@ namespace dynet {
         exit(0);
       }
       else {
-        S return_value = run_simple_parent(data, learner, workloads);
+        S return_value = run_simple_parent(data, learner, workloads, chunk_size);
         cleanup(workloads);
         return return_value;
       }
@@ -441,7 +467,8 @@ namespace dynet {
     }
 
     template<class D, class S>
-    S run_mp_minibatch_trainer(unsigned num_children, ILearner<D, S>* learner, Trainer* inputTrainer, const std::vector<D>& data) {
+    S run_mp_minibatch_trainer(unsigned num_children, ILearner<D, S>* learner, Trainer* inputTrainer, const std::vector<D>& data,
+        unsigned chunk_size = 1) {
       queue_name = generate_queue_name();
       boost::interprocess::message_queue::remove(queue_name.c_str());
       boost::interprocess::message_queue::remove(queue_name.c_str());
@@ -456,7 +483,7 @@ namespace dynet {
         exit(0);
       }
       else {
-        S return_value = run_simple_parent(data, learner, workloads);
+        S return_value = run_simple_parent(data, learner, workloads, chunk_size);
         cleanup(workloads);
         return return_value;
       }
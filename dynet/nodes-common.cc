@@ -78,8 +78,8 @@ string SelectRows::as_string(const vector<string>& arg_names) const {
 Dim SelectRows::dim_forward(const vector<Dim>& xs) const {
   DYNET_ARG_CHECK(xs.size() == 1 && xs[0].ndims() == 2, "Bad arguments in SelectRows: " << xs);
   unsigned nrows = prows->size();
-  if (xs[0].ndims() == 1) return Dim({nrows});
-  return Dim({nrows, xs[0].cols()});
+  if (xs[0].ndims() == 1) return Dim({nrows}, xs[0].bd);
+  return Dim({nrows, xs[0].cols()}, xs[0].bd);
 }
 
 string SelectCols::as_string(const vector<string>& arg_names) const {
@@ -91,7 +91,7 @@ string SelectCols::as_string(const vector<string>& arg_names) const {
 Dim SelectCols::dim_forward(const vector<Dim>& xs) const {
   DYNET_ARG_CHECK(xs.size() == 1 && xs[0].ndims() == 2, "Bad arguments in SelectCols: " << xs);
   unsigned ncols = pcols->size();
-  return Dim({xs[0].rows(), ncols});
+  return Dim({xs[0].rows(), ncols}, xs[0].bd);
 }
 
 string Min::as_string(const vector<string>& arg_names) const {
@@ -199,7 +199,7 @@ Dim KMHNGram::dim_forward(const vector<Dim>& xs) const {
   DYNET_ARG_CHECK(xs[0].ndims() == 2, "Bad input dimensions in KMHNGram: " << xs);
   const unsigned new_cols = xs[0].cols() - n + 1;
   DYNET_ARG_CHECK(new_cols >= 1, "Bad input dimensions in KMHNGram: " << xs);
-  return Dim({xs[0][0], new_cols});
+  return Dim({xs[0][0], new_cols}, xs[0].bd);
 }
 
 string GaussianNoise::as_string(const vector<string>& arg_names) const {
@@ -987,7 +987,7 @@ string PoissonRegressionLoss::as_string(const vector<string>& arg_names) const {
 }
 
 Dim PoissonRegressionLoss::dim_forward(const vector<Dim>& xs) const {
-  DYNET_ARG_CHECK(xs.size() == 1 && xs[0].size() == 1, "Bad input dimensions in PoissonRegressionLoss: " << xs);
+  DYNET_ARG_CHECK(xs.size() == 1 && xs[0].batch_size() == 1, "Bad input dimensions in PoissonRegressionLoss: " << xs);
   return xs[0];
 }
 
@@ -1148,4 +1148,170 @@ Dim WeightNormalization::dim_forward(const vector<Dim>& xs) const {
   return xs[0];
 }
 
+string LSTMCell::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << "lstm_cell(" << arg_names[0];
+  for (unsigned i = 1; i < arg_names.size(); ++i)
+    s << ", " << arg_names[i];
+  s << ", coupled=" << coupled << ", output_gate=" << output_gate << ", forget_bias=" << forget_bias << ')';
+  return s.str();
+}
+
+Dim LSTMCell::dim_forward(const vector<Dim>& xs) const {
+  DYNET_ARG_CHECK(xs.size() == 1 || xs.size() == 2 || xs.size() == 4, "Failed input count check in LSTMCell");
+  DYNET_ARG_CHECK(coupled || output_gate, "LSTMCell without an output gate must couple the input and forget gates");
+  const unsigned ng = num_gates();
+  DYNET_ARG_CHECK(xs[0].cols() == 1 && xs[0].rows() % ng == 0,
+                          "Bad gate dimensions in LSTMCell, expected " << ng << " stacked vectors: " << xs);
+  const unsigned hid = xs[0].rows() / ng;
+  const unsigned bd = max(xs[0].bd, xs.size() > 1 ? xs[1].bd : 1);
+  for (unsigned i = 0; i < xs.size(); ++i) {
+    DYNET_ARG_CHECK((i == 0 || xs[i].batch_size() == hid) && (xs[i].bd == 1 || (i < 2 && xs[i].bd == bd)),
+                            "Bad input dimensions in LSTMCell: " << xs);
+  }
+  return Dim({hid * (output_gate ? 2 : 1)}, bd);
+}
+
+string GRUCell::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << "gru_cell(" << arg_names[0];
+  for (unsigned i = 1; i < arg_names.size(); ++i)
+    s << ", " << arg_names[i];
+  s << ')';
+  return s.str();
+}
+
+Dim GRUCell::dim_forward(const vector<Dim>& xs) const {
+  DYNET_ARG_CHECK(xs.size() == 1 || xs.size() == 5, "Failed input count check in GRUCell");
+  DYNET_ARG_CHECK(xs[0].cols() == 1 && xs[0].rows() % 3 == 0,
+                          "Bad gate dimensions in GRUCell, expected 3 stacked vectors: " << xs);
+  const unsigned hid = xs[0].rows() / 3;
+  if (xs.size() == 1)
+    return Dim({hid}, xs[0].bd);
+  const unsigned bd = max(xs[0].bd, xs[1].bd);
+  DYNET_ARG_CHECK(xs[1].batch_size() == hid && (xs[0].bd == 1 || xs[0].bd == bd) && (xs[1].bd == 1 || xs[1].bd == bd),
+                          "Bad input dimensions in GRUCell: " << xs);
+  for (unsigned i = 2; i < 5; ++i)
+    DYNET_ARG_CHECK(xs[i].bd == 1 && xs[i].rows() == hid && xs[i].cols() == hid,
+                            "Bad recurrent weight dimensions in GRUCell: " << xs);
+  return Dim({hid}, bd);
+}
+
+string LSTMSequence::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << "lstm_sequence(" << arg_names[0];
+  for (unsigned i = 1; i < arg_names.size(); ++i)
+    s << ", " << arg_names[i];
+  s << ", forget_bias=" << forget_bias << ')';
+  return s.str();
+}
+
+Dim LSTMSequence::dim_forward(const vector<Dim>& xs) const {
+  DYNET_ARG_CHECK(xs.size() == 4 || xs.size() == 6, "Failed input count check in LSTMSequence");
+  const unsigned hid = xs[2].cols();
+  input_dim = xs[0].rows();
+  DYNET_ARG_CHECK(xs[0].nd <= 2 && xs[1].rows() == 4 * hid && xs[1].cols() == input_dim &&
+                  xs[2].rows() == 4 * hid && xs[3].rows() == 4 * hid && xs[3].cols() == 1 &&
+                  xs[1].bd == 1 && xs[2].bd == 1 && xs[3].bd == 1,
+                  "Bad input dimensions in LSTMSequence: " << xs);
+  unsigned bd = xs[0].bd;
+  for (unsigned i = 4; i < xs.size(); ++i)
+    bd = max(bd, xs[i].bd);
+  DYNET_ARG_CHECK(xs[0].bd == 1 || xs[0].bd == bd, "Bad batch dimensions in LSTMSequence: " << xs);
+  for (unsigned i = 4; i < xs.size(); ++i)
+    DYNET_ARG_CHECK(xs[i].batch_size() == hid && (xs[i].bd == 1 || xs[i].bd == bd),
+                    "Bad initial state dimensions in LSTMSequence: " << xs);
+  return Dim({hid, xs[0].cols(), 2}, bd);
+}
+
+string GRUSequence::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << "gru_sequence(" << arg_names[0];
+  for (unsigned i = 1; i < arg_names.size(); ++i)
+    s << ", " << arg_names[i];
+  s << ')';
+  return s.str();
+}
+
+Dim GRUSequence::dim_forward(const vector<Dim>& xs) const {
+  DYNET_ARG_CHECK(xs.size() == 5 || xs.size() == 6, "Failed input count check in GRUSequence");
+  const unsigned hid = xs[4].cols();
+  input_dim = xs[0].rows();
+  DYNET_ARG_CHECK(xs[0].nd <= 2 && xs[1].rows() == 3 * hid && xs[1].cols() == input_dim &&
+                  xs[2].rows() == 3 * hid && xs[2].cols() == 1 &&
+                  xs[3].rows() == 2 * hid && xs[3].cols() == hid && xs[4].rows() == hid &&
+                  xs[1].bd == 1 && xs[2].bd == 1 && xs[3].bd == 1 && xs[4].bd == 1,
+                  "Bad input dimensions in GRUSequence: " << xs);
+  unsigned bd = xs[0].bd;
+  if (xs.size() == 6) {
+    DYNET_ARG_CHECK(xs[5].batch_size() == hid, "Bad initial state dimensions in GRUSequence: " << xs);
+    bd = max(bd, xs[5].bd);
+    DYNET_ARG_CHECK((xs[0].bd == 1 || xs[0].bd == bd) && (xs[5].bd == 1 || xs[5].bd == bd),
+                    "Bad batch dimensions in GRUSequence: " << xs);
+  }
+  return Dim({hid, xs[0].cols()}, bd);
+}
+
+string AffinePickNegLogSoftmax::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << "log_softmax(" << arg_names[0] << " + " << arg_names[1] << " * " << arg_names[2] << ")_{";
+  if(pval) {
+    s << *pval;
+  } else {
+    string sep = "";
+    for(auto v : *pvals) { s << sep << v; sep = ","; }
+  }
+  s << "}, tile_size=" << tile_size;
+  return s.str();
+}
+
+Dim AffinePickNegLogSoftmax::dim_forward(const vector<Dim>& xs) const {
+  DYNET_ARG_CHECK(xs.size() == 3, "Failed input count check in AffinePickNegLogSoftmax");
+  DYNET_ARG_CHECK(xs[1].ndims() == 2 && LooksLikeVector(xs[0]) && xs[0].rows() == xs[1].rows() &&
+                  LooksLikeVector(xs[2]) && xs[2].rows() == xs[1].cols() && xs[0].bd == 1 && xs[1].bd == 1,
+                  "Bad input dimensions in AffinePickNegLogSoftmax: " << xs);
+  DYNET_ARG_CHECK(tile_size > 0, "AffinePickNegLogSoftmax needs a positive tile size");
+  DYNET_ARG_CHECK((pval == nullptr || xs[2].bd == 1),
+                  "AffinePickNegLogSoftmax was called with a single ID (" << *pval <<
+                  "), but the expression under consideration had multiple mini-batch elements (" <<
+                  xs[2].bd << "). A vector of IDs of size " << xs[2].bd << " must be passed instead.");
+  DYNET_ARG_CHECK((pvals == nullptr || xs[2].bd == pvals->size()),
+                  "The number of IDs passed to AffinePickNegLogSoftmax (" << pvals->size() <<
+                  "), did not match the number of mini-batch elements in the expression under consideration (" <<
+                  xs[2].bd << "). These numbers must match.");
+  vocab_size = xs[1].rows();
+  rep_dim = xs[1].cols();
+  return Dim({1}, xs[2].bd);
+}
+
+string ScaledDotProductAttention::as_string(const vector<string>& arg_names) const {
+  ostringstream s;
+  s << arg_names[2] << " * softmax(transpose(" << arg_names[1] << ") * " << arg_names[0] << " / sqrt(d)";
+  if (arg_names.size() == 4)
+    s << " + " << arg_names[3];
+  s << "), tile_size=" << tile_size;
+  return s.str();
+}
+
+Dim ScaledDotProductAttention::dim_forward(const vector<Dim>& xs) const {
+  DYNET_ARG_CHECK(xs.size() == 3 || xs.size() == 4, "Failed input count check in ScaledDotProductAttention");
+  DYNET_ARG_CHECK(xs[0].ndims() <= 2 && xs[1].ndims() <= 2 && xs[2].ndims() <= 2 &&
+                  xs[0].rows() == xs[1].rows() && xs[1].cols() == xs[2].cols(),
+                  "Bad input dimensions in ScaledDotProductAttention: " << xs);
+  if (xs.size() == 4)
+    DYNET_ARG_CHECK(xs[3].ndims() <= 2 && xs[3].rows() == xs[1].cols() &&
+                    (xs[3].cols() == 1 || xs[3].cols() == xs[0].cols()),
+                    "Bad mask dimensions in ScaledDotProductAttention: " << xs);
+  DYNET_ARG_CHECK(tile_size > 0, "ScaledDotProductAttention needs a positive tile size");
+  unsigned bd = 1;
+  for (auto& x : xs) {
+    DYNET_ARG_CHECK(x.bd == 1 || bd == 1 || x.bd == bd, "Bad batch dimensions in ScaledDotProductAttention: " << xs);
+    bd = max(bd, x.bd);
+  }
+  num_keys = xs[1].cols();
+  if (xs[0].ndims() == 1)
+    return Dim({xs[2].rows()}, bd);
+  return Dim({xs[2].rows(), xs[0].cols()}, bd);
+}
+
 } // namespace dynet
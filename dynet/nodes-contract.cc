@@ -5,6 +5,7 @@
 #include <stdexcept>
 
 #include "dynet/nodes-macros.h"
+#include "dynet/matrix-multiply.h"
 
 // This file takes a long time to compile on GPU. Uncomment this line to skip it.
 #define DYNET_SKIP_CUDA_CONTRACTIONS
@@ -73,7 +74,18 @@ template<class MyDevice>
 void InnerProduct3D_1D::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
 #if defined(__CUDACC__) && defined(DYNET_SKIP_CUDA_CONTRACTIONS)
   throw std::runtime_error("InnerProduct3D_1D::forward_dev_impl disabled on CUDA. Comment out DYNET_SKIP_CUDA_CONTRACTIONS in nodes-contract.cc to enable this function.");
+#elif !defined(__CUDACC__)
+  // With A seen as an (i*j, k) matrix, this is a matrix-vector product for
+  // every batch element
+  const unsigned ij = xs[0]->d[0] * xs[0]->d[1], k = xs[0]->d[2];
+  const Tensor A(Dim({ij, k}, xs[0]->d.bd), xs[0]->v, xs[0]->device, xs[0]->mem_pool);
+  const Tensor b(Dim({k, 1}, xs[1]->d.bd), xs[1]->v, xs[1]->device, xs[1]->mem_pool);
+  Tensor y(Dim({ij, 1}, fx.d.bd), fx.v, fx.device, fx.mem_pool);
+  if (xs.size() == 3)
+    y.tvec().device(*dev.edevice) = xs[2]->tvec();
+  CPUBatchedMatrixMultiply(dev, A, false, b, false, y, xs.size() == 3);
 #else
+  DYNET_ARG_CHECK(fx.d.bd == 1, "InnerProduct3D_1D does not support minibatches on CUDA");
   auto A = xs[0]->t<3>();
   auto b = xs[1]->t<1>();
   typedef Eigen::Tensor<float, 1>::DimensionPair DimPair;
@@ -96,7 +108,25 @@ void InnerProduct3D_1D::backward_dev_impl(const MyDevice & dev,
                              Tensor& dEdxi) const {
 #if defined(__CUDACC__) && defined(DYNET_SKIP_CUDA_CONTRACTIONS)
   throw std::runtime_error("InnerProduct3D_1D::backward_dev_impl disabled on CUDA. Comment out DYNET_SKIP_CUDA_CONTRACTIONS in nodes-contract.cc to enable this function.");
+#elif !defined(__CUDACC__)
+  // Inputs with a single batch element accumulate the products of all of them
+  const unsigned ij = xs[0]->d[0] * xs[0]->d[1], k = xs[0]->d[2];
+  const Tensor df(Dim({ij, 1}, dEdf.d.bd), dEdf.v, dEdf.device, dEdf.mem_pool);
+  if (i == 0) { // outer product of dEdf and b
+    const Tensor b(Dim({k, 1}, xs[1]->d.bd), xs[1]->v, xs[1]->device, xs[1]->mem_pool);
+    Tensor dA(Dim({ij, k}, dEdxi.d.bd), dEdxi.v, dEdxi.device, dEdxi.mem_pool);
+    CPUBatchedMatrixMultiply(dev, df, false, b, true, dA, true);
+  } else if (i == 1) {
+    const Tensor A(Dim({ij, k}, xs[0]->d.bd), xs[0]->v, xs[0]->device, xs[0]->mem_pool);
+    Tensor db(Dim({k, 1}, dEdxi.d.bd), dEdxi.v, dEdxi.device, dEdxi.mem_pool);
+    CPUBatchedMatrixMultiply(dev, A, true, df, false, db, true);
+  } else if (i == 2) {
+    dEdxi.tvec().device(*dev.edevice) += dEdf.tvec();
+  } else {
+    throw std::runtime_error("Illegal configuration in InnerProduct3D");
+  }
 #else
+  DYNET_ARG_CHECK(fx.d.bd == 1, "InnerProduct3D_1D does not support minibatches on CUDA");
   auto tdEdf = dEdf.t<2>();  // 2 tensor
   typedef Eigen::Tensor<float, 1>::DimensionPair DimPair;
   if (i == 0) { // 3 tensor
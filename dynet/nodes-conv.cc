@@ -46,7 +46,7 @@ Dim FoldRows::dim_forward(const vector<Dim>& xs) const {
     ostringstream s; s << "Bad input dimensions in FoldRows: " << xs;
     throw std::invalid_argument(s.str());
   }
-  return Dim({orows, xs[0].cols()});
+  return Dim({orows, xs[0].cols()}, xs[0].bd);
 }
 
 /* Deprecated
@@ -110,8 +110,10 @@ Dim Filter1DNarrow::dim_forward(const vector<Dim>& xs) const {
     ostringstream s; s << "Bad input dimensions in Filter1DNarrow: " << xs;
     throw std::invalid_argument(s.str());
   }
+  DYNET_ARG_CHECK(xs[0].bd == 1 || xs[1].bd == 1 || xs[0].bd == xs[1].bd,
+                  "Mismatched batch sizes in Filter1DNarrow: " << xs);
   const unsigned fids = (xs[1].ndims() > 2 ? xs[1][2] : 1);
-  return Dim({fids, (unsigned)ocols});
+  return Dim({fids, (unsigned)ocols}, max(xs[0].bd, xs[1].bd));
 }
 
 string KMaxPooling::as_string(const vector<string>& arg_names) const {
@@ -252,79 +254,135 @@ void Conv1DWide::backward_dev_impl(const MyDevice & dev,
 DYNET_NODE_INST_DEV_IMPL(Conv1DWide)
 */
 
+#ifdef __CUDACC__
+// One batch element of Filter1DNarrow, with Eigen's tensor convolution
 template<class MyDevice>
-void Filter1DNarrow::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+void filter1d_narrow_forward(const MyDevice & dev, const Tensor& x, const Tensor& f, Tensor& y) {
   const Eigen::array<Eigen::DenseIndex, 2> dims = {0, 1};
-  if(xs[1]->d.ndims() == 2) {
-    fx.t<2>().device(*dev.edevice) = xs[0]->t<2>().convolve(xs[1]->t<2>(), dims);
+  if(f.d.ndims() == 2) {
+    y.t<2>().device(*dev.edevice) = x.t<2>().convolve(f.t<2>(), dims);
   } else {
-    DYNET_ASSERT(xs[1]->d.ndims() > 2, "Input to Filter1DNarrow must have 2 or more dimensions");
-    const unsigned fids = xs[1]->d[2];
-    const unsigned ycols = dim.cols();
+    const unsigned fids = f.d[2];
+    const unsigned ycols = y.d.cols();
     Eigen::DSizes<ptrdiff_t, 2> indices(0,0);
     Eigen::DSizes<ptrdiff_t, 2> sizes(1,ycols);
     for(unsigned fid = 0; fid < fids; ++fid) {
       indices[0] = fid;
-#if defined(__CUDACC__) && defined(EIGEN_NO_MALLOC)
+#if defined(EIGEN_NO_MALLOC)
       throw std::runtime_error("CUDA memory allocation in Filter1DNarrow");
 #endif
-      fx.t<2>().slice(indices, sizes).device(*dev.edevice) = xs[0]->t<2>().convolve(xs[1]->t<3>().chip<2>(fid), dims);
+      y.t<2>().slice(indices, sizes).device(*dev.edevice) = x.t<2>().convolve(f.t<3>().chip<2>(fid), dims);
     }
   }
 }
 
 template<class MyDevice>
-void Filter1DNarrow::backward_dev_impl(const MyDevice & dev,
-                             const vector<const Tensor*>& xs,
-                             const Tensor& fx,
-                             const Tensor& dEdf,
-                             unsigned i,
-                             Tensor& dEdxi) const {
-  DYNET_ASSERT(i < 2, "Failed input count check in Filter1DNarrow");
-  const unsigned rows = xs[1]->d.rows();
-  const unsigned ycols = dim.cols();
-  const unsigned fcols = xs[1]->d.cols();
-  const unsigned fids = (xs[1]->d.ndims() > 2 ? xs[1]->d[2] : 1);
+void filter1d_narrow_backward(const MyDevice & dev, const Tensor& x, const Tensor& f, const Tensor& dEdf, unsigned i, Tensor& dEdxi) {
+  const unsigned rows = f.d.rows();
+  const unsigned ycols = dEdf.d.cols();
+  const unsigned fcols = f.d.cols();
+  const unsigned fids = (f.d.ndims() > 2 ? f.d[2] : 1);
   Eigen::DSizes<ptrdiff_t, 2> sizes(rows,fcols);
   Eigen::DSizes<ptrdiff_t, 2> indices(0,0);
-  // TODO: This implementation is by no means optimized. Is there a better way to do it?
   vector<float> dEdf_vec = as_vector(dEdf);
   if(i == 0) {
     for(unsigned i = 0; i < ycols; i++) {
       indices[1] = i;
       if(fids == 1) {
-        dEdxi.t<2>().slice(indices, sizes).device(*dev.edevice) += xs[1]->t<2>() * dEdf_vec[i];
+        dEdxi.t<2>().slice(indices, sizes).device(*dev.edevice) += f.t<2>() * dEdf_vec[i];
       } else {
         for(unsigned fid = 0; fid < fids; fid++)
-          dEdxi.t<2>().slice(indices, sizes).device(*dev.edevice) += xs[1]->t<3>().chip<2>(fid) * dEdf_vec[fid + i * fids];
+          dEdxi.t<2>().slice(indices, sizes).device(*dev.edevice) += f.t<3>().chip<2>(fid) * dEdf_vec[fid + i * fids];
       }
     }
   } else {
     for(unsigned i = 0; i < ycols; i++) {
       indices[1] = i;
       if(fids == 1) {
-        dEdxi.t<2>().device(*dev.edevice) += xs[0]->t<2>().slice(indices, sizes) * dEdf_vec[i];
+        dEdxi.t<2>().device(*dev.edevice) += x.t<2>().slice(indices, sizes) * dEdf_vec[i];
       } else {
         for(unsigned fid = 0; fid < fids; fid++)
-          dEdxi.t<3>().chip<2>(fid).device(*dev.edevice) += xs[0]->t<2>().slice(indices, sizes) * dEdf_vec[fid + i * fids];
+          dEdxi.t<3>().chip<2>(fid).device(*dev.edevice) += x.t<2>().slice(indices, sizes) * dEdf_vec[fid + i * fids];
       }
     }
   }
 }
+#else
+// The windows of m consecutive columns of a d x s matrix x, as the columns
+// of a (d*m) x (s-m+1) matrix. Column-major windows are contiguous and
+// overlap, so this is im2col without the copy: the matrix is read in place
+// with an outer stride of d.
+typedef Eigen::Map<const Eigen::MatrixXf, 0, Eigen::OuterStride<> > ConstStridedMatrix;
+inline ConstStridedMatrix filter1d_windows(const float* x, unsigned rows, unsigned fcols, unsigned ycols) {
+  return ConstStridedMatrix(x, rows * fcols, ycols, Eigen::OuterStride<>(rows));
+}
+#endif
+
+template<class MyDevice>
+void Filter1DNarrow::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+#ifdef __CUDACC__
+  for(unsigned b = 0; b < fx.d.bd; ++b) {
+    Tensor y = fx.batch_elem(b);
+    filter1d_narrow_forward(dev, xs[0]->batch_elem(b), xs[1]->batch_elem(b), y);
+  }
+#else
+  // Seen as a (d*m) x F matrix, the filter is multiplied with all windows of
+  // x at once: y = f^T * windows(x), one GEMM per batch element
+  const unsigned rows = xs[0]->d.rows(), fcols = xs[1]->d.cols();
+  const unsigned fids = fx.d.rows(), ycols = fx.d.cols();
+  for(unsigned b = 0; b < fx.d.bd; ++b) {
+    Eigen::Map<const Eigen::MatrixXf> f(xs[1]->batch_ptr(b), rows * fcols, fids);
+    fx.batch_matrix(b).noalias() = f.transpose() * filter1d_windows(xs[0]->batch_ptr(b), rows, fcols, ycols);
+  }
+#endif
+}
+
+template<class MyDevice>
+void Filter1DNarrow::backward_dev_impl(const MyDevice & dev,
+                             const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+  DYNET_ASSERT(i < 2, "Failed input count check in Filter1DNarrow");
+#ifdef __CUDACC__
+  for(unsigned b = 0; b < dEdf.d.bd; ++b) {
+    Tensor dEdxi_b = dEdxi.batch_elem(b);
+    filter1d_narrow_backward(dev, xs[0]->batch_elem(b), xs[1]->batch_elem(b), dEdf.batch_elem(b), i, dEdxi_b);
+  }
+#else
+  const unsigned rows = xs[0]->d.rows(), fcols = xs[1]->d.cols();
+  const unsigned fids = fx.d.rows(), ycols = fx.d.cols();
+  for(unsigned b = 0; b < dEdf.d.bd; ++b) {
+    const Eigen::Map<Eigen::MatrixXf> dEdy = dEdf.batch_matrix(b);
+    if(i == 0) {
+      // The windows overlap, so their gradients are added one filter column
+      // at a time: dx[:, k:k+ycols] += f_k * dEdy, with f_k the d x F matrix
+      // of column k of every filter
+      for(unsigned k = 0; k < fcols; ++k) {
+        ConstStridedMatrix fk(xs[1]->batch_ptr(b) + k * rows, rows, fids, Eigen::OuterStride<>(rows * fcols));
+        Eigen::Map<Eigen::MatrixXf>(dEdxi.batch_ptr(b) + k * rows, rows, ycols).noalias() += fk * dEdy;
+      }
+    } else {
+      // Filters shared by the whole batch get the sum of its gradients
+      Eigen::Map<Eigen::MatrixXf>(dEdxi.batch_ptr(b), rows * fcols, fids).noalias() +=
+        filter1d_windows(xs[0]->batch_ptr(b), rows, fcols, ycols) * dEdy.transpose();
+    }
+  }
+#endif
+}
 DYNET_NODE_INST_DEV_IMPL(Filter1DNarrow)
 
 
 template<class MyDevice>
 void FoldRows::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
-  unsigned orows = fx.d.rows();
-  for (unsigned i = 0; i < orows; ++i) {
-    fx.tb<2>().chip<0>(i).device(*dev.edevice) = xs[0]->tb<2>().chip<0>(i * nrows);
-    for (unsigned j = 1; j < nrows; ++j) 
-      fx.tb<2>().chip<0>(i).device(*dev.edevice) += xs[0]->tb<2>().chip<0>(i * nrows + j); 
-  }
-  // TODO: This broadcasting should work?
-  // array<ptrdiff_t, 1> broadcasts; broadcasts[0] = nrows;
-  // fx.tvec().broadcast(broadcasts).device(*dev.edevice) += xs[0]->tvec();
+  // Row i of the output sums rows i*nrows..(i+1)*nrows-1 of the input, so
+  // seen as a {nrows, orows, cols*bd} tensor the input is summed over its
+  // first dimension
+  const Eigen::array<Eigen::DenseIndex, 3> morph = {nrows, fx.d.rows(), fx.d.size() / fx.d.rows()};
+  const Eigen::array<Eigen::DenseIndex, 1> red_axis = {0};
+  const Eigen::array<Eigen::DenseIndex, 1> flat = {(Eigen::DenseIndex)fx.d.size()};
+  fx.tvec().device(*dev.edevice) = xs[0]->tvec().reshape(morph).sum(red_axis).reshape(flat);
 }
 
 template<class MyDevice>
@@ -334,12 +392,10 @@ void FoldRows::backward_dev_impl(const MyDevice & dev,
                              const Tensor& dEdf,
                              unsigned i,
                              Tensor& dEdxi) const {
-  const Eigen::array<Eigen::DenseIndex, 1> broadcasts = {nrows};
-  dEdxi.tvec().device(*dev.edevice) += dEdf.tvec().broadcast(broadcasts);
-  // unsigned orows = fx.d.rows();
-  // for (unsigned i = 0; i < orows; ++i)
-  //   for (unsigned j = 0; j < nrows; ++j)
-  //     dEdxi.tb<2>().chip<0>(i * nrows + j) += d.tb<2>().chip<0>(i);
+  const Eigen::array<Eigen::DenseIndex, 3> morph = {1, fx.d.rows(), fx.d.size() / fx.d.rows()};
+  const Eigen::array<Eigen::DenseIndex, 3> broadcasts = {nrows, 1, 1};
+  const Eigen::array<Eigen::DenseIndex, 1> flat = {(Eigen::DenseIndex)xs[0]->d.size()};
+  dEdxi.tvec().device(*dev.edevice) += dEdf.tvec().reshape(morph).broadcast(broadcasts).reshape(flat);
 }
 DYNET_NODE_INST_DEV_IMPL(FoldRows)
 
@@ -348,45 +404,59 @@ void KMaxPooling::forward_dev_impl(const MyDevice & dev, const vector<const Tens
 #ifdef __CUDACC__
     // TODO: The code that works on CPU does not compile on CUDA
     throw std::runtime_error("KMaxPooling::forward_dev_impl not working on CUDA yet");
-#endif
+#else
+  // Seen as inner x n x outer, with the pooled dimension in the middle, x
+  // holds inner * outer fibers of length n, and fx and maxmap hold the k
+  // selected elements of each fiber in the same layout. Every inner x n
+  // block of x is read once, in memory order, so that all of its fibers
+  // are scanned side by side. The slots of a fiber in fx and maxmap keep the
+  // best elements seen so far, sorted by decreasing value, and are put back
+  // in their original order at the end of the block.
   Eigen::DenseIndex* maxmap = static_cast<Eigen::DenseIndex*>(aux_mem);
-  Eigen::TensorMap<Eigen::Tensor<Eigen::DenseIndex, 4>> locs(maxmap, dim[0], dim[1], dim[2], dim.batch_elems());
-  const unsigned batch_size = dim.batch_elems();
-  const unsigned first_dim_size = dim[first_dim];
-  const unsigned second_dim_size = dim[second_dim];
-  Eigen::Tensor<float, 1> tmp(xs[0]->d[pooled_dim]);
-  for (unsigned b = 0; b < batch_size; ++b){
-    for (unsigned j = 0; j < second_dim_size; ++j){
-      for (unsigned i = 0; i < first_dim_size; ++i){
-        // get nth element
-        tmp.device(*dev.edevice) = xs[0]->tb<3>().chip<3>(b).chip(j, second_dim).chip(i, first_dim);
-        nth_element(tmp.data(), tmp.data()+(k-1), tmp.data()+tmp.size(), std::greater<float>());
-        const float c = tmp.data()[k-1];
-        // calculate fx and indices
-        tmp.device(*dev.edevice) = xs[0]->tb<3>().chip<3>(b).chip(j, second_dim).chip(i, first_dim);
-        unsigned tt = 0;
-        for (unsigned l = 0; l < tmp.size(); ++l) {
-          const float tensor_val = tmp.data()[l];
-          if (tensor_val >= c) {
-            if (pooled_dim > second_dim){
-              fx.tb<3>().chip<3>(b).chip(tt, pooled_dim).chip(j, second_dim).chip(i, first_dim).device(*dev.edevice) = tmp.chip<0>(l);
-              locs(i, j, tt, b) = l;
-            }
-            else if (pooled_dim > first_dim){
-              fx.tb<3>().chip<3>(b).chip(j, second_dim).chip(tt, pooled_dim).chip(i, first_dim).device(*dev.edevice) = tmp.chip<0>(l);
-              locs(i, tt, j, b) = l;
-            }
-            else {
-              fx.tb<3>().chip<3>(b).chip(j, second_dim).chip(i, first_dim).chip(tt, pooled_dim).device(*dev.edevice) = tmp.chip<0>(l);
-              locs(tt, i, j, b) = l;
-            }
-            ++tt;
-            if (tt == k) break;  // could happen in case of ties
-          }
-        } 
+  unsigned inner = 1, outer = dim.batch_elems();
+  for (unsigned d = 0; d < pooled_dim; ++d) inner *= dim[d];
+  for (unsigned d = pooled_dim + 1; d < dim.nd; ++d) outer *= dim[d];
+  const unsigned n = xs[0]->d[pooled_dim];
+  for (unsigned o = 0; o < outer; ++o) {
+    const float* x = xs[0]->v + (size_t)o * inner * n;
+    float* vals = fx.v + (size_t)o * inner * k;
+    Eigen::DenseIndex* locs = maxmap + (size_t)o * inner * k;
+    for (unsigned l = 0; l < n; ++l, x += inner) {
+      // All fibers have seen l elements, so their first min(l, k) slots are
+      // filled. On ties the earlier element wins, by only passing over
+      // strictly smaller ones.
+      const unsigned filled = std::min(l, k);
+      for (unsigned i = 0; i < inner; ++i) {
+        const float v = x[i];
+        unsigned t = filled;
+        if (t == k) {
+          if (!(v > vals[i + (k - 1) * inner])) continue;
+          --t;
+        }
+        for (; t > 0 && vals[i + (t - 1) * inner] < v; --t) {
+          vals[i + t * inner] = vals[i + (t - 1) * inner];
+          locs[i + t * inner] = locs[i + (t - 1) * inner];
+        }
+        vals[i + t * inner] = v;
+        locs[i + t * inner] = l;
+      }
+    }
+    // Back to the order of the input, by insertion sort on the k slots
+    for (unsigned i = 0; i < inner; ++i) {
+      for (unsigned t = 1; t < k; ++t) {
+        const float v = vals[i + t * inner];
+        const Eigen::DenseIndex loc = locs[i + t * inner];
+        unsigned u = t;
+        for (; u > 0 && locs[i + (u - 1) * inner] > loc; --u) {
+          vals[i + u * inner] = vals[i + (u - 1) * inner];
+          locs[i + u * inner] = locs[i + (u - 1) * inner];
+        }
+        vals[i + u * inner] = v;
+        locs[i + u * inner] = loc;
       }
     }
   }
+#endif
 }
 
 template<class MyDevice>
@@ -401,9 +471,6 @@ void KMaxPooling::backward_dev_impl(const MyDevice & dev,
   vector<Eigen::DenseIndex> indices(dim.size());
   Eigen::DenseIndex* maxmap = &indices[0];
   CUDA_CHECK(cudaMemcpy((void*)maxmap, aux_mem, sizeof(Eigen::DenseIndex) * dim.size(), cudaMemcpyDeviceToHost));
-#else
-  Eigen::DenseIndex* maxmap = static_cast<Eigen::DenseIndex*>(aux_mem);
-#endif
   Eigen::TensorMap<Eigen::Tensor<Eigen::DenseIndex, 4>> locs(maxmap, dim[0], dim[1], dim[2], dim.batch_elems());
   const unsigned batch_size = dim.batch_elems();
   const unsigned first_dim_size = dim[first_dim];
@@ -426,6 +493,22 @@ void KMaxPooling::backward_dev_impl(const MyDevice & dev,
       }
     }
   }
+#else
+  // maxmap has the layout of fx, and holds positions along the pooled
+  // dimension of x
+  const Eigen::DenseIndex* maxmap = static_cast<const Eigen::DenseIndex*>(aux_mem);
+  unsigned inner = 1, outer = dim.batch_elems();
+  for (unsigned d = 0; d < pooled_dim; ++d) inner *= dim[d];
+  for (unsigned d = pooled_dim + 1; d < dim.nd; ++d) outer *= dim[d];
+  const unsigned n = xs[0]->d[pooled_dim];
+  for (unsigned o = 0; o < outer; ++o) {
+    float* dx = dEdxi.v + (size_t)o * inner * n;
+    const size_t off = (size_t)o * inner * k;
+    for (unsigned t = 0; t < k; ++t)
+      for (unsigned i = 0; i < inner; ++i)
+        dx[i + maxmap[off + i + t * inner] * inner] += dEdf.v[off + i + t * inner];
+  }
+#endif
 }
 DYNET_NODE_INST_DEV_IMPL(KMaxPooling)
 
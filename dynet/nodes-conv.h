@@ -38,14 +38,16 @@ struct Conv1DWide : public Node {
 
 // y = x_1 *filter x_2
 // x_1 \in R^{d x s} (input)
-// x_2 \in R^{d x m} (filter)
+// x_2 \in R^{d x m} or R^{d x m x F} (filter)
 struct Filter1DNarrow : public Node {
   explicit Filter1DNarrow(const std::initializer_list<VariableIndex>& a) : Node(a) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
 struct FoldRows : public Node {
   explicit FoldRows(const std::initializer_list<VariableIndex>& a, unsigned nrows) : Node(a), nrows(nrows) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   unsigned nrows;
 };
@@ -89,6 +91,8 @@ struct Conv2D: public Node {
   const bool is_valid;
 
  private:
+  // Whether the CPU kernel can use x as its im2col matrix
+  bool is_pointwise(const Dim& f) const;
 #if HAVE_CUDNN
   mutable CudnnConvOp* cudnn_conv_op_ = NULL;
 #endif
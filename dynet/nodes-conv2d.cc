@@ -8,8 +8,7 @@
 
 #include "dynet/functors.h"
 #include "dynet/nodes-macros.h"
-#include "third_party/eigen_spatial_convolutions.h"
-#include "third_party/eigen_backward_spatial_convolutions.h"
+#include "dynet/matrix-multiply.h"
 
 #if HAVE_CUDA
 #include "dynet/cuda.h"
@@ -77,11 +76,83 @@ size_t Conv2D::aux_storage_size() const {
   nbytes += CudnnConvOp::workspace_size_limit_bytes;
   nbytes += 3 * input_size[0] * sizeof(float);
 #else
-  nbytes += sizeof(float) * (input_size[0] + input_size[1] + 
-      dim.size() + std::max(input_size[0], input_size[1]));
+  // The im2col matrix of the whole batch, which 1x1 convolutions with unit
+  // strides do without
+  const Dim& f = get_cg()->nodes[args[1]]->dim;
+  if (!is_pointwise(f))
+    nbytes += sizeof(float) * dim[0] * dim[1] * f[0] * f[1] * f[2] * dim.bd;
 #endif
   return nbytes;
 }
+
+bool Conv2D::is_pointwise(const Dim& f) const {
+  return f[0] == 1 && f[1] == 1 && stride[0] == 1 && stride[1] == 1;
+}
+
+// In DyNet's layout, x is H x W x C, f is KH x KW x C x F and y is
+// OH x OW x F, all column-major. Flattening the pixels and the patches,
+// y = col * f, with f seen as a (KH*KW*C) x F matrix, and col the
+// (OH*OW) x (KH*KW*C) matrix whose row oh + OH*ow holds the patch of x that
+// output pixel (oh, ow) sees, zero-padded. Same padding puts the extra row
+// or column, if any, at the end, as Eigen and TensorFlow do.
+struct Conv2DGeometry {
+  Conv2DGeometry(const Dim& x, const Dim& f, const Dim& y, const vector<unsigned>& stride, bool is_valid) :
+      H(x[0]), W(x[1]), C(x[2]), KH(f[0]), KW(f[1]), OH(y[0]), OW(y[1]), s0(stride[0]), s1(stride[1]) {
+    pt = is_valid ? 0 : max(0, ((OH - 1) * s0 + KH - H) / 2);
+    pl = is_valid ? 0 : max(0, ((OW - 1) * s1 + KW - W) / 2);
+  }
+  int patch_size() const { return KH * KW * C; }
+  int pixels() const { return OH * OW; }
+  int H, W, C, KH, KW, OH, OW, s0, s1, pt, pl;
+};
+
+// Fill col with the patches of a single batch element of x, or, if
+// backward is set, add the patch gradients in col back into x
+inline void conv2d_im2col(const Conv2DGeometry& g, float* x, float* col, bool backward) {
+  const int pixels = g.pixels();
+  for (int c = 0; c < g.C; ++c) {
+    for (int kw = 0; kw < g.KW; ++kw) {
+      for (int kh = 0; kh < g.KH; ++kh) {
+        float* colq = col + (kh + g.KH * (kw + g.KW * c)) * pixels;
+        // Output rows whose input row falls inside x
+        const int oh_begin = min(g.OH, max(0, (g.pt - kh + g.s0 - 1) / g.s0));
+        const int oh_end = max(oh_begin, min(g.OH, (g.H + g.pt - kh + g.s0 - 1) / g.s0));
+        for (int ow = 0; ow < g.OW; ++ow) {
+          float* out = colq + ow * g.OH;
+          const int w = ow * g.s1 + kw - g.pl;
+          if (w < 0 || w >= g.W) {
+            if (!backward) fill(out, out + g.OH, 0.f);
+            continue;
+          }
+          float* in = x + g.H * (w + g.W * c);
+          if (backward) {
+            for (int oh = oh_begin; oh < oh_end; ++oh)
+              in[oh * g.s0 + kh - g.pt] += out[oh];
+          } else {
+            fill(out, out + oh_begin, 0.f);
+            for (int oh = oh_begin; oh < oh_end; ++oh)
+              out[oh] = in[oh * g.s0 + kh - g.pt];
+            fill(out + oh_end, out + g.OH, 0.f);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Run im2col (or its adjoint) over all batch elements, spreading them over
+// the threads of a threaded device
+inline void conv2d_im2col(const Device_CPU& dev, const Conv2DGeometry& g, const Tensor& x, const Tensor& col, bool backward) {
+  for (unsigned b = 0; b < col.d.bd; ++b)
+    conv2d_im2col(g, x.v + (b % x.d.bd) * x.d.batch_size(), col.v + b * col.d.batch_size(), backward);
+}
+inline void conv2d_im2col(const Device_CPU_Threaded& dev, const Conv2DGeometry& g, const Tensor& x, const Tensor& col, bool backward) {
+  const Eigen::TensorOpCost cost(sizeof(float) * col.d.batch_size(), sizeof(float) * col.d.batch_size(), col.d.batch_size());
+  dev.edevice->parallelFor(col.d.bd, cost, [&](Eigen::Index first, Eigen::Index last) {
+    for (Eigen::Index b = first; b < last; ++b)
+      conv2d_im2col(g, x.v + (b % x.d.bd) * x.d.batch_size(), col.v + b * col.d.batch_size(), backward);
+  });
+}
 #endif
 
 template<class MyDevice>
@@ -101,28 +172,26 @@ void Conv2D::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>&
   throw std::runtime_error("Conv2D::forward_dev_impl not supported without CUDNN");
 #endif
 #else
-  Eigen::PaddingType padding_type = is_valid ? Eigen::PADDING_VALID : Eigen::PADDING_SAME;
-  void* CHWN_x_mem = aux_mem_pool.allocate(xs[0]->d.size() * sizeof(float));
-  Tensor CHWN_x = Tensor(Dim({xs[0]->d[2], xs[0]->d[0], xs[0]->d[1]}, xs[0]->d.bd), static_cast<float*>(CHWN_x_mem), xs[0]->device, DeviceMempool::FXS);
-  Eigen::array<ptrdiff_t, 4> shuffles; 
-  shuffles[0] = 2; shuffles[1] = 0; shuffles[2] = 1; shuffles[3] = 3;
-  CHWN_x.tb<3>().device(*dev.edevice) = xs[0]->tb<3>().shuffle(shuffles);
-  void* NCHW_f_mem = aux_mem_pool.allocate(xs[1]->d.size() * sizeof(float));
-  Tensor NCHW_f = Tensor(Dim({xs[1]->d[3], xs[1]->d[2], xs[1]->d[0], xs[1]->d[1]}), static_cast<float*>(NCHW_f_mem), xs[1]->device, DeviceMempool::FXS);
-  shuffles[0] = 3; shuffles[1] = 2; shuffles[2] = 0; shuffles[3] = 1;
-  NCHW_f.t<4>().device(*dev.edevice) = xs[1]->t<4>().shuffle(shuffles);
-  void* CHWN_y_mem = aux_mem_pool.allocate(fx.d.size() * sizeof(float));
-  Tensor CHWN_y = Tensor(Dim({fx.d[2], fx.d[0], fx.d[1]}, fx.d.bd), static_cast<float*>(CHWN_y_mem), fx.device, DeviceMempool::FXS);
-  CHWN_y.tb<3>().device(*dev.edevice) = Eigen::SpatialConvolution(CHWN_x.tb<3>(), NCHW_f.t<4>(), stride[0], stride[1], padding_type);
-  shuffles[0] = 1; shuffles[1] = 2; shuffles[2] = 0; shuffles[3] = 3;
-  fx.tb<3>().device(*dev.edevice) = CHWN_y.tb<3>().shuffle(shuffles);
-  //NWHCToNCWH()(&NWHC_y, fx);
-  if (xs.size() == 3) {
-    Tensor bias = Tensor(Dim({fx.d[0], fx.d[1], fx.d.bd}, 1), static_cast<float*>(CHWN_x_mem), xs[2]->device, DeviceMempool::FXS);
-    for (unsigned i = 0; i < fx.d[2]; ++i) {
-      TensorTools::constant(bias, xs[2]->vec()(i));
-      fx.tb<3>().chip<2>(i).device(*dev.edevice) += bias.t<3>(); 
-    }
+  const Conv2DGeometry g(xs[0]->d, xs[1]->d, fx.d, stride, is_valid);
+  const unsigned n = fx.d.bd, filters = xs[1]->d[3];
+  Tensor f(Dim({(unsigned)g.patch_size(), filters}), xs[1]->v, xs[1]->device, DeviceMempool::FXS);
+  Tensor y(Dim({(unsigned)g.pixels(), filters}, n), fx.v, fx.device, DeviceMempool::FXS);
+  // The bias is fused by starting from it and accumulating the products
+  const bool has_bias = (xs.size() == 3);
+  if (has_bias) {
+    Eigen::Map<Eigen::RowVectorXf> bias(xs[2]->v, filters);
+    for (unsigned b = 0; b < n; ++b)
+      y.batch_matrix(b).rowwise() = bias;
+  }
+  if (is_pointwise(xs[1]->d)) {
+    Tensor col(Dim({(unsigned)g.pixels(), (unsigned)g.C}, n), xs[0]->v, xs[0]->device, DeviceMempool::FXS);
+    CPUBatchedMatrixMultiply(dev, col, false, f, false, y, has_bias);
+  } else {
+    Tensor col(Dim({(unsigned)g.pixels(), (unsigned)g.patch_size()}, n),
+               static_cast<float*>(aux_mem_pool.allocate(sizeof(float) * g.pixels() * g.patch_size() * n)),
+               fx.device, DeviceMempool::FXS);
+    conv2d_im2col(dev, g, *xs[0], col, false);
+    CPUBatchedMatrixMultiply(dev, col, false, f, false, y, has_bias);
   }
 #endif
 }
@@ -148,37 +217,28 @@ void Conv2D::backward_dev_impl(const MyDevice & dev,
   throw std::runtime_error("Conv2D::backward_dev_impl not supported without CUDNN");
 #endif
 #else
-  void* CHWN_dy_mem = aux_mem_pool.allocate(dEdf.d.size() * sizeof(float));
-  Tensor CHWN_dy = Tensor(Dim({dEdf.d[2], dEdf.d[0], dEdf.d[1]}, dEdf.d.bd), static_cast<float*>(CHWN_dy_mem), dEdf.device, DeviceMempool::FXS);
-  Eigen::array<ptrdiff_t, 4> shuffles; 
-  shuffles[0] = 2; shuffles[1] = 0; shuffles[2] = 1; shuffles[3] = 3;
-  CHWN_dy.tb<3>().device(*dev.edevice) = dEdf.tb<3>().shuffle(shuffles);
-  if (i == 0) { //backward w.r.t the input
-    void* NCHW_f_mem = aux_mem_pool.allocate(xs[1]->d.size() * sizeof(float));
-    Tensor NCHW_f = Tensor(Dim({xs[1]->d[3], xs[1]->d[2], xs[1]->d[0], xs[1]->d[1]}), static_cast<float*>(NCHW_f_mem), xs[1]->device, DeviceMempool::FXS);
-    shuffles[0] = 3; shuffles[1] = 2; shuffles[2] = 0; shuffles[3] = 1;
-    NCHW_f.t<4>().device(*dev.edevice) = xs[1]->t<4>().shuffle(shuffles);
-    void* CHWN_dEdxi_mem = aux_mem_pool.allocate(xs[0]->d.size() * sizeof(float));
-    Tensor CHWN_dEdxi = Tensor(Dim({xs[0]->d[2], xs[0]->d[0], xs[0]->d[1]}, xs[0]->d.bd), static_cast<float*>(CHWN_dEdxi_mem), dEdxi.device, DeviceMempool::FXS);
-    CHWN_dEdxi.tb<3>().device(*dev.edevice) = Eigen::SpatialConvolutionBackwardInput(NCHW_f.t<4>(), CHWN_dy.tb<3>(), xs[0]->d[0], xs[0]->d[1], stride[0], stride[1]);
-    void* HWCN_dEdxi_mem = aux_mem_pool.allocate(xs[0]->d.size() * sizeof(float));
-    Tensor HWCN_dEdxi = Tensor(xs[0]->d, static_cast<float*>(HWCN_dEdxi_mem), dEdxi.device, DeviceMempool::FXS);
-    shuffles[0] = 1; shuffles[1] = 2; shuffles[2] = 0; shuffles[3] = 3;
-    HWCN_dEdxi.tb<3>().device(*dev.edevice) = CHWN_dEdxi.tb<3>().shuffle(shuffles);
-    dEdxi.tb<3>().device(*dev.edevice) += HWCN_dEdxi.tb<3>();
-  } else if (i == 1) { //backward w.r.t the kernel
-    void* CHWN_x_mem = aux_mem_pool.allocate(xs[0]->d.size() * sizeof(float));
-    Tensor CHWN_x = Tensor(Dim({xs[0]->d[2], xs[0]->d[0], xs[0]->d[1]}, xs[0]->d.bd), static_cast<float*>(CHWN_x_mem), xs[0]->device, DeviceMempool::FXS);
-    shuffles[0] = 2; shuffles[1] = 0; shuffles[2] = 1; shuffles[3] = 3;
-    CHWN_x.tb<3>().device(*dev.edevice) = xs[0]->tb<3>().shuffle(shuffles);
-    void* NCHW_dEdxi_mem = aux_mem_pool.allocate(xs[1]->d.size() * sizeof(float));
-    Tensor NCHW_dEdxi = Tensor(Dim({xs[1]->d[3], xs[1]->d[2], xs[1]->d[0], xs[1]->d[1]}), static_cast<float*>(NCHW_dEdxi_mem), dEdxi.device, DeviceMempool::FXS);
-    NCHW_dEdxi.t<4>().device(*dev.edevice) = Eigen::SpatialConvolutionBackwardKernel(CHWN_x.tb<3>(), CHWN_dy.tb<3>(), xs[1]->d[0], xs[1]->d[1], stride[0], stride[1]);
-    void* HWCN_dEdxi_mem = aux_mem_pool.allocate(xs[1]->d.size() * sizeof(float));
-    Tensor HWCN_dEdxi = Tensor(xs[1]->d, static_cast<float*>(HWCN_dEdxi_mem), dEdxi.device, DeviceMempool::FXS);
-    shuffles[0] = 2; shuffles[1] = 3; shuffles[2] = 1; shuffles[3] = 0;
-    HWCN_dEdxi.t<4>().device(*dev.edevice) = NCHW_dEdxi.t<4>().shuffle(shuffles);
-    dEdxi.t<4>().device(*dev.edevice) += HWCN_dEdxi.t<4>();
+  const Conv2DGeometry g(xs[0]->d, xs[1]->d, fx.d, stride, is_valid);
+  const unsigned n = fx.d.bd, filters = xs[1]->d[3];
+  const bool pointwise = is_pointwise(xs[1]->d);
+  Tensor dy(Dim({(unsigned)g.pixels(), filters}, n), dEdf.v, dEdf.device, DeviceMempool::FXS);
+  if (i < 2) {
+    // The patch gradients for the input, or the patches for the kernel,
+    // which are extracted again since the patch gradients share their memory
+    Tensor col(Dim({(unsigned)g.pixels(), (unsigned)(pointwise ? g.C : g.patch_size())}, n),
+               pointwise ? (i == 0 ? dEdxi.v : xs[0]->v)
+                         : static_cast<float*>(aux_mem_pool.allocate(sizeof(float) * g.pixels() * g.patch_size() * n)),
+               fx.device, DeviceMempool::FXS);
+    if (i == 0) { //backward w.r.t the input
+      Tensor f(Dim({(unsigned)g.patch_size(), filters}), xs[1]->v, xs[1]->device, DeviceMempool::FXS);
+      CPUBatchedMatrixMultiply(dev, dy, false, f, true, col, pointwise);
+      if (!pointwise)
+        conv2d_im2col(dev, g, dEdxi, col, true);
+    } else { //backward w.r.t the kernel, summed over the batch
+      if (!pointwise)
+        conv2d_im2col(dev, g, *xs[0], col, false);
+      Tensor df(Dim({(unsigned)g.patch_size(), filters}), dEdxi.v, dEdxi.device, DeviceMempool::FXS);
+      CPUBatchedMatrixMultiply(dev, col, true, dy, false, df, true);
+    }
   } else { //backward w.r.t the bias
     Eigen::array<int, 3> red_axis = {0, 1, 3};
     dEdxi.t<1>().device(*dev.edevice) += dEdf.tb<3>().sum(red_axis);
@@ -40,7 +40,8 @@ inline bool LooksLikeVector(const Dim& d) {
 // A macro to instantiate templated device functions
 // If the implementation is the same for both devices (using Eigen Tensors),
 //  then this will instantiate both CPU and GPU implementations, and the
-//  code can be the same.
+//  code can be the same. CPU code is instantiated twice, once for the
+//  single-threaded Device_CPU and once for Device_CPU_Threaded.
 // If the implementation is different for both devices, use #ifdef __CUDACC__
 //  within the function, and create alternative code paths for CPU and GPU implementations
 #ifdef __CUDACC__
@@ -70,9 +71,19 @@ inline bool LooksLikeVector(const Dim& d) {
                                            const Tensor& dEdf, \
                                            unsigned i, \
                                            Tensor& dEdxi) const; \
+  template void MyNode::forward_dev_impl<Device_CPU_Threaded>(const Device_CPU_Threaded & dev, const vector<const Tensor*>& xs, Tensor& fx) const; \
+  template void MyNode::backward_dev_impl<Device_CPU_Threaded>(const Device_CPU_Threaded & dev, \
+                                           const vector<const Tensor*>& xs, \
+                                           const Tensor& fx, \
+                                           const Tensor& dEdf, \
+                                           unsigned i, \
+                                           Tensor& dEdxi) const; \
   void MyNode::forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const { \
     DYNET_ASSERT(fx.device, "Device not allocated for expression"); \
-    if(fx.device->type == DeviceType::CPU) { forward_dev_impl<dynet::Device_CPU>(*(dynet::Device_CPU*)fx.device,xs,fx); } \
+    if(fx.device->type == DeviceType::CPU) { \
+      if(((dynet::Device_CPU*)fx.device)->num_threads > 1) { forward_dev_impl<dynet::Device_CPU_Threaded>(*(dynet::Device_CPU_Threaded*)fx.device,xs,fx); } \
+      else { forward_dev_impl<dynet::Device_CPU>(*(dynet::Device_CPU*)fx.device,xs,fx); } \
+    } \
     else if(fx.device->type == DeviceType::GPU) { forward_dev_impl<dynet::Device_GPU>(*(dynet::Device_GPU*)fx.device,xs,fx); } \
     else { throw std::runtime_error("Invalid device in MyNode::forward_impl"); } \
   } \
@@ -82,7 +93,10 @@ inline bool LooksLikeVector(const Dim& d) {
                 unsigned i, \
                 Tensor& dEdxi) const { \
     DYNET_ASSERT(fx.device, "Device not allocated for expression"); \
-    if(fx.device->type == DeviceType::CPU) { backward_dev_impl<dynet::Device_CPU>(*(dynet::Device_CPU*)fx.device,xs,fx,dEdf,i,dEdxi); } \
+    if(fx.device->type == DeviceType::CPU) { \
+      if(((dynet::Device_CPU*)fx.device)->num_threads > 1) { backward_dev_impl<dynet::Device_CPU_Threaded>(*(dynet::Device_CPU_Threaded*)fx.device,xs,fx,dEdf,i,dEdxi); } \
+      else { backward_dev_impl<dynet::Device_CPU>(*(dynet::Device_CPU*)fx.device,xs,fx,dEdf,i,dEdxi); } \
+    } \
     else if(fx.device->type == DeviceType::GPU) { backward_dev_impl<dynet::Device_GPU>(*(dynet::Device_GPU*)fx.device,xs,fx,dEdf,i,dEdxi); } \
     else { throw std::runtime_error("Invalid device in MyNode::backward_impl"); } \
   }
@@ -95,9 +109,19 @@ inline bool LooksLikeVector(const Dim& d) {
                                            const Tensor& dEdf, \
                                            unsigned i, \
                                            Tensor& dEdxi) const; \
+  template void MyNode::forward_dev_impl<Device_CPU_Threaded>(const Device_CPU_Threaded & dev, const vector<const Tensor*>& xs, Tensor& fx) const; \
+  template void MyNode::backward_dev_impl<Device_CPU_Threaded>(const Device_CPU_Threaded & dev, \
+                                           const vector<const Tensor*>& xs, \
+                                           const Tensor& fx, \
+                                           const Tensor& dEdf, \
+                                           unsigned i, \
+                                           Tensor& dEdxi) const; \
   void MyNode::forward_impl(const std::vector<const Tensor*>& xs, Tensor& fx) const { \
     DYNET_ASSERT(fx.device, "Device not allocated for expression"); \
-    if(fx.device->type == DeviceType::CPU) { forward_dev_impl<dynet::Device_CPU>(*(dynet::Device_CPU*)fx.device,xs,fx); } \
+    if(fx.device->type == DeviceType::CPU) { \
+      if(((dynet::Device_CPU*)fx.device)->num_threads > 1) { forward_dev_impl<dynet::Device_CPU_Threaded>(*(dynet::Device_CPU_Threaded*)fx.device,xs,fx); } \
+      else { forward_dev_impl<dynet::Device_CPU>(*(dynet::Device_CPU*)fx.device,xs,fx); } \
+    } \
     else { throw std::runtime_error("Invalid device in MyNode::forward_impl"); } \
   } \
   void MyNode::backward_impl(const std::vector<const Tensor*>& xs, \
@@ -106,7 +130,10 @@ inline bool LooksLikeVector(const Dim& d) {
                 unsigned i, \
                 Tensor& dEdxi) const { \
     DYNET_ASSERT(fx.device, "Device not allocated for expression"); \
-    if(fx.device->type == DeviceType::CPU) { backward_dev_impl<dynet::Device_CPU>(*(dynet::Device_CPU*)fx.device,xs,fx,dEdf,i,dEdxi); } \
+    if(fx.device->type == DeviceType::CPU) { \
+      if(((dynet::Device_CPU*)fx.device)->num_threads > 1) { backward_dev_impl<dynet::Device_CPU_Threaded>(*(dynet::Device_CPU_Threaded*)fx.device,xs,fx,dEdf,i,dEdxi); } \
+      else { backward_dev_impl<dynet::Device_CPU>(*(dynet::Device_CPU*)fx.device,xs,fx,dEdf,i,dEdxi); } \
+    } \
     else { throw std::runtime_error("Invalid device in MyNode::backward_impl"); } \
   }
 #endif
@@ -1,5 +1,6 @@
 #include "dynet/nodes.h"
 
+#include <algorithm>
 #include <limits>
 #include <cmath>
 #include <stdexcept>
@@ -8,6 +9,7 @@
 #include "dynet/functors.h"
 #include "dynet/nodes-macros.h"
 #include "dynet/globals.h"
+#include "dynet/matrix-multiply.h"
 
 #ifdef __CUDACC__
 #include "dynet/cuda.h"
@@ -150,7 +152,7 @@ size_t Softmax::aux_storage_size() const {
 }
 
 size_t Sparsemax::aux_storage_size() const {
-  return (dim.size() + 1) * sizeof(float);
+  return (dim.size() + dim.bd) * sizeof(float);
 }
 
 size_t SparsemaxLoss::aux_storage_size() const {
@@ -167,6 +169,145 @@ size_t MinDimension::aux_storage_size() const {
   return sizeof(Eigen::DenseIndex) * dim.size();
 }
 
+size_t LSTMCell::aux_storage_size() const {
+  // gate activations, tanh(c_t) and dE/dc_t
+  const unsigned hid = dim.rows() / (output_gate ? 2 : 1);
+  return (num_gates() + 2) * hid * dim.bd * sizeof(float);
+}
+
+size_t GRUCell::aux_storage_size() const {
+  // z, r, tanh(.), r h_{t-1} and h_{t-1} for the forward pass,
+  // and the same number of gradients for the backward pass
+  return 10 * dim.size() * sizeof(float);
+}
+
+// The hid x bd block starting at row offset off of every batch element of x,
+// which has ld rows per batch element. ld = 0 repeats the first one.
+typedef Eigen::Map<Eigen::ArrayXXf, 0, Eigen::OuterStride<> > RowBlock;
+inline RowBlock row_block(float* x, unsigned off, unsigned hid, unsigned bd, unsigned ld) {
+  return RowBlock(x + off, hid, bd, Eigen::OuterStride<>(ld));
+}
+inline RowBlock row_block(const Tensor& x, unsigned off, unsigned hid, unsigned bd) {
+  return row_block(x.v, off, hid, bd, x.d.bd == 1 ? 0 : x.d.batch_size());
+}
+// Add the hid x bd gradient g to rows [off, off + hid) of dEdx, summing it
+// over the batch if x was broadcast
+template <class T>
+inline void add_row_block(Tensor& dEdx, unsigned off, unsigned hid, unsigned bd, const T& g) {
+  if (dEdx.d.bd == bd)
+    row_block(dEdx, off, hid, bd) += g;
+  else
+    Eigen::Map<Eigen::ArrayXf>(dEdx.v + off, hid) += g.rowwise().sum();
+}
+
+// aux_mem of LSTMSequence and GRUSequence, where every per-step block holds
+// the hid (or ng * hid) x bd values of one timestep:
+// - acts: gate activations of each step
+// - hs: h_{t-1} of each step, followed by the last h
+// - cs: c_{t-1} of each step for LSTMs, r_t h_{t-1} for GRUs
+// - xs: inputs of each step
+// - dxs: dE/dx of each step
+// - das: dE/d(gate pre-activations) of each step
+// - dh, dc: dE/dh and dE/dc carried through time
+// - tmp: scratch for the recurrent products
+// - dy: the dE/dy that das, dh and dc were computed from, valid if *valid != 0
+struct RNNSequenceMem {
+  RNNSequenceMem(void* mem, unsigned ng, unsigned hid, unsigned bd, unsigned len, unsigned in_dim) {
+    const size_t n = hid * bd;
+    acts = static_cast<float*>(mem);
+    hs = acts + ng * n * len;
+    cs = hs + n * (len + 1);
+    xs = cs + n * (len + 1);
+    dxs = xs + in_dim * bd * len;
+    das = dxs + in_dim * bd * len;
+    dh = das + ng * n * len;
+    dc = dh + n;
+    tmp = dc + n;
+    dy = tmp + 3 * n;
+    valid = dy + (ng == 4 ? 2 : 1) * n * len;
+  }
+  static size_t size(unsigned ng, unsigned hid, unsigned bd, unsigned len, unsigned in_dim) {
+    const size_t n = hid * bd;
+    return (2 * ng * n * len + 2 * n * (len + 1) + 2 * in_dim * bd * len + 5 * n + (ng == 4 ? 2 : 1) * n * len + 1) * sizeof(float);
+  }
+  float *acts, *hs, *cs, *xs, *dxs, *das, *dh, *dc, *tmp, *dy, *valid;
+};
+
+size_t LSTMSequence::aux_storage_size() const {
+  return RNNSequenceMem::size(4, dim.rows(), dim.bd, dim.cols(), input_dim);
+}
+
+size_t GRUSequence::aux_storage_size() const {
+  return RNNSequenceMem::size(3, dim.rows(), dim.bd, dim.cols(), input_dim);
+}
+
+// aux_mem of AffinePickNegLogSoftmax:
+// - logz: the log partition function of each batch element, which holds the
+//   running max of the scores during the forward pass
+// - sums: the running sum of exp(score - max) of each batch element
+// - scores: the tile x bd scores (or their gradients) of the current tile
+// - db, dx: dE/db and dE/dx
+// - dy: the dE/dy that db and dx were computed from, valid if *valid != 0
+struct AffineSoftmaxMem {
+  AffineSoftmaxMem(void* mem, unsigned tile, unsigned vocab, unsigned rep, unsigned bd) {
+    logz = static_cast<float*>(mem);
+    sums = logz + bd;
+    scores = sums + bd;
+    db = scores + tile * bd;
+    dx = db + vocab;
+    dy = dx + rep * bd;
+    valid = dy + bd;
+  }
+  static size_t size(unsigned tile, unsigned vocab, unsigned rep, unsigned bd) {
+    return ((4 + tile + rep) * bd + vocab + 1) * sizeof(float);
+  }
+  float *logz, *sums, *scores, *db, *dx, *dy, *valid;
+};
+
+size_t AffinePickNegLogSoftmax::aux_storage_size() const {
+  return AffineSoftmaxMem::size(min(tile_size, vocab_size), vocab_size, rep_dim, dim.bd);
+}
+
+// aux_mem of ScaledDotProductAttention:
+// - logz: the log partition function of each query of each batch element,
+//   which holds the running max of its scores during the forward pass
+// - sums: the running sum of exp(score - max) of each query during the
+//   forward pass, and sum_c dE/dy_c * y_c during the backward pass
+// - scores: the tile x n scores (or probabilities) of the current tile
+// - dscores: their gradients
+struct AttentionMem {
+  AttentionMem(void* mem, unsigned tile, unsigned n, unsigned bd) {
+    logz = static_cast<float*>(mem);
+    sums = logz + n * bd;
+    scores = sums + n;
+    dscores = scores + tile * n;
+  }
+  static size_t size(unsigned tile, unsigned n, unsigned bd) {
+    return (bd + 1 + 2 * tile) * n * sizeof(float);
+  }
+  float *logz, *sums, *scores, *dscores;
+};
+
+size_t ScaledDotProductAttention::aux_storage_size() const {
+  return AttentionMem::size(min(tile_size, num_keys), dim.cols(), dim.bd);
+}
+
+typedef Eigen::Map<const Eigen::MatrixXf, 0, Eigen::OuterStride<> > ConstStridedMatrix;
+
+// The scores of keys [t0, t0 + rows) of batch element b, scaled and masked
+inline void attention_scores(const vector<const Tensor*>& xs, unsigned b, unsigned t0, unsigned rows,
+                             float scale, Eigen::Map<Eigen::MatrixXf>& s) {
+  const unsigned d = xs[0]->d.rows(), n = s.cols(), m = xs[1]->d.cols();
+  const Eigen::Map<const Eigen::MatrixXf> q(xs[0]->batch_ptr(b), d, n), k(xs[1]->batch_ptr(b) + t0 * d, d, rows);
+  s.noalias() = scale * (k.transpose() * q);
+  if (xs.size() == 4) {
+    if (xs[3]->d.cols() == 1)
+      s.colwise() += Eigen::Map<const Eigen::VectorXf>(xs[3]->batch_ptr(b) + t0, rows);
+    else
+      s += ConstStridedMatrix(xs[3]->batch_ptr(b) + t0, rows, n, Eigen::OuterStride<>(m));
+  }
+}
+
 #endif // Finish CPU only functions
 
 // ===== Auxiliary functions for both CPU and GPU
@@ -212,34 +353,6 @@ EIGEN_STRONG_INLINE void logsumexp(const MyDevice & dev, const Tensor& x, Tensor
 
 // ===== Functions to be compiled on both CPU and GPU
 
-#ifdef __CUDACC__
-inline void CUDAMatrixMultiply(const Device_GPU & dev, const Tensor& l, const Tensor& r, Tensor& y, const float* acc_scalar) {
-  if(l.d.bd == 1 && r.d.bd == y.d.bd) {
-    // If the left side has one batch, multiply by columns
-    // [x, z, b] = [x, y] * [y, z, b]
-    // -> [x, z*b] = [x, y], [y, z*b]
-    CUBLAS_CHECK(cublasSgemm(dev.cublas_handle, CUBLAS_OP_N, CUBLAS_OP_N,
-          y.d.rows(), y.d.cols() * y.d.batch_elems(), l.d.cols(),
-          kSCALAR_ONE,
-          l.v, l.d.rows(),
-          r.v, r.d.rows(),
-          acc_scalar, y.v, y.d.rows()));
-  } else {
-    // Otherwise, loop over the batches
-    DYNET_ASSERT(r.d.bd != 1 || r.d.bd != l.d.bd,
-                 "Number of batch elements in matrix multiply must match, but got: " << r.d.bd << ", " << l.d.bd);
-    for(unsigned b = 0; b < y.d.bd; ++b) {
-      CUBLAS_CHECK(cublasSgemm(dev.cublas_handle, CUBLAS_OP_N, CUBLAS_OP_N,
-            y.d.rows(), y.d.cols(), l.d.cols(),
-            kSCALAR_ONE,
-            l.batch_ptr(b), l.d.rows(),
-            r.batch_ptr(b), r.d.rows(),
-            acc_scalar, y.batch_ptr(b), y.d.rows()));
-    }
-  }
-}
-#endif
-
 template<class MyDevice>
 void AddVectorToAllColumns::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
   // TODO: Profile on CPU. Broadcasting may be slow.
@@ -321,12 +434,10 @@ void AffineTransform::forward_dev_impl(const MyDevice & dev, const vector<const
     // Multiply
     for (unsigned i = 1; i < xs.size(); i += 2) {
       if(xs[i]->d.bd == 1 && xs[i+1]->d.bd == fx.d.bd) {
-        fx.colbatch_matrix().noalias() += **xs[i] * xs[i+1]->colbatch_matrix();
+        CPUMatrixMultiply(dev, **xs[i], false, xs[i+1]->colbatch_matrix(), false, fx.colbatch_matrix(), true);
       } else {
         DYNET_ASSERT(xs[i+1]->d.bd == 1 || xs[i+1]->d.bd == xs[i]->d.bd, "Failed dimension check in AffineTransform::forward");
-        for(unsigned b = 0; b < fx.d.bd; ++b) {
-          fx.batch_matrix(b).noalias() += xs[i]->batch_matrix(b) * xs[i+1]->batch_matrix(b);
-        }
+        CPUBatchedMatrixMultiply(dev, *xs[i], false, *xs[i+1], false, fx, true);
       }
     }
 #endif
@@ -373,8 +484,8 @@ void AffineTransform::backward_dev_impl(const MyDevice & dev,
 
   // Left argument of matrix multiply
   } else if (i % 2 == 1) {
-    int max_b = max(dEdf.d.bd, xs[i+1]->d.bd);
 #if __CUDACC__
+    int max_b = max(dEdf.d.bd, xs[i+1]->d.bd);
     if(dEdxi.d.bd == 1 && (dEdf.d.bd == xs[i+1]->d.bd)) {
       CUBLAS_CHECK(cublasSgemm(dev.cublas_handle, CUBLAS_OP_N, CUBLAS_OP_T,
             dEdxi.d.rows(), dEdxi.d.cols(), dEdf.d.cols() * dEdf.d.batch_elems(),
@@ -393,15 +504,14 @@ void AffineTransform::backward_dev_impl(const MyDevice & dev,
     }
 #else
     if(dEdxi.d.bd == 1 && (dEdf.d.bd == xs[i+1]->d.bd)) {
-      (*dEdxi).noalias() += dEdf.colbatch_matrix() * xs[i+1]->colbatch_matrix().transpose();
+      CPUMatrixMultiply(dev, dEdf.colbatch_matrix(), false, xs[i+1]->colbatch_matrix(), true, *dEdxi, true);
     } else {
-      for(int b = 0; b < max_b; ++b)
-        dEdxi.batch_matrix(b).noalias() += dEdf.batch_matrix(b) * xs[i+1]->batch_matrix(b).transpose();
+      CPUBatchedMatrixMultiply(dev, dEdf, false, *xs[i+1], true, dEdxi, true);
     }
 #endif
   } else {  // right argument of matrix multiply
-    int max_b = max(xs[i-1]->d.bd, dEdf.d.bd);
 #if __CUDACC__
+    int max_b = max(xs[i-1]->d.bd, dEdf.d.bd);
     // Do a single multiply if xs[i-1] has one batch
     if(xs[i-1]->d.bd == 1 && dEdxi.d.bd == dEdf.d.bd) {
       CUBLAS_CHECK(cublasSgemm(dev.cublas_handle, CUBLAS_OP_T, CUBLAS_OP_N, 
@@ -421,10 +531,9 @@ void AffineTransform::backward_dev_impl(const MyDevice & dev,
     }
 #else
     if(xs[i-1]->d.bd == 1 && dEdxi.d.bd == dEdf.d.bd) {
-      dEdxi.colbatch_matrix().noalias() += (**xs[i-1]).transpose() * dEdf.colbatch_matrix();
+      CPUMatrixMultiply(dev, **xs[i-1], true, dEdf.colbatch_matrix(), false, dEdxi.colbatch_matrix(), true);
     } else {
-      for(int b = 0; b < max_b; ++b)
-        dEdxi.batch_matrix(b).noalias() += xs[i-1]->batch_matrix(b).transpose() * dEdf.batch_matrix(b);
+      CPUBatchedMatrixMultiply(dev, *xs[i-1], true, dEdf, false, dEdxi, true);
     }
 #endif
   }
@@ -536,7 +645,16 @@ DYNET_NODE_INST_DEV_IMPL(ConcatenateToBatch)
 
 template<class MyDevice>
 void BinaryLogLoss::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
-  fx.t<0>().device(*dev.edevice) = xs[0]->tvec().binaryExpr(xs[1]->tvec(), FBinaryLogLoss()).sum();
+  Eigen::array<ptrdiff_t, 1> red_axis = {0};
+  if(xs[0]->d.bd == xs[1]->d.bd) {
+    fx.tb<0>().device(*dev.edevice) = xs[0]->tbvec().binaryExpr(xs[1]->tbvec(), FBinaryLogLoss()).sum(red_axis);
+  } else if(xs[0]->d.bd == 1) {
+    Eigen::array<ptrdiff_t, 2> bcast = {1, xs[1]->d.bd};
+    fx.tb<0>().device(*dev.edevice) = xs[0]->tbvec().broadcast(bcast).binaryExpr(xs[1]->tbvec(), FBinaryLogLoss()).sum(red_axis);
+  } else {
+    Eigen::array<ptrdiff_t, 2> bcast = {1, xs[0]->d.bd};
+    fx.tb<0>().device(*dev.edevice) = xs[0]->tbvec().binaryExpr(xs[1]->tbvec().broadcast(bcast), FBinaryLogLoss()).sum(red_axis);
+  }
 }
 
 template<class MyDevice>
@@ -546,7 +664,19 @@ void BinaryLogLoss::backward_dev_impl(const MyDevice & dev,
                              const Tensor& dEdf,
                              unsigned i,
                              Tensor& dEdxi) const {
-  dEdxi.tvec().device(*dev.edevice) += xs[i]->tvec().binaryExpr(xs[1-i]->tvec(), FBinaryLogLossBackward(as_scalar(dEdf)));
+  // The backward functor is linear in dE/df, so it is applied with a unit
+  // gradient and scaled by the gradient of each batch element afterwards
+  Eigen::array<ptrdiff_t, 2> bcast = {xs[i]->d.batch_size(), 1};
+  if(xs[0]->d.bd == xs[1]->d.bd) {
+    dEdxi.tbvec().device(*dev.edevice) += xs[i]->tbvec().binaryExpr(xs[1-i]->tbvec(), FBinaryLogLossBackward(1.f)) * dEdf.tbvec().broadcast(bcast);
+  } else if(xs[i]->d.bd == 1) {
+    Eigen::array<ptrdiff_t, 2> batchcast = {1, xs[1-i]->d.bd};
+    Eigen::array<ptrdiff_t, 1> red_axis = {1};
+    dEdxi.tvec().device(*dev.edevice) += (xs[i]->tbvec().broadcast(batchcast).binaryExpr(xs[1-i]->tbvec(), FBinaryLogLossBackward(1.f)) * dEdf.tbvec().broadcast(bcast)).sum(red_axis);
+  } else {
+    Eigen::array<ptrdiff_t, 2> batchcast = {1, xs[i]->d.bd};
+    dEdxi.tbvec().device(*dev.edevice) += xs[i]->tbvec().binaryExpr(xs[1-i]->tbvec().broadcast(batchcast), FBinaryLogLossBackward(1.f)) * dEdf.tbvec().broadcast(bcast);
+  }
 }
 DYNET_NODE_INST_DEV_IMPL(BinaryLogLoss)
 
@@ -1049,7 +1179,16 @@ DYNET_NODE_INST_DEV_IMPL(Hinge)
 template<class MyDevice>
 void HuberDistance::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
   DYNET_ASSERT(xs.size() == 2, "HuberDistance::forward dimension check failed");
-  fx.t<0>().device(*dev.edevice) = (xs[0]->tvec() - xs[1]->tvec()).unaryExpr(FHuberForward(d)).sum();
+  Eigen::array<ptrdiff_t, 1> red_axis = {0};
+  if(xs[0]->d.bd == xs[1]->d.bd) {
+    fx.tb<0>().device(*dev.edevice) = (xs[0]->tbvec() - xs[1]->tbvec()).unaryExpr(FHuberForward(d)).sum(red_axis);
+  } else if(xs[0]->d.bd == 1) {
+    Eigen::array<ptrdiff_t, 2> bcast = {1, xs[1]->d.bd};
+    fx.tb<0>().device(*dev.edevice) = (xs[0]->tbvec().broadcast(bcast) - xs[1]->tbvec()).unaryExpr(FHuberForward(d)).sum(red_axis);
+  } else {
+    Eigen::array<ptrdiff_t, 2> bcast = {1, xs[0]->d.bd};
+    fx.tb<0>().device(*dev.edevice) = (xs[0]->tbvec() - xs[1]->tbvec().broadcast(bcast)).unaryExpr(FHuberForward(d)).sum(red_axis);
+  }
 }
 
 template<class MyDevice>
@@ -1060,7 +1199,17 @@ void HuberDistance::backward_dev_impl(const MyDevice & dev,
                              unsigned i,
                              Tensor& dEdxi) const {
   DYNET_ASSERT(i < 2, "HuberDistance::backward dimension check failed");
-  dEdxi.tvec().device(*dev.edevice) += (xs[i]->tvec() - xs[1-i]->tvec()).unaryExpr(FHuberBackward(d, as_scalar(dEdf)));
+  Eigen::array<ptrdiff_t, 2> bcast = {xs[i]->d.batch_size(), 1};
+  if(xs[0]->d.bd == xs[1]->d.bd) {
+    dEdxi.tbvec().device(*dev.edevice) += (xs[i]->tbvec() - xs[1-i]->tbvec()).unaryExpr(FHuberBackward(d, 1.f)) * dEdf.tbvec().broadcast(bcast);
+  } else if(xs[i]->d.bd == 1) {
+    Eigen::array<ptrdiff_t, 2> batchcast = {1, xs[1-i]->d.bd};
+    Eigen::array<ptrdiff_t, 1> red_axis = {1};
+    dEdxi.tvec().device(*dev.edevice) += ((xs[i]->tbvec().broadcast(batchcast) - xs[1-i]->tbvec()).unaryExpr(FHuberBackward(d, 1.f)) * dEdf.tbvec().broadcast(bcast)).sum(red_axis);
+  } else {
+    Eigen::array<ptrdiff_t, 2> batchcast = {1, xs[i]->d.bd};
+    dEdxi.tbvec().device(*dev.edevice) += (xs[i]->tbvec() - xs[1-i]->tbvec().broadcast(batchcast)).unaryExpr(FHuberBackward(d, 1.f)) * dEdf.tbvec().broadcast(bcast);
+  }
 }
 DYNET_NODE_INST_DEV_IMPL(HuberDistance)
 
@@ -1083,20 +1232,17 @@ DYNET_NODE_INST_DEV_IMPL(Identity)
 
 template<class MyDevice>
 void KMHNGram::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
-#ifdef __CUDACC__
-  DYNET_RUNTIME_ERR("KMHNGram not implemented for CUDA");
-#else
-  auto x = **xs[0];
-  const int new_cols = x.cols() - n + 1;
+  const int new_cols = xs[0]->d.cols() - n + 1;
   DYNET_ASSERT(new_cols > 0, "Failed dimension check in KMHNGram");
-  auto res = *fx;
-  res.setZero();
-  for (int j = 0; j < new_cols; ++j) {
-    auto c_j = res.col(j);
-    for (unsigned k = 0; k < n; ++k)
-      c_j += x.col(j + k);
+  // Column j of the output is the sum of columns j..j+n-1 of the input, so
+  // the output is the sum of n shifted column slices of the whole batch
+  Eigen::array<int, 3> offsets = {0, 0, 0};
+  const Eigen::array<int, 3> sizes = {(int)fx.d.rows(), new_cols, (int)fx.d.bd};
+  fx.tb<2>().device(*dev.edevice) = xs[0]->tb<2>().slice(offsets, sizes);
+  for (unsigned k = 1; k < n; ++k) {
+    offsets[1] = k;
+    fx.tb<2>().device(*dev.edevice) += xs[0]->tb<2>().slice(offsets, sizes);
   }
-#endif
 }
 
 template<class MyDevice>
@@ -1106,21 +1252,28 @@ void KMHNGram::backward_dev_impl(const MyDevice & dev,
                              const Tensor& dEdf,
                              unsigned i,
                              Tensor& dEdxi) const {
-#ifdef __CUDACC__
-  DYNET_RUNTIME_ERR("KMHNGram not implemented for CUDA");
-#else
-  const int c = dEdf.d.cols();
-  for (int j = 0; j < c; ++j)
-    for (unsigned k = 0; k < n; ++k)
-      (*dEdxi).col(j+k) += (*dEdf).col(j);
-#endif
+  Eigen::array<int, 3> offsets = {0, 0, 0};
+  const Eigen::array<int, 3> sizes = {(int)dEdf.d.rows(), (int)dEdf.d.cols(), (int)dEdf.d.bd};
+  for (unsigned k = 0; k < n; ++k) {
+    offsets[1] = k;
+    dEdxi.tb<2>().slice(offsets, sizes).device(*dev.edevice) += dEdf.tb<2>();
+  }
 }
 DYNET_NODE_INST_DEV_IMPL(KMHNGram)
 
 template<class MyDevice>
 void L1Distance::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
   DYNET_ASSERT(xs.size() == 2, "Failed dimension check in L1Distance::forward");
-  fx.t<0>().device(*dev.edevice) = (xs[0]->tvec() - xs[1]->tvec()).abs().sum();
+  Eigen::array<ptrdiff_t, 1> red_axis = {0};
+  if(xs[0]->d.bd == xs[1]->d.bd) {
+    fx.tb<0>().device(*dev.edevice) = (xs[0]->tbvec() - xs[1]->tbvec()).abs().sum(red_axis);
+  } else if(xs[0]->d.bd == 1) {
+    Eigen::array<ptrdiff_t, 2> bcast = {1, xs[1]->d.bd};
+    fx.tb<0>().device(*dev.edevice) = (xs[0]->tbvec().broadcast(bcast) - xs[1]->tbvec()).abs().sum(red_axis);
+  } else {
+    Eigen::array<ptrdiff_t, 2> bcast = {1, xs[0]->d.bd};
+    fx.tb<0>().device(*dev.edevice) = (xs[0]->tbvec() - xs[1]->tbvec().broadcast(bcast)).abs().sum(red_axis);
+  }
 }
 
 template<class MyDevice>
@@ -1131,7 +1284,17 @@ void L1Distance::backward_dev_impl(const MyDevice & dev,
                              unsigned i,
                              Tensor& dEdxi) const {
   DYNET_ASSERT(i < 2, "Failed dimension check in L1Distance::backward");
-  dEdxi.tvec().device(*dev.edevice) += (xs[i]->tvec() - xs[1-i]->tvec()).unaryExpr(FL1Backward(as_scalar(dEdf)));
+  Eigen::array<ptrdiff_t, 2> bcast = {xs[i]->d.batch_size(), 1};
+  if(xs[0]->d.bd == xs[1]->d.bd) {
+    dEdxi.tbvec().device(*dev.edevice) += (xs[i]->tbvec() - xs[1-i]->tbvec()).unaryExpr(FL1Backward(1.f)) * dEdf.tbvec().broadcast(bcast);
+  } else if(xs[i]->d.bd == 1) {
+    Eigen::array<ptrdiff_t, 2> batchcast = {1, xs[1-i]->d.bd};
+    Eigen::array<ptrdiff_t, 1> red_axis = {1};
+    dEdxi.tvec().device(*dev.edevice) += ((xs[i]->tbvec().broadcast(batchcast) - xs[1-i]->tbvec()).unaryExpr(FL1Backward(1.f)) * dEdf.tbvec().broadcast(bcast)).sum(red_axis);
+  } else {
+    Eigen::array<ptrdiff_t, 2> batchcast = {1, xs[i]->d.bd};
+    dEdxi.tbvec().device(*dev.edevice) += (xs[i]->tbvec() - xs[1-i]->tbvec().broadcast(batchcast)).unaryExpr(FL1Backward(1.f)) * dEdf.tbvec().broadcast(bcast);
+  }
 }
 DYNET_NODE_INST_DEV_IMPL(L1Distance)
 
@@ -1352,12 +1515,11 @@ void MatrixMultiply::forward_dev_impl(const MyDevice & dev, const vector<const T
     // If the left side has one batch, multiply by columns
     // [x, z, b] = [x, y] * [y, z, b]
     // -> [x, z*b] = [x, y], [y, z*b]
-    fx.colbatch_matrix().noalias() = **xs[0] * xs[1]->colbatch_matrix();
+    CPUMatrixMultiply(dev, **xs[0], false, xs[1]->colbatch_matrix(), false, fx.colbatch_matrix(), false);
   } else {
     // Otherwise, loop over the batches
     DYNET_ASSERT(xs[1]->d.bd == 1 || xs[1]->d.bd == xs[0]->d.bd, "Failed dimension check in MatrixMultiply::forward");
-    for(unsigned b = 0; b < xs[0]->d.bd; ++b)
-      fx.batch_matrix(b).noalias() = xs[0]->batch_matrix(b) * xs[1]->batch_matrix(b);
+    CPUBatchedMatrixMultiply(dev, *xs[0], false, *xs[1], false, fx, false);
   }
 #endif
 }
@@ -1370,8 +1532,8 @@ void MatrixMultiply::backward_dev_impl(const MyDevice & dev,
                              unsigned i,
                              Tensor& dEdxi) const {
   DYNET_ASSERT(i < 2, "Failed dimension check in MatrixMultiply::backward");
-  int max_b = max(xs[0]->d.bd, xs[1]->d.bd);
 #if __CUDACC__
+  int max_b = max(xs[0]->d.bd, xs[1]->d.bd);
   if (i == 0) {
     if(dEdxi.d.bd == 1 && (dEdf.d.bd == xs[1]->d.bd)) {
       CUBLAS_CHECK(cublasSgemm(dev.cublas_handle, CUBLAS_OP_N, CUBLAS_OP_T,
@@ -1412,17 +1574,15 @@ void MatrixMultiply::backward_dev_impl(const MyDevice & dev,
 #else
   if (i == 0) {
     if(dEdxi.d.bd == 1 && (dEdf.d.bd == xs[1]->d.bd)) {
-      (*dEdxi).noalias() += dEdf.colbatch_matrix() * xs[1]->colbatch_matrix().transpose();
+      CPUMatrixMultiply(dev, dEdf.colbatch_matrix(), false, xs[1]->colbatch_matrix(), true, *dEdxi, true);
     } else {
-      for(int b = 0; b < max_b; ++b)
-        dEdxi.batch_matrix(b).noalias() += dEdf.batch_matrix(b) * xs[1]->batch_matrix(b).transpose();
+      CPUBatchedMatrixMultiply(dev, dEdf, false, *xs[1], true, dEdxi, true);
     }
   } else {
     if(xs[0]->d.bd == 1) {
-      dEdxi.colbatch_matrix().noalias() += (**xs[0]).transpose() * dEdf.colbatch_matrix();
+      CPUMatrixMultiply(dev, **xs[0], true, dEdf.colbatch_matrix(), false, dEdxi.colbatch_matrix(), true);
     } else {
-      for(int b = 0; b < max_b; ++b)
-        dEdxi.batch_matrix(b).noalias() += xs[0]->batch_matrix(b).transpose() * dEdf.batch_matrix(b);
+      CPUBatchedMatrixMultiply(dev, *xs[0], true, dEdf, false, dEdxi, true);
     }
   }
 #endif
@@ -1793,7 +1953,7 @@ void PoissonRegressionLoss::forward_dev_impl(const MyDevice & dev, const vector<
   const real y = *pty;
   const auto z = std::lgamma(y + 1);
   // const auto x = as_scalar(*xs[0]);
-  fx.t<0>().device(*dev.edevice) = xs[0]->t<0>().exp() + z - xs[0]->t<0>() * y;
+  fx.tvec().device(*dev.edevice) = xs[0]->tvec().exp() + z - xs[0]->tvec() * y;
 }
 
 template<class MyDevice>
@@ -1804,7 +1964,7 @@ void PoissonRegressionLoss::backward_dev_impl(const MyDevice & dev,
                             unsigned i,
                             Tensor& dEdxi) const {
   const real y = *pty;
-  dEdxi.t<0>().device(*dev.edevice) += xs[0]->t<0>().exp() - y;
+  dEdxi.tvec().device(*dev.edevice) += (xs[0]->tvec().exp() - y) * dEdf.tvec();
 }
 DYNET_NODE_INST_DEV_IMPL(PoissonRegressionLoss)
 
@@ -1882,14 +2042,17 @@ void RestrictedLogSoftmax::forward_dev_impl(const MyDevice & dev, const vector<c
   // and do usual LogSoftmax stuff
   if(denom.size() == 0)
     DYNET_INVALID_ARG("Number of elements in denominator of RestrictedLogSoftmax::forward must be zero");
-  auto x = **xs[0];
   if(denom.size() == 0)
     DYNET_RUNTIME_ERR("RestrictedLogSoftmax currently only supports single column expressions (contributions expanding support to multiple columns welcome!)");
-  const real logz = logsumexp(x, denom);
   TensorTools::constant(fx, -numeric_limits<real>::infinity());
-  for (auto i : denom)
-    (*fx)(i,0) = x(i,0) - logz;
-  if (denom.size() == 1) (*fx)(denom.front(), 0) = 0;
+  for (unsigned b = 0; b < fx.d.bd; ++b) {
+    const auto x = xs[0]->batch_matrix(b);
+    auto y = fx.batch_matrix(b);
+    const real logz = logsumexp(x, denom);
+    for (auto i : denom)
+      y(i,0) = x(i,0) - logz;
+    if (denom.size() == 1) y(denom.front(), 0) = 0;
+  }
 #endif
 }
 
@@ -1904,11 +2067,15 @@ void RestrictedLogSoftmax::backward_dev_impl(const MyDevice & dev,
 #ifdef __CUDACC__
   DYNET_RUNTIME_ERR("RestrictedLogSoftmax not yet implemented for CUDA (contributions welcome!)");
 #else
-  float z = 0;
-  for (auto ind : denom)
-    z += (*dEdf)(ind, 0);
-  for (auto ind : denom)
-    (*dEdxi)(ind, 0) += (*dEdf)(ind, 0) - expf((*fx)(ind, 0)) * z;
+  for (unsigned b = 0; b < fx.d.bd; ++b) {
+    const auto d = dEdf.batch_matrix(b), y = fx.batch_matrix(b);
+    auto dx = dEdxi.batch_matrix(b);
+    float z = 0;
+    for (auto ind : denom)
+      z += d(ind, 0);
+    for (auto ind : denom)
+      dx(ind, 0) += d(ind, 0) - expf(y(ind, 0)) * z;
+  }
 #endif
 }
 DYNET_NODE_INST_DEV_IMPL(RestrictedLogSoftmax)
@@ -1920,7 +2087,7 @@ void SelectCols::forward_dev_impl(const MyDevice & dev, const vector<const Tenso
   for (unsigned i = 0; i < rm.size(); ++i) {
     DYNET_ARG_CHECK(rm[i] < xs[0]->d.cols(),
                             "Out-of-bounds index " << rm[i] << " in SelectCols over expression of dimensions " << xs[0]->d);
-    fx.t<2>().chip<1>(i).device(*dev.edevice) = xs[0]->t<2>().chip<1>(rm[i]);
+    fx.tb<2>().chip<1>(i).device(*dev.edevice) = xs[0]->tb<2>().chip<1>(rm[i]);
   }
 }
 
@@ -1934,7 +2101,7 @@ void SelectCols::backward_dev_impl(const MyDevice & dev,
   DYNET_ARG_CHECK(xs.size() == 1, "Failed dimension check in SelectCols::backward");
   auto& rm = *pcols;
   for (unsigned i = 0; i < rm.size(); ++i)
-    dEdxi.t<2>().chip<1>(rm[i]).device(*dev.edevice) += dEdf.t<2>().chip<1>(i);
+    dEdxi.tb<2>().chip<1>(rm[i]).device(*dev.edevice) += dEdf.tb<2>().chip<1>(i);
 }
 DYNET_NODE_INST_DEV_IMPL(SelectCols)
 
@@ -1945,7 +2112,7 @@ void SelectRows::forward_dev_impl(const MyDevice & dev, const vector<const Tenso
   for (unsigned i = 0; i < rm.size(); ++i) {
     DYNET_ARG_CHECK(rm[i] < xs[0]->d.rows(),
                             "Out-of-bounds index " << rm[i] << " in SelectRows over expression of dimensions " << xs[0]->d);
-    fx.t<2>().chip<0>(i).device(*dev.edevice) = xs[0]->t<2>().chip<0>(rm[i]);
+    fx.tb<2>().chip<0>(i).device(*dev.edevice) = xs[0]->tb<2>().chip<0>(rm[i]);
   }
 }
 
@@ -1959,7 +2126,7 @@ void SelectRows::backward_dev_impl(const MyDevice & dev,
   DYNET_ARG_CHECK(xs.size() == 1, "Failed dimension check in SelectRows::backward");
   auto& rm = *prows;
   for (unsigned i = 0; i < rm.size(); ++i)
-    dEdxi.t<2>().chip<0>(rm[i]).device(*dev.edevice) += dEdf.t<2>().chip<0>(i);
+    dEdxi.tb<2>().chip<0>(rm[i]).device(*dev.edevice) += dEdf.tb<2>().chip<0>(i);
 }
 DYNET_NODE_INST_DEV_IMPL(SelectRows)
 
@@ -2015,25 +2182,31 @@ void Sparsemax::forward_dev_impl(const MyDevice & dev, const vector<const Tensor
 #ifdef __CUDACC__
     DYNET_RUNTIME_ERR("Sparsemax not implemented for CUDA");
 #else
+    // Each batch element keeps its support, preceded by its size, in its own
+    // rows + 1 entries of the auxiliary memory
     const unsigned rows = xs[0]->d.rows();
-    float *zs = static_cast<float*>(aux_mem);
-    std::partial_sort_copy(xs[0]->v, xs[0]->v+rows, zs, zs + rows, std::greater<float>());
-    float sum = 0, maxsum = 0;
-    unsigned k = 0;
-    for (k = 0; k < rows; ++k) {
-      sum += zs[k];
-      float t = 1 + (k + 1) * zs[k];
-      if (t <= sum) break;
-      maxsum = sum;
+    for (unsigned b = 0; b < fx.d.bd; ++b) {
+      const float *x = xs[0]->batch_ptr(b);
+      float *y = fx.batch_ptr(b);
+      float *zs = static_cast<float*>(aux_mem) + b * (rows + 1);
+      std::partial_sort_copy(x, x + rows, zs, zs + rows, std::greater<float>());
+      float sum = 0, maxsum = 0;
+      unsigned k = 0;
+      for (k = 0; k < rows; ++k) {
+        sum += zs[k];
+        float t = 1 + (k + 1) * zs[k];
+        if (t <= sum) break;
+        maxsum = sum;
+      }
+      float tau = (maxsum - 1) / k;
+      int c = 1;
+      int *cc = reinterpret_cast<int*>(zs);
+      for (unsigned i = 0; i < rows; ++i) {
+        y[i] = std::max(x[i] - tau, 0.f);
+        if (y[i] > 0.f) cc[c++] = i;
+      }
+      cc[0] = c - 1;
     }
-    float tau = (maxsum - 1) / k;
-    auto y = *fx;
-    fx.tvec() = (xs[0]->tvec() - tau).cwiseMax(0.f);
-    int c = 1;
-    int *cc = static_cast<int*>(aux_mem);
-    for (unsigned i = 0; i < rows; ++i)
-      if (y(i,0) > 0.f) cc[c++] = i;
-    cc[0] = c - 1;
 #endif
   } else {
     DYNET_RUNTIME_ERR("Sparsemax not yet implemented for multiple columns");
@@ -2050,15 +2223,20 @@ void Sparsemax::backward_dev_impl(const MyDevice & dev,
 #ifdef __CUDACC__
   DYNET_RUNTIME_ERR("Sparsemax not implemented for CUDA");
 #else
-  const int ssize = static_cast<int*>(aux_mem)[0];
-  int *support = static_cast<int*>(aux_mem) + 1;
-  float dhat = 0;
-  auto& d = *dEdf;
-  for (int i = 0; i < ssize; ++i)
-    dhat += d(support[i], 0);
-  dhat /= ssize;
-  for (int i = 0; i < ssize; ++i)
-    (*dEdxi)(support[i], 0) += d(support[i], 0) - dhat;
+  const unsigned rows = fx.d.rows();
+  for (unsigned b = 0; b < fx.d.bd; ++b) {
+    const int *cc = static_cast<int*>(aux_mem) + b * (rows + 1);
+    const int ssize = cc[0];
+    const int *support = cc + 1;
+    const float *d = dEdf.batch_ptr(b);
+    float *dx = dEdxi.batch_ptr(b);
+    float dhat = 0;
+    for (int i = 0; i < ssize; ++i)
+      dhat += d[support[i]];
+    dhat /= ssize;
+    for (int i = 0; i < ssize; ++i)
+      dx[support[i]] += d[support[i]] - dhat;
+  }
 #endif
 }
 DYNET_NODE_INST_DEV_IMPL(Sparsemax)
@@ -2220,7 +2398,7 @@ void L2Norm::backward_dev_impl(const MyDevice & dev,
                              Tensor& dEdxi) const {
   DYNET_ASSERT(i < 1, "Failed dimension check in L2Norm::backward");
   Eigen::array<ptrdiff_t, 2> bcast = {xs[0]->d.batch_size(), 1};
-  dEdxi.tbvec().device(*dev.edevice) += xs[0]->tbvec() * ((fx.tvec() / (float) xs[0]->d.batch_size()).binaryExpr(dEdf.tvec(), FSqrtBackward())).broadcast(bcast);
+  dEdxi.tbvec().device(*dev.edevice) += xs[0]->tbvec() * ((fx.tbvec() / (float) xs[0]->d.batch_size()).binaryExpr(dEdf.tbvec(), FSqrtBackward())).broadcast(bcast);
 
 }
 DYNET_NODE_INST_DEV_IMPL(L2Norm)
@@ -2572,9 +2750,8 @@ void TraceOfProduct::forward_dev_impl(const MyDevice & dev, const vector<const T
 #ifdef __CUDACC__
   DYNET_RUNTIME_ERR("TraceOfProduct not yet implemented for CUDA");
 #else
-  auto x1 = **xs[0];
-  auto x2 = **xs[1];
-  fx.v[0] = (x1 * x2.transpose()).trace();
+  // tr(x1 * x2^T) is the sum of the elementwise product, no need for the full product
+  fx.v[0] = (**xs[0]).cwiseProduct(**xs[1]).sum();
 #endif
 }
 
@@ -2827,9 +3004,9 @@ template<class MyDevice>
 void WeightNormalization::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
   DYNET_ASSERT(xs.size() == 2, "Failed dimension check in WeightNormalization::forward");
   Eigen::array<ptrdiff_t, 1> red_axis = {0};
-  Eigen::array<ptrdiff_t, 1> bcast = {xs[0]->d.size()};
-  Eigen::array<ptrdiff_t, 1> morph = {1};
-  fx.tvec().device(*dev.edevice) = (xs[0]->tvec() / xs[0]->tvec().square().sum(red_axis).sqrt().reshape(morph).broadcast(bcast)) * as_scalar(*xs[1]);
+  Eigen::array<ptrdiff_t, 2> bcast = {xs[0]->d.batch_size(), 1};
+  Eigen::array<ptrdiff_t, 2> morph = {1, xs[0]->d.bd};
+  fx.tbvec().device(*dev.edevice) = (xs[0]->tbvec() / xs[0]->tbvec().square().sum(red_axis).sqrt().reshape(morph).broadcast(bcast)) * as_scalar(*xs[1]);
 }
 
 template<class MyDevice>
@@ -2840,14 +3017,569 @@ void WeightNormalization::backward_dev_impl(const MyDevice & dev,
                              unsigned i,
                              Tensor& dEdxi) const {
   Eigen::array<ptrdiff_t, 1> red_axis = {0};
-  Eigen::array<ptrdiff_t, 1> bcast = {xs[0]->d.size()};
-  Eigen::array<ptrdiff_t, 1> morph = {1};
+  Eigen::array<ptrdiff_t, 2> bcast = {xs[0]->d.batch_size(), 1};
+  Eigen::array<ptrdiff_t, 2> morph = {1, xs[0]->d.bd};
   if (i==0){
-    dEdxi.tvec().device(*dev.edevice) += (dEdf.tvec() / xs[0]->tvec().square().sum(red_axis).sqrt().reshape(morph).broadcast(bcast)) * as_scalar(*xs[1]) - fx.tvec() * (((dEdf.tvec() * xs[0]->tvec()).sum(red_axis)) / xs[0]->tvec().square().sum(red_axis)).reshape(morph).broadcast(bcast);
+    dEdxi.tbvec().device(*dev.edevice) += (dEdf.tbvec() / xs[0]->tbvec().square().sum(red_axis).sqrt().reshape(morph).broadcast(bcast)) * as_scalar(*xs[1]) - fx.tbvec() * (((dEdf.tbvec() * xs[0]->tbvec()).sum(red_axis)) / xs[0]->tbvec().square().sum(red_axis)).reshape(morph).broadcast(bcast);
   }else{
-    dEdxi.t<0>().device(*dev.edevice) += ((dEdf.tvec() * xs[0]->tvec()).sum(red_axis)) /  xs[0]->tvec().square().sum(red_axis).sqrt();
+    // The gain is shared by all batch elements
+    dEdxi.t<0>().device(*dev.edevice) += (((dEdf.tbvec() * xs[0]->tbvec()).sum(red_axis)) /  xs[0]->tbvec().square().sum(red_axis).sqrt()).sum();
   }
 }
 DYNET_NODE_INST_DEV_IMPL(WeightNormalization)
 
+template<class MyDevice>
+void LSTMCell::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("LSTMCell not implemented for CUDA");
+#else
+  const unsigned ng = num_gates(), hid = xs[0]->d.rows() / ng, bd = fx.d.bd;
+  const unsigned gi = 0, gf = 1, go = coupled ? 1 : 2, gg = ng - 1;
+  float* act = static_cast<float*>(aux_mem);
+  RowBlock it = row_block(act, gi * hid, hid, bd, ng * hid), gt = row_block(act, gg * hid, hid, bd, ng * hid);
+  RowBlock ct = row_block(fx, output_gate ? hid : 0, hid, bd);
+  it = row_block(*xs[0], gi * hid, hid, bd);
+  if (xs.size() == 4)
+    it += row_block(*xs[1], 0, hid, bd).colwise() * Eigen::Map<Eigen::ArrayXf>(xs[2]->v, hid);
+  it = it.unaryExpr(scalar_logistic_sigmoid_op<float>());
+  gt = row_block(*xs[0], gg * hid, hid, bd).unaryExpr(scalar_tanh_op<float>());
+  ct = it * gt;
+  if (xs.size() > 1) {
+    RowBlock c_tm1 = row_block(*xs[1], 0, hid, bd);
+    if (coupled) {
+      ct += (1.f - it) * c_tm1;
+    } else {
+      RowBlock ft = row_block(act, gf * hid, hid, bd, ng * hid);
+      ft = (row_block(*xs[0], gf * hid, hid, bd) + forget_bias).unaryExpr(scalar_logistic_sigmoid_op<float>());
+      ct += ft * c_tm1;
+    }
+  }
+  if (output_gate) {
+    RowBlock ot = row_block(act, go * hid, hid, bd, ng * hid), tct = row_block(act + ng * hid * bd, 0, hid, bd, hid);
+    ot = row_block(*xs[0], go * hid, hid, bd);
+    if (xs.size() == 4)
+      ot += ct.colwise() * Eigen::Map<Eigen::ArrayXf>(xs[3]->v, hid);
+    ot = ot.unaryExpr(scalar_logistic_sigmoid_op<float>());
+    tct = ct.unaryExpr(scalar_tanh_op<float>());
+    row_block(fx, 0, hid, bd) = ot * tct;
+  }
+#endif
+}
+
+template<class MyDevice>
+void LSTMCell::backward_dev_impl(const MyDevice & dev,
+                             const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("LSTMCell not implemented for CUDA");
+#else
+  const unsigned ng = num_gates(), hid = xs[0]->d.rows() / ng, bd = fx.d.bd;
+  const unsigned gi = 0, gf = 1, go = coupled ? 1 : 2, gg = ng - 1;
+  float* act = static_cast<float*>(aux_mem);
+  RowBlock it = row_block(act, gi * hid, hid, bd, ng * hid), gt = row_block(act, gg * hid, hid, bd, ng * hid);
+  RowBlock ot = row_block(act, go * hid, hid, bd, ng * hid), tct = row_block(act + ng * hid * bd, 0, hid, bd, hid);
+  RowBlock ct = row_block(fx, output_gate ? hid : 0, hid, bd), dht = row_block(dEdf, 0, hid, bd);
+  // dE/dc_t, through both outputs
+  RowBlock dct = row_block(act + (ng + 1) * hid * bd, 0, hid, bd, hid);
+  dct = row_block(dEdf, output_gate ? hid : 0, hid, bd);
+  if (output_gate) {
+    dct += dht * ot * (1.f - tct.square());
+    if (xs.size() == 4)
+      dct += ot.binaryExpr(dht * tct, scalar_logistic_sigmoid_backward_op<float>()).colwise() * Eigen::Map<Eigen::ArrayXf>(xs[3]->v, hid);
+  }
+  // dE/dx for the pre-activation of the input gate
+  auto dit = [&]() -> Eigen::ArrayXXf {
+    if (coupled && xs.size() > 1)
+      return it.binaryExpr(dct * (gt - row_block(*xs[1], 0, hid, bd)), scalar_logistic_sigmoid_backward_op<float>());
+    return it.binaryExpr(dct * gt, scalar_logistic_sigmoid_backward_op<float>());
+  };
+  if (i == 0) {
+    add_row_block(dEdxi, gi * hid, hid, bd, dit());
+    add_row_block(dEdxi, gg * hid, hid, bd, gt.binaryExpr(dct * it, scalar_tanh_backward_op<float>()));
+    if (!coupled && xs.size() > 1)
+      add_row_block(dEdxi, gf * hid, hid, bd, row_block(act, gf * hid, hid, bd, ng * hid).binaryExpr(dct * row_block(*xs[1], 0, hid, bd), scalar_logistic_sigmoid_backward_op<float>()));
+    if (output_gate)
+      add_row_block(dEdxi, go * hid, hid, bd, ot.binaryExpr(dht * tct, scalar_logistic_sigmoid_backward_op<float>()));
+  } else if (i == 1) {
+    Eigen::ArrayXXf dc_tm1 = coupled ? (dct * (1.f - it)).eval() : (dct * row_block(act, gf * hid, hid, bd, ng * hid)).eval();
+    if (xs.size() == 4)
+      dc_tm1 += dit().colwise() * Eigen::Map<Eigen::ArrayXf>(xs[2]->v, hid);
+    add_row_block(dEdxi, 0, hid, bd, dc_tm1);
+  } else if (i == 2) {
+    Eigen::Map<Eigen::ArrayXf>(dEdxi.v, hid) += (dit() * row_block(*xs[1], 0, hid, bd)).rowwise().sum();
+  } else {
+    Eigen::Map<Eigen::ArrayXf>(dEdxi.v, hid) += (ot.binaryExpr(dht * tct, scalar_logistic_sigmoid_backward_op<float>()) * ct).rowwise().sum();
+  }
+#endif
+}
+DYNET_NODE_INST_DEV_IMPL(LSTMCell)
+
+template<class MyDevice>
+void GRUCell::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("GRUCell not implemented for CUDA");
+#else
+  const unsigned hid = fx.d.rows(), bd = fx.d.bd, n = hid * bd;
+  float* aux = static_cast<float*>(aux_mem);
+  RowBlock zt = row_block(aux, 0, hid, bd, hid), rt = row_block(aux + n, 0, hid, bd, hid), gt = row_block(aux + 2 * n, 0, hid, bd, hid);
+  RowBlock ht = row_block(fx, 0, hid, bd);
+  if (xs.size() == 1) {
+    zt = row_block(*xs[0], 0, hid, bd).unaryExpr(scalar_logistic_sigmoid_op<float>());
+    gt = row_block(*xs[0], 2 * hid, hid, bd).unaryExpr(scalar_tanh_op<float>());
+    ht = zt * gt;
+    return;
+  }
+  RowBlock rh = row_block(aux + 3 * n, 0, hid, bd, hid), h_tm1 = row_block(aux + 4 * n, 0, hid, bd, hid);
+  h_tm1 = row_block(*xs[1], 0, hid, bd);
+  Eigen::Map<Eigen::MatrixXf> hm(h_tm1.data(), hid, bd), rhm(rh.data(), hid, bd);
+  CPUMatrixMultiply(dev, **xs[2], false, hm, false, Eigen::Map<Eigen::MatrixXf>(zt.data(), hid, bd), false);
+  zt = (zt + row_block(*xs[0], 0, hid, bd)).unaryExpr(scalar_logistic_sigmoid_op<float>());
+  CPUMatrixMultiply(dev, **xs[3], false, hm, false, Eigen::Map<Eigen::MatrixXf>(rt.data(), hid, bd), false);
+  rt = (rt + row_block(*xs[0], hid, hid, bd)).unaryExpr(scalar_logistic_sigmoid_op<float>());
+  rh = rt * h_tm1;
+  CPUMatrixMultiply(dev, **xs[4], false, rhm, false, Eigen::Map<Eigen::MatrixXf>(gt.data(), hid, bd), false);
+  gt = (gt + row_block(*xs[0], 2 * hid, hid, bd)).unaryExpr(scalar_tanh_op<float>());
+  ht = h_tm1 + zt * (gt - h_tm1);
+#endif
+}
+
+template<class MyDevice>
+void GRUCell::backward_dev_impl(const MyDevice & dev,
+                             const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("GRUCell not implemented for CUDA");
+#else
+  const unsigned hid = fx.d.rows(), bd = fx.d.bd, n = hid * bd;
+  float* aux = static_cast<float*>(aux_mem);
+  RowBlock zt = row_block(aux, 0, hid, bd, hid), rt = row_block(aux + n, 0, hid, bd, hid), gt = row_block(aux + 2 * n, 0, hid, bd, hid);
+  RowBlock rh = row_block(aux + 3 * n, 0, hid, bd, hid), h_tm1 = row_block(aux + 4 * n, 0, hid, bd, hid);
+  RowBlock dzt = row_block(aux + 5 * n, 0, hid, bd, hid), drt = row_block(aux + 6 * n, 0, hid, bd, hid), dgt = row_block(aux + 7 * n, 0, hid, bd, hid);
+  RowBlock drh = row_block(aux + 8 * n, 0, hid, bd, hid), dh_tm1 = row_block(aux + 9 * n, 0, hid, bd, hid);
+  RowBlock dht = row_block(dEdf, 0, hid, bd);
+  // gradients of the pre-activations
+  dgt = gt.binaryExpr(dht * zt, scalar_tanh_backward_op<float>());
+  if (xs.size() == 1) {
+    dzt = zt.binaryExpr(dht * gt, scalar_logistic_sigmoid_backward_op<float>());
+    drt.setZero();
+  } else {
+    dzt = zt.binaryExpr(dht * (gt - h_tm1), scalar_logistic_sigmoid_backward_op<float>());
+    CPUMatrixMultiply(dev, **xs[4], true, Eigen::Map<Eigen::MatrixXf>(dgt.data(), hid, bd), false, Eigen::Map<Eigen::MatrixXf>(drh.data(), hid, bd), false);
+    drt = rt.binaryExpr(drh * h_tm1, scalar_logistic_sigmoid_backward_op<float>());
+  }
+  if (i == 0) {
+    add_row_block(dEdxi, 0, hid, bd, dzt);
+    if (xs.size() > 1)
+      add_row_block(dEdxi, hid, hid, bd, drt);
+    add_row_block(dEdxi, 2 * hid, hid, bd, dgt);
+  } else if (i == 1) {
+    dh_tm1 = dht * (1.f - zt) + drh * rt;
+    Eigen::Map<Eigen::MatrixXf> dhm(dh_tm1.data(), hid, bd);
+    CPUMatrixMultiply(dev, **xs[2], true, Eigen::Map<Eigen::MatrixXf>(dzt.data(), hid, bd), false, dhm, true);
+    CPUMatrixMultiply(dev, **xs[3], true, Eigen::Map<Eigen::MatrixXf>(drt.data(), hid, bd), false, dhm, true);
+    add_row_block(dEdxi, 0, hid, bd, dh_tm1);
+  } else {
+    // dE/dU = dE/da h^T, summed over the batch
+    RowBlock& da = (i == 2 ? dzt : (i == 3 ? drt : dgt));
+    RowBlock& h = (i == 4 ? rh : h_tm1);
+    CPUMatrixMultiply(dev, Eigen::Map<Eigen::MatrixXf>(da.data(), hid, bd), false,
+                      Eigen::Map<Eigen::MatrixXf>(h.data(), hid, bd), true, *dEdxi, true);
+  }
+#endif
+}
+DYNET_NODE_INST_DEV_IMPL(GRUCell)
+
+template<class MyDevice>
+void LSTMSequence::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("LSTMSequence not implemented for CUDA");
+#else
+  const unsigned hid = fx.d.rows(), len = fx.d.cols(), bd = fx.d.bd, n = hid * bd;
+  RNNSequenceMem m(aux_mem, 4, hid, bd, len, input_dim);
+  *m.valid = 0.f;
+  if (xs.size() == 6) {
+    row_block(m.hs, 0, hid, bd, hid) = row_block(*xs[4], 0, hid, bd);
+    row_block(m.cs, 0, hid, bd, hid) = row_block(*xs[5], 0, hid, bd);
+  } else {
+    row_block(m.hs, 0, hid, bd, hid).setZero();
+    row_block(m.cs, 0, hid, bd, hid).setZero();
+  }
+  // The input transformation of all steps is a single product
+  for (unsigned t = 0; t < len; ++t)
+    row_block(m.xs + t * input_dim * bd, 0, input_dim, bd, input_dim) = row_block(*xs[0], t * input_dim, input_dim, bd);
+  Eigen::Map<Eigen::MatrixXf> acts(m.acts, 4 * hid, bd * len);
+  acts = (**xs[3]).replicate(1, bd * len);
+  CPUMatrixMultiply(dev, **xs[1], false, Eigen::Map<Eigen::MatrixXf>(m.xs, input_dim, bd * len), false, acts, true);
+  for (unsigned t = 0; t < len; ++t) {
+    float* a = m.acts + 4 * n * t;
+    CPUMatrixMultiply(dev, **xs[2], false, Eigen::Map<Eigen::MatrixXf>(m.hs + n * t, hid, bd), false,
+                      Eigen::Map<Eigen::MatrixXf>(a, 4 * hid, bd), true);
+    RowBlock it = row_block(a, 0, hid, bd, 4 * hid), ft = row_block(a, hid, hid, bd, 4 * hid);
+    RowBlock ot = row_block(a, 2 * hid, hid, bd, 4 * hid), gt = row_block(a, 3 * hid, hid, bd, 4 * hid);
+    it = it.unaryExpr(scalar_logistic_sigmoid_op<float>());
+    ft = (ft + forget_bias).unaryExpr(scalar_logistic_sigmoid_op<float>());
+    ot = ot.unaryExpr(scalar_logistic_sigmoid_op<float>());
+    gt = gt.unaryExpr(scalar_tanh_op<float>());
+    RowBlock ct = row_block(m.cs + n * (t + 1), 0, hid, bd, hid), ht = row_block(m.hs + n * (t + 1), 0, hid, bd, hid);
+    ct = ft * row_block(m.cs + n * t, 0, hid, bd, hid) + it * gt;
+    ht = ot * ct.unaryExpr(scalar_tanh_op<float>());
+    row_block(fx, t * hid, hid, bd) = ht;
+    row_block(fx, (len + t) * hid, hid, bd) = ct;
+  }
+#endif
+}
+
+template<class MyDevice>
+void LSTMSequence::backward_dev_impl(const MyDevice & dev,
+                             const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("LSTMSequence not implemented for CUDA");
+#else
+  const unsigned hid = fx.d.rows(), len = fx.d.cols(), bd = fx.d.bd, n = hid * bd;
+  RNNSequenceMem m(aux_mem, 4, hid, bd, len, input_dim);
+  // Backpropagation through time, shared by all inputs
+  if (*m.valid == 0.f || !equal(dEdf.v, dEdf.v + dEdf.d.size(), m.dy)) {
+    RowBlock dht = row_block(m.dh, 0, hid, bd, hid), dct = row_block(m.dc, 0, hid, bd, hid);
+    dht.setZero();
+    dct.setZero();
+    for (int t = len - 1; t >= 0; --t) {
+      float* a = m.acts + 4 * n * t;
+      float* da = m.das + 4 * n * t;
+      RowBlock it = row_block(a, 0, hid, bd, 4 * hid), ft = row_block(a, hid, hid, bd, 4 * hid);
+      RowBlock ot = row_block(a, 2 * hid, hid, bd, 4 * hid), gt = row_block(a, 3 * hid, hid, bd, 4 * hid);
+      RowBlock c_tm1 = row_block(m.cs + n * t, 0, hid, bd, hid);
+      Eigen::ArrayXXf tct = row_block(m.cs + n * (t + 1), 0, hid, bd, hid).unaryExpr(scalar_tanh_op<float>());
+      dht += row_block(dEdf, t * hid, hid, bd);
+      dct += row_block(dEdf, (len + t) * hid, hid, bd);
+      row_block(da, 2 * hid, hid, bd, 4 * hid) = ot.binaryExpr(dht * tct, scalar_logistic_sigmoid_backward_op<float>());
+      dct += tct.binaryExpr(dht * ot, scalar_tanh_backward_op<float>());
+      row_block(da, 0, hid, bd, 4 * hid) = it.binaryExpr(dct * gt, scalar_logistic_sigmoid_backward_op<float>());
+      row_block(da, hid, hid, bd, 4 * hid) = ft.binaryExpr(dct * c_tm1, scalar_logistic_sigmoid_backward_op<float>());
+      row_block(da, 3 * hid, hid, bd, 4 * hid) = gt.binaryExpr(dct * it, scalar_tanh_backward_op<float>());
+      dct *= ft;
+      CPUMatrixMultiply(dev, **xs[2], true, Eigen::Map<Eigen::MatrixXf>(da, 4 * hid, bd), false,
+                        Eigen::Map<Eigen::MatrixXf>(m.dh, hid, bd), false);
+    }
+    copy(dEdf.v, dEdf.v + dEdf.d.size(), m.dy);
+    *m.valid = 1.f;
+  }
+  Eigen::Map<Eigen::MatrixXf> das(m.das, 4 * hid, bd * len);
+  if (i == 0) {
+    CPUMatrixMultiply(dev, **xs[1], true, das, false, Eigen::Map<Eigen::MatrixXf>(m.dxs, input_dim, bd * len), false);
+    for (unsigned t = 0; t < len; ++t)
+      add_row_block(dEdxi, t * input_dim, input_dim, bd, row_block(m.dxs + t * input_dim * bd, 0, input_dim, bd, input_dim));
+  } else if (i == 1) {
+    CPUMatrixMultiply(dev, das, false, Eigen::Map<Eigen::MatrixXf>(m.xs, input_dim, bd * len), true, *dEdxi, true);
+  } else if (i == 2) {
+    CPUMatrixMultiply(dev, das, false, Eigen::Map<Eigen::MatrixXf>(m.hs, hid, bd * len), true, *dEdxi, true);
+  } else if (i == 3) {
+    (*dEdxi).col(0) += das.rowwise().sum();
+  } else {
+    add_row_block(dEdxi, 0, hid, bd, row_block(i == 4 ? m.dh : m.dc, 0, hid, bd, hid));
+  }
+#endif
+}
+DYNET_NODE_INST_DEV_IMPL(LSTMSequence)
+
+template<class MyDevice>
+void GRUSequence::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("GRUSequence not implemented for CUDA");
+#else
+  const unsigned hid = fx.d.rows(), len = fx.d.cols(), bd = fx.d.bd, n = hid * bd;
+  RNNSequenceMem m(aux_mem, 3, hid, bd, len, input_dim);
+  *m.valid = 0.f;
+  if (xs.size() == 6)
+    row_block(m.hs, 0, hid, bd, hid) = row_block(*xs[5], 0, hid, bd);
+  else
+    row_block(m.hs, 0, hid, bd, hid).setZero();
+  // The input transformation of all steps is a single product
+  for (unsigned t = 0; t < len; ++t)
+    row_block(m.xs + t * input_dim * bd, 0, input_dim, bd, input_dim) = row_block(*xs[0], t * input_dim, input_dim, bd);
+  Eigen::Map<Eigen::MatrixXf> acts(m.acts, 3 * hid, bd * len);
+  acts = (**xs[2]).replicate(1, bd * len);
+  CPUMatrixMultiply(dev, **xs[1], false, Eigen::Map<Eigen::MatrixXf>(m.xs, input_dim, bd * len), false, acts, true);
+  for (unsigned t = 0; t < len; ++t) {
+    float* a = m.acts + 3 * n * t;
+    RowBlock zt = row_block(a, 0, hid, bd, 3 * hid), rt = row_block(a, hid, hid, bd, 3 * hid), gt = row_block(a, 2 * hid, hid, bd, 3 * hid);
+    RowBlock h_tm1 = row_block(m.hs + n * t, 0, hid, bd, hid), rh = row_block(m.cs + n * t, 0, hid, bd, hid);
+    CPUMatrixMultiply(dev, **xs[3], false, Eigen::Map<Eigen::MatrixXf>(h_tm1.data(), hid, bd), false,
+                      Eigen::Map<Eigen::MatrixXf>(m.tmp, 2 * hid, bd), false);
+    zt = (zt + row_block(m.tmp, 0, hid, bd, 2 * hid)).unaryExpr(scalar_logistic_sigmoid_op<float>());
+    rt = (rt + row_block(m.tmp, hid, hid, bd, 2 * hid)).unaryExpr(scalar_logistic_sigmoid_op<float>());
+    rh = rt * h_tm1;
+    CPUMatrixMultiply(dev, **xs[4], false, Eigen::Map<Eigen::MatrixXf>(rh.data(), hid, bd), false,
+                      Eigen::Map<Eigen::MatrixXf>(m.tmp, hid, bd), false);
+    gt = (gt + row_block(m.tmp, 0, hid, bd, hid)).unaryExpr(scalar_tanh_op<float>());
+    RowBlock ht = row_block(m.hs + n * (t + 1), 0, hid, bd, hid);
+    ht = h_tm1 + zt * (gt - h_tm1);
+    row_block(fx, t * hid, hid, bd) = ht;
+  }
+#endif
+}
+
+template<class MyDevice>
+void GRUSequence::backward_dev_impl(const MyDevice & dev,
+                             const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("GRUSequence not implemented for CUDA");
+#else
+  const unsigned hid = fx.d.rows(), len = fx.d.cols(), bd = fx.d.bd, n = hid * bd;
+  RNNSequenceMem m(aux_mem, 3, hid, bd, len, input_dim);
+  // Backpropagation through time, shared by all inputs
+  if (*m.valid == 0.f || !equal(dEdf.v, dEdf.v + dEdf.d.size(), m.dy)) {
+    RowBlock dht = row_block(m.dh, 0, hid, bd, hid), drh = row_block(m.dc, 0, hid, bd, hid);
+    // [dz; dr] and dg are kept contiguous for the recurrent products
+    RowBlock dzt = row_block(m.tmp, 0, hid, bd, 2 * hid), drt = row_block(m.tmp, hid, hid, bd, 2 * hid);
+    RowBlock dgt = row_block(m.tmp + 2 * n, 0, hid, bd, hid);
+    dht.setZero();
+    for (int t = len - 1; t >= 0; --t) {
+      float* a = m.acts + 3 * n * t;
+      float* da = m.das + 3 * n * t;
+      RowBlock zt = row_block(a, 0, hid, bd, 3 * hid), rt = row_block(a, hid, hid, bd, 3 * hid), gt = row_block(a, 2 * hid, hid, bd, 3 * hid);
+      RowBlock h_tm1 = row_block(m.hs + n * t, 0, hid, bd, hid);
+      dht += row_block(dEdf, t * hid, hid, bd);
+      dzt = zt.binaryExpr(dht * (gt - h_tm1), scalar_logistic_sigmoid_backward_op<float>());
+      dgt = gt.binaryExpr(dht * zt, scalar_tanh_backward_op<float>());
+      CPUMatrixMultiply(dev, **xs[4], true, Eigen::Map<Eigen::MatrixXf>(dgt.data(), hid, bd), false,
+                        Eigen::Map<Eigen::MatrixXf>(m.dc, hid, bd), false);
+      drt = rt.binaryExpr(drh * h_tm1, scalar_logistic_sigmoid_backward_op<float>());
+      dht = dht * (1.f - zt) + drh * rt;
+      CPUMatrixMultiply(dev, **xs[3], true, Eigen::Map<Eigen::MatrixXf>(m.tmp, 2 * hid, bd), false,
+                        Eigen::Map<Eigen::MatrixXf>(m.dh, hid, bd), true);
+      row_block(da, 0, hid, bd, 3 * hid) = dzt;
+      row_block(da, hid, hid, bd, 3 * hid) = drt;
+      row_block(da, 2 * hid, hid, bd, 3 * hid) = dgt;
+    }
+    copy(dEdf.v, dEdf.v + dEdf.d.size(), m.dy);
+    *m.valid = 1.f;
+  }
+  Eigen::Map<Eigen::MatrixXf> das(m.das, 3 * hid, bd * len);
+  if (i == 0) {
+    CPUMatrixMultiply(dev, **xs[1], true, das, false, Eigen::Map<Eigen::MatrixXf>(m.dxs, input_dim, bd * len), false);
+    for (unsigned t = 0; t < len; ++t)
+      add_row_block(dEdxi, t * input_dim, input_dim, bd, row_block(m.dxs + t * input_dim * bd, 0, input_dim, bd, input_dim));
+  } else if (i == 1) {
+    CPUMatrixMultiply(dev, das, false, Eigen::Map<Eigen::MatrixXf>(m.xs, input_dim, bd * len), true, *dEdxi, true);
+  } else if (i == 2) {
+    (*dEdxi).col(0) += das.rowwise().sum();
+  } else if (i == 3) {
+    (*dEdxi).noalias() += das.topRows(2 * hid) * Eigen::Map<Eigen::MatrixXf>(m.hs, hid, bd * len).transpose();
+  } else if (i == 4) {
+    (*dEdxi).noalias() += das.bottomRows(hid) * Eigen::Map<Eigen::MatrixXf>(m.cs, hid, bd * len).transpose();
+  } else {
+    add_row_block(dEdxi, 0, hid, bd, row_block(m.dh, 0, hid, bd, hid));
+  }
+#endif
+}
+DYNET_NODE_INST_DEV_IMPL(GRUSequence)
+
+template<class MyDevice>
+void AffinePickNegLogSoftmax::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("AffinePickNegLogSoftmax not implemented for CUDA");
+#else
+  typedef Eigen::Map<Eigen::MatrixXf, 0, Eigen::OuterStride<> > StridedMatrix;
+  const unsigned vocab = vocab_size, rep = rep_dim, bd = fx.d.bd, tile = min(tile_size, vocab);
+  AffineSoftmaxMem m(aux_mem, tile, vocab, rep, bd);
+  const Eigen::Map<Eigen::MatrixXf> x(xs[2]->v, rep, bd);
+  Eigen::Map<Eigen::ArrayXf> mx(m.logz, bd), sums(m.sums, bd);
+  mx.setConstant(-numeric_limits<float>::infinity());
+  sums.setZero();
+  for (unsigned b = 0; b < bd; ++b) {
+    const unsigned id = pval ? *pval : (*pvals)[b];
+    DYNET_ARG_CHECK(id < vocab, "Index " << id << " out of bounds in AffinePickNegLogSoftmax over " << vocab << " elements");
+  }
+  // The score of the picked element is kept in fx until logz is known
+  for (unsigned t0 = 0; t0 < vocab; t0 += tile) {
+    const unsigned rows = min(tile, vocab - t0);
+    Eigen::Map<Eigen::MatrixXf> scores(m.scores, rows, bd);
+    scores.noalias() = StridedMatrix(xs[1]->v + t0, rows, rep, Eigen::OuterStride<>(vocab)) * x;
+    scores.colwise() += Eigen::Map<Eigen::VectorXf>(xs[0]->v + t0, rows);
+    for (unsigned b = 0; b < bd; ++b) {
+      const float tile_max = scores.col(b).maxCoeff();
+      if (tile_max > mx(b)) {
+        sums(b) *= expf(mx(b) - tile_max);
+        mx(b) = tile_max;
+      }
+      sums(b) += (scores.col(b).array() - mx(b)).exp().sum();
+      const unsigned id = pval ? *pval : (*pvals)[b];
+      if (id >= t0 && id < t0 + rows)
+        fx.v[b] = scores(id - t0, b);
+    }
+  }
+  for (unsigned b = 0; b < bd; ++b) {
+    m.logz[b] = mx(b) + logf(sums(b));
+    fx.v[b] = m.logz[b] - fx.v[b];
+  }
+  *m.valid = 0.f;
+#endif
+}
+
+template<class MyDevice>
+void AffinePickNegLogSoftmax::backward_dev_impl(const MyDevice & dev,
+                             const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("AffinePickNegLogSoftmax not implemented for CUDA");
+#else
+  typedef Eigen::Map<Eigen::MatrixXf, 0, Eigen::OuterStride<> > StridedMatrix;
+  const unsigned vocab = vocab_size, rep = rep_dim, bd = fx.d.bd, tile = min(tile_size, vocab);
+  AffineSoftmaxMem m(aux_mem, tile, vocab, rep, bd);
+  const Eigen::Map<Eigen::MatrixXf> x(xs[2]->v, rep, bd);
+  Eigen::Map<Eigen::VectorXf> db(m.db, vocab);
+  Eigen::Map<Eigen::MatrixXf> dx(m.dx, rep, bd);
+  // dE/db and dE/dx are small and shared by all calls with the same dE/dy,
+  // while dE/dW is accumulated straight into dEdxi, so every call except the
+  // first one for W needs just one pass over the tiles
+  const bool shared = *m.valid == 0.f || !equal(dEdf.v, dEdf.v + bd, m.dy);
+  if (shared || i == 1) {
+    if (shared) {
+      db.setZero();
+      dx.setZero();
+    }
+    for (unsigned t0 = 0; t0 < vocab; t0 += tile) {
+      const unsigned rows = min(tile, vocab - t0);
+      const StridedMatrix w(xs[1]->v + t0, rows, rep, Eigen::OuterStride<>(vocab));
+      Eigen::Map<Eigen::MatrixXf> g(m.scores, rows, bd);
+      g.noalias() = w * x;
+      g.colwise() += Eigen::Map<Eigen::VectorXf>(xs[0]->v + t0, rows);
+      // dE/dscores = (softmax - onehot(id)) * dE/dy
+      for (unsigned b = 0; b < bd; ++b) {
+        g.col(b).array() = (g.col(b).array() - m.logz[b]).exp() * dEdf.v[b];
+        const unsigned id = pval ? *pval : (*pvals)[b];
+        if (id >= t0 && id < t0 + rows)
+          g(id - t0, b) -= dEdf.v[b];
+      }
+      if (shared) {
+        db.segment(t0, rows) += g.rowwise().sum();
+        dx.noalias() += w.transpose() * g;
+      }
+      if (i == 1)
+        StridedMatrix(dEdxi.v + t0, rows, rep, Eigen::OuterStride<>(vocab)).noalias() += g * x.transpose();
+    }
+    if (shared) {
+      copy(dEdf.v, dEdf.v + bd, m.dy);
+      *m.valid = 1.f;
+    }
+  }
+  if (i == 0) {
+    Eigen::Map<Eigen::VectorXf>(dEdxi.v, vocab) += db;
+  } else if (i == 2) {
+    Eigen::Map<Eigen::MatrixXf>(dEdxi.v, rep, bd) += dx;
+  }
+#endif
+}
+DYNET_NODE_INST_DEV_IMPL(AffinePickNegLogSoftmax)
+
+template<class MyDevice>
+void ScaledDotProductAttention::forward_dev_impl(const MyDevice & dev, const vector<const Tensor*>& xs, Tensor& fx) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("ScaledDotProductAttention not implemented for CUDA");
+#else
+  const unsigned d = xs[0]->d.rows(), m = num_keys, dv = fx.d.rows(), n = fx.d.cols(), bd = fx.d.bd;
+  const unsigned tile = min(tile_size, m);
+  const float scale = 1.f / sqrt((float)d);
+  AttentionMem mem(aux_mem, tile, n, bd);
+  for (unsigned b = 0; b < bd; ++b) {
+    const Eigen::Map<const Eigen::MatrixXf> v(xs[2]->batch_ptr(b), dv, m);
+    Eigen::Map<Eigen::MatrixXf> y(fx.batch_ptr(b), dv, n);
+    Eigen::Map<Eigen::ArrayXf> mx(mem.logz + b * n, n), sums(mem.sums, n);
+    y.setZero();
+    mx.setConstant(-numeric_limits<float>::infinity());
+    sums.setZero();
+    // y holds the sum of the values weighted by exp(score - max) until the
+    // end, and is rescaled whenever the max of a query grows
+    for (unsigned t0 = 0; t0 < m; t0 += tile) {
+      const unsigned rows = min(tile, m - t0);
+      Eigen::Map<Eigen::MatrixXf> s(mem.scores, rows, n);
+      attention_scores(xs, b, t0, rows, scale, s);
+      for (unsigned j = 0; j < n; ++j) {
+        const float tile_max = s.col(j).maxCoeff();
+        if (tile_max > mx(j)) {
+          const float r = expf(mx(j) - tile_max);
+          sums(j) *= r;
+          y.col(j) *= r;
+          mx(j) = tile_max;
+        }
+        s.col(j).array() = (s.col(j).array() - mx(j)).exp();
+        sums(j) += s.col(j).sum();
+      }
+      y.noalias() += v.middleCols(t0, rows) * s;
+    }
+    for (unsigned j = 0; j < n; ++j) {
+      y.col(j) /= sums(j);
+      mx(j) += logf(sums(j));
+    }
+  }
+#endif
+}
+
+template<class MyDevice>
+void ScaledDotProductAttention::backward_dev_impl(const MyDevice & dev,
+                             const vector<const Tensor*>& xs,
+                             const Tensor& fx,
+                             const Tensor& dEdf,
+                             unsigned i,
+                             Tensor& dEdxi) const {
+#ifdef __CUDACC__
+  DYNET_RUNTIME_ERR("ScaledDotProductAttention not implemented for CUDA");
+#else
+  const unsigned d = xs[0]->d.rows(), m = num_keys, dv = fx.d.rows(), n = fx.d.cols(), bd = fx.d.bd;
+  const unsigned tile = min(tile_size, m);
+  const float scale = 1.f / sqrt((float)d);
+  AttentionMem mem(aux_mem, tile, n, bd);
+  for (unsigned b = 0; b < bd; ++b) {
+    const Eigen::Map<const Eigen::MatrixXf> q(xs[0]->batch_ptr(b), d, n), k(xs[1]->batch_ptr(b), d, m);
+    const Eigen::Map<const Eigen::MatrixXf> v(xs[2]->batch_ptr(b), dv, m);
+    const Eigen::Map<const Eigen::MatrixXf> y(fx.batch_ptr(b), dv, n), dy(dEdf.batch_ptr(b), dv, n);
+    const Eigen::Map<const Eigen::ArrayXf> logz(mem.logz + b * n, n);
+    // dE/dscores = p * (dE/dp - sum_c dE/dy_c * y_c), with dE/dp = V^T dE/dy
+    Eigen::Map<Eigen::ArrayXf> delta(mem.sums, n);
+    if (i != 2)
+      delta = (dy.array() * y.array()).colwise().sum().transpose();
+    for (unsigned t0 = 0; t0 < m; t0 += tile) {
+      const unsigned rows = min(tile, m - t0);
+      Eigen::Map<Eigen::MatrixXf> p(mem.scores, rows, n);
+      attention_scores(xs, b, t0, rows, scale, p);
+      p.array() = (p.array().rowwise() - logz.transpose()).exp();
+      if (i == 2) {
+        Eigen::Map<Eigen::MatrixXf>(dEdxi.batch_ptr(b) + t0 * dv, dv, rows).noalias() += dy * p.transpose();
+        continue;
+      }
+      Eigen::Map<Eigen::MatrixXf> ds(mem.dscores, rows, n);
+      ds.noalias() = v.middleCols(t0, rows).transpose() * dy;
+      ds.array() = p.array() * (ds.array().rowwise() - delta.transpose());
+      if (i == 0) {
+        Eigen::Map<Eigen::MatrixXf>(dEdxi.batch_ptr(b), d, n).noalias() += scale * (k.middleCols(t0, rows) * ds);
+      } else if (i == 1) {
+        Eigen::Map<Eigen::MatrixXf>(dEdxi.batch_ptr(b) + t0 * d, d, rows).noalias() += scale * (q * ds.transpose());
+      } else if (dEdxi.d.cols() == 1) {
+        Eigen::Map<Eigen::VectorXf>(dEdxi.batch_ptr(b) + t0, rows) += ds.rowwise().sum();
+      } else {
+        Eigen::Map<Eigen::MatrixXf, 0, Eigen::OuterStride<> >(dEdxi.batch_ptr(b) + t0, rows, n, Eigen::OuterStride<>(m)) += ds;
+      }
+    }
+  }
+#endif
+}
+DYNET_NODE_INST_DEV_IMPL(ScaledDotProductAttention)
+
 } // namespace dynet
@@ -33,6 +33,7 @@ struct SparsemaxLoss : public Node {
 // y = arg min_y ||y - x||^2
 struct Sparsemax : public Node {
   explicit Sparsemax(const std::initializer_list<VariableIndex>& a) : Node(a) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   size_t aux_storage_size() const override;
 };
@@ -49,6 +50,7 @@ struct MatrixInverse : public Node {
 struct SelectRows : public Node {
   explicit SelectRows(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& r) : Node(a), rows(r), prows(&rows) {}
   explicit SelectRows(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>* pr) : Node(a), prows(pr) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   std::vector<unsigned> rows;
   const std::vector<unsigned>* prows;
@@ -59,6 +61,7 @@ struct SelectRows : public Node {
 struct SelectCols : public Node {
   explicit SelectCols(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& c) : Node(a), cols(c), pcols(&cols) {}
   explicit SelectCols(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>* pc) : Node(a), pcols(pc) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   std::vector<unsigned> cols;
   const std::vector<unsigned>* pcols;
@@ -129,6 +132,7 @@ struct Reshape : public Node {
 // y_i = \sum_{j=1}^n x_1:{i-1+j}
 struct KMHNGram : public Node {
   explicit KMHNGram(const std::initializer_list<VariableIndex>& a, unsigned n) : Node(a), n(n) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   unsigned n;  // width, n=2 for Karl's paper
 };
@@ -409,6 +413,7 @@ struct Rectify : public Node {
 // y = ty * log(x_1) + (1 - ty) * log(x_1)
 struct BinaryLogLoss : public Node {
   BinaryLogLoss(const std::initializer_list<VariableIndex>& a) : Node(a) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -515,6 +520,7 @@ struct Average : public Node {
 struct PoissonRegressionLoss : public Node {
   explicit PoissonRegressionLoss(const std::initializer_list<VariableIndex>& a, unsigned true_y) : Node(a), ty(true_y), pty(&ty) {}
   explicit PoissonRegressionLoss(const std::initializer_list<VariableIndex>& a, const unsigned* ptrue_y) : Node(a), ty(), pty(ptrue_y) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
  private:
   unsigned ty;
@@ -545,6 +551,7 @@ struct SquaredEuclideanDistance : public Node {
 // y = || x_1 - x_2 ||_H(d)
 struct HuberDistance : public Node {
   explicit HuberDistance(const std::initializer_list<VariableIndex>& a, float d = 1.345f) : Node(a), d(d) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   float d;
 };
@@ -552,6 +559,7 @@ struct HuberDistance : public Node {
 // y = || x_1 - x_2 ||_1
 struct L1Distance : public Node {
   explicit L1Distance(const std::initializer_list<VariableIndex>& a) : Node(a) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
 };
 
@@ -609,6 +617,7 @@ struct PickNegLogSoftmax : public Node {
 // y_i = (x_1)_i - \log z
 struct RestrictedLogSoftmax : public Node {
   explicit RestrictedLogSoftmax(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& d) : Node(a), denom(d) {}
+  virtual bool supports_multibatch() const override { return true; }
   DYNET_NODE_DEFINE_DEV_IMPL()
   std::vector<unsigned> denom;
 };
@@ -731,10 +740,111 @@ struct MinDimension : public Node {
 // y = x_1 * x_2
 struct WeightNormalization : public Node {
   explicit WeightNormalization(const std::initializer_list<VariableIndex>& a) : Node(a) {}
-  virtual bool supports_multibatch() const override { return false; }
+  virtual bool supports_multibatch() const override { return true; }
+  DYNET_NODE_DEFINE_DEV_IMPL()
+};
+
+// Fused LSTM cell
+// x_1 = gate pre-activations [i; f; o; g], [i; o; g] if the input and forget
+//       gates are coupled (f = 1 - i), or [i; g] without an output gate
+// x_2 = c_{t-1} (optional, 0 if missing)
+// x_3, x_4 = diagonal peephole weights from c_{t-1} to i and c_t to o (optional)
+// y = [h_t; c_t], or c_t without an output gate
+// The gate activations are kept in aux_mem for the backward pass.
+struct LSTMCell : public Node {
+  explicit LSTMCell(const std::initializer_list<VariableIndex>& a, bool coupled, bool output_gate, float forget_bias) :
+    Node(a), coupled(coupled), output_gate(output_gate), forget_bias(forget_bias) {}
   DYNET_NODE_DEFINE_DEV_IMPL()
+  virtual bool supports_multibatch() const override { return true; }
+  size_t aux_storage_size() const override;
+  unsigned num_gates() const { return (coupled ? 2 : 3) + (output_gate ? 1 : 0); }
+  bool coupled, output_gate;
+  float forget_bias;
 };
 
+// Fused GRU cell
+// x_1 = input pre-activations [a_z; a_r; a_h], including the biases
+// x_2 = h_{t-1} (optional, 0 if missing, in which case x_3..x_5 are absent)
+// x_3, x_4, x_5 = recurrent weights U_z, U_r, U_h
+// z = sigmoid(a_z + U_z h_{t-1}), r = sigmoid(a_r + U_r h_{t-1})
+// y = (1 - z) h_{t-1} + z tanh(a_h + U_h (r h_{t-1}))
+// The gate activations are kept in aux_mem for the backward pass.
+struct GRUCell : public Node {
+  explicit GRUCell(const std::initializer_list<VariableIndex>& a) : Node(a) {}
+  DYNET_NODE_DEFINE_DEV_IMPL()
+  virtual bool supports_multibatch() const override { return true; }
+  size_t aux_storage_size() const override;
+};
+
+// LSTM layer run over a whole sequence
+// x_1 = inputs, one column per timestep
+// x_2 = W_x, x_3 = W_h, x_4 = b, with the gates stacked as [i; f; o; g]
+// x_5, x_6 = h_{-1}, c_{-1} (optional, 0 if missing)
+// y[:, t, 0] = h_t, y[:, t, 1] = c_t
+// The activations of all timesteps are kept in aux_mem, and backpropagation
+// through time runs once per output gradient, the first time it is needed.
+struct LSTMSequence : public Node {
+  explicit LSTMSequence(const std::initializer_list<VariableIndex>& a, float forget_bias) : Node(a), forget_bias(forget_bias) {}
+  DYNET_NODE_DEFINE_DEV_IMPL()
+  virtual bool supports_multibatch() const override { return true; }
+  size_t aux_storage_size() const override;
+  float forget_bias;
+  mutable unsigned input_dim = 0;
+};
+
+// GRU layer run over a whole sequence
+// x_1 = inputs, one column per timestep
+// x_2 = W_x, x_3 = b, with the gates stacked as [z; r; h]
+// x_4 = [U_z; U_r], x_5 = U_h
+// x_6 = h_{-1} (optional, 0 if missing)
+// y = [h_0 ... h_{T-1}]
+// Same storage and backpropagation as LSTMSequence.
+struct GRUSequence : public Node {
+  explicit GRUSequence(const std::initializer_list<VariableIndex>& a) : Node(a) {}
+  DYNET_NODE_DEFINE_DEV_IMPL()
+  virtual bool supports_multibatch() const override { return true; }
+  size_t aux_storage_size() const override;
+  mutable unsigned input_dim = 0;
+};
+
+// Negative log softmax of an affine transform, picked at the given indices
+// x_1 = b, x_2 = W, x_3 = x
+// y = -log softmax(W x + b)_{*pval}, or one loss per batch element for *pvals
+// The scores are computed tile_size rows of W at a time, with a running max
+// and sum per batch element, and recomputed in the backward pass, so the full
+// vocabulary x batch score matrix is never stored.
+struct AffinePickNegLogSoftmax : public Node {
+  explicit AffinePickNegLogSoftmax(const std::initializer_list<VariableIndex>& a, unsigned v, unsigned tile_size) :
+    Node(a), val(v), pval(&val), vals(), pvals(), tile_size(tile_size) {}
+  explicit AffinePickNegLogSoftmax(const std::initializer_list<VariableIndex>& a, const std::vector<unsigned>& v, unsigned tile_size) :
+    Node(a), val(), pval(), vals(v), pvals(&vals), tile_size(tile_size) {}
+  DYNET_NODE_DEFINE_DEV_IMPL()
+  virtual bool supports_multibatch() const override { return true; }
+  size_t aux_storage_size() const override;
+  unsigned val;
+  const unsigned* pval;
+  std::vector<unsigned> vals;
+  const std::vector<unsigned>* pvals;
+  unsigned tile_size;
+  mutable unsigned vocab_size = 0, rep_dim = 0;
+};
+
+// Scaled dot-product attention
+// x_1 = Q (d x n), x_2 = K (d x m), x_3 = V (d_v x m)
+// x_4 = mask, added to the scores (m, or m x n) (optional)
+// y = V softmax(K^T Q / sqrt(d) + mask), with the softmax over each column
+// The scores are computed tile_size keys at a time, with a running max and
+// sum per query, and recomputed in the backward pass, so the full m x n
+// score matrix is never stored.
+struct ScaledDotProductAttention : public Node {
+  explicit ScaledDotProductAttention(const std::initializer_list<VariableIndex>& a, unsigned tile_size) :
+    Node(a), tile_size(tile_size) {}
+  DYNET_NODE_DEFINE_DEV_IMPL()
+  virtual bool supports_multibatch() const override { return true; }
+  size_t aux_storage_size() const override;
+  unsigned tile_size;
+  mutable unsigned num_keys = 0;
+};
 
 } // namespace dynet
 
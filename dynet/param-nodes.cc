@@ -6,6 +6,7 @@
 
 #include "dynet/nodes-macros.h"
 #include "dynet/weight-decay.h"
+#include "dynet/thread-gradients.h"
 
 #ifdef HAVE_CUDA
 #include "dynet/gpu-ops.h"
@@ -40,7 +41,11 @@ Dim ParameterNode::dim_forward(const vector<Dim>& xs) const {
 }
 
 void ParameterNode::accumulate_grad(const Tensor& g) {
-  if(params.mp != nullptr)
+  if(thread_gradients != nullptr && params.mp != nullptr)
+    thread_gradients->accumulate(params.get(), g);
+  else if(thread_gradients != nullptr && lparams.mp != nullptr)
+    thread_gradients->accumulate(lparams.get(), g);
+  else if(params.mp != nullptr)
     params.get()->accumulate_grad(g);
   else if(lparams.mp != nullptr)
     lparams.get()->accumulate_grad(g);
@@ -99,7 +104,12 @@ Dim LookupNode::dim_forward(const vector<Dim>& xs) const {
 }
 
 void LookupNode::accumulate_grad(const Tensor& g) {
-  if(pindex) {
+  if(thread_gradients != nullptr) {
+    if(pindex)
+      thread_gradients->accumulate(params.get(), *pindex, g);
+    else
+      thread_gradients->accumulate(params.get(), pindices->size(), &(*pindices)[0], g.v);
+  } else if(pindex) {
     params.get()->accumulate_grad(*pindex, g);
   } else {
     DYNET_ASSERT(pindices, "Have neither index nor index vector in LookupNode");
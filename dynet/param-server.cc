@@ -0,0 +1,338 @@
+#if !_WINDOWS
+#include "dynet/param-server.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "dynet/except.h"
+#include "dynet/globals.h"
+
+using namespace std;
+
+namespace dynet {
+namespace ps {
+
+// Read exactly n bytes, returning false if the peer closed the connection
+// before anything was read
+static bool read_all(int fd, void* buf, size_t n) {
+  char* p = static_cast<char*>(buf);
+  size_t done = 0;
+  while (done < n) {
+    ssize_t r = read(fd, p + done, n - done);
+    if (r == 0 && done == 0) return false;
+    if (r <= 0) DYNET_RUNTIME_ERR("Failed to read from parameter server connection: " << strerror(errno));
+    done += r;
+  }
+  return true;
+}
+
+static void write_all(int fd, const void* buf, size_t n) {
+  const char* p = static_cast<const char*>(buf);
+  size_t done = 0;
+  while (done < n) {
+    ssize_t r = write(fd, p + done, n - done);
+    if (r <= 0) DYNET_RUNTIME_ERR("Failed to write to parameter server connection: " << strerror(errno));
+    done += r;
+  }
+}
+
+template <class T>
+static void append(vector<char>& buf, const T* data, size_t n) {
+  const char* p = reinterpret_cast<const char*>(data);
+  buf.insert(buf.end(), p, p + n * sizeof(T));
+}
+
+// Values are sent with the weight decay of the sender folded in
+static void append_values(vector<char>& buf, const Tensor& t, float scale) {
+  const size_t pos = buf.size();
+  append(buf, t.v, t.d.size());
+  float* f = reinterpret_cast<float*>(&buf[pos]);
+  for (size_t i = 0; i < t.d.size(); ++i) f[i] *= scale;
+}
+
+static void set_nodelay(int fd) {
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+ParameterServer::ParameterServer(Model& model, Trainer& trainer, unsigned shard, unsigned num_shards, unsigned short port) :
+  model(&model), trainer(&trainer), shard(shard), num_shards(num_shards), listen_fd(-1), bound_port(0) {
+  DYNET_ARG_CHECK(shard < num_shards, "Bad shard " << shard << " of " << num_shards << " in ParameterServer");
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0) DYNET_RUNTIME_ERR("Could not create parameter server socket: " << strerror(errno));
+  int one = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (::bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, 64) != 0)
+    DYNET_RUNTIME_ERR("Could not listen on port " << port << ": " << strerror(errno));
+  socklen_t len = sizeof(addr);
+  getsockname(listen_fd, (sockaddr*)&addr, &len);
+  bound_port = ntohs(addr.sin_port);
+}
+
+ParameterServer::~ParameterServer() {
+  if (listen_fd >= 0) close(listen_fd);
+}
+
+void ParameterServer::serve(unsigned num_clients) {
+  // Updates run on the device holding the parameters, even if serve() is
+  // called from a thread other than the one that called initialize()
+  if (default_device == nullptr) default_device = devices[0];
+  vector<int> clients;
+  unsigned accepted = 0;
+  while (accepted < num_clients || !clients.empty()) {
+    vector<pollfd> pfds;
+    if (accepted < num_clients) pfds.push_back({listen_fd, POLLIN, 0});
+    for (int fd : clients) pfds.push_back({fd, POLLIN, 0});
+    if (poll(&pfds[0], pfds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      DYNET_RUNTIME_ERR("poll() failed in ParameterServer: " << strerror(errno));
+    }
+    for (auto & pfd : pfds) {
+      if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR))) continue;
+      if (pfd.fd == listen_fd) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) DYNET_RUNTIME_ERR("accept() failed in ParameterServer: " << strerror(errno));
+        set_nodelay(fd);
+        clients.push_back(fd);
+        ++accepted;
+        continue;
+      }
+      MessageHeader header;
+      if (!read_all(pfd.fd, &header, sizeof(header))) {
+        close(pfd.fd);
+        clients.erase(find(clients.begin(), clients.end(), pfd.fd));
+      } else if (header.type == MessageType::PUSH) {
+        handle_push(pfd.fd, header);
+      } else if (header.type == MessageType::PULL) {
+        handle_pull(pfd.fd);
+      } else {
+        DYNET_RUNTIME_ERR("Unexpected message type " << (uint32_t)header.type << " in ParameterServer");
+      }
+    }
+  }
+}
+
+void ParameterServer::handle_push(int fd, const MessageHeader& header) {
+  const uint32_t num_entries = header.num_entries;
+  const auto & params = model->parameters_list();
+  const auto & lookup_params = model->lookup_parameters_list();
+  vector<EntryHeader> entries(num_entries);
+  vector<vector<unsigned> > rows(num_entries);
+  vector<unsigned> upd_params, upd_lookup_params;
+  vector<float> data;
+  vector<char> encoded;
+  for (uint32_t e = 0; e < num_entries; ++e) {
+    EntryHeader & entry = entries[e];
+    read_all(fd, &entry, sizeof(entry));
+    if (!entry.lookup) {
+      DYNET_ARG_CHECK(entry.index < params.size() && entry.index % num_shards == shard,
+                      "Parameter " << entry.index << " does not belong to shard " << shard);
+      ParameterStorage* p = params[entry.index];
+      uint32_t nbytes;
+      read_all(fd, &nbytes, sizeof(nbytes));
+      encoded.resize(nbytes);
+      read_all(fd, &encoded[0], nbytes);
+      GradientCompressor::decode(header.compression, &encoded[0], nbytes, p->g.v, p->g.d.size());
+      upd_params.push_back(entry.index);
+    } else {
+      DYNET_ARG_CHECK(entry.index < lookup_params.size(), "Bad lookup parameter " << entry.index << " in push");
+      LookupParameterStorage* p = lookup_params[entry.index];
+      rows[e].resize(entry.nrows);
+      read_all(fd, &rows[e][0], entry.nrows * sizeof(unsigned));
+      const size_t row_size = p->dim.size();
+      data.resize(entry.nrows * row_size);
+      read_all(fd, &data[0], data.size() * sizeof(float));
+      for (uint32_t r = 0; r < entry.nrows; ++r) {
+        const unsigned row = rows[e][r];
+        DYNET_ARG_CHECK(row < p->values.size() && row % num_shards == shard,
+                        "Row " << row << " does not belong to shard " << shard);
+        p->accumulate_grad(row, Tensor(p->dim, &data[r * row_size], p->all_grads.device, DeviceMempool::NONE));
+      }
+      upd_lookup_params.push_back(entry.index);
+    }
+  }
+  if (num_entries > 0)
+    trainer->update(upd_params, upd_lookup_params);
+
+  // Reply with the new values of everything that was pushed
+  const float wd = model->weight_decay.current_weight_decay();
+  vector<char> buf;
+  MessageHeader reply = {MessageType::VALUES, num_entries, GradientCompression::NONE};
+  append(buf, &reply, 1);
+  for (uint32_t e = 0; e < num_entries; ++e) {
+    append(buf, &entries[e], 1);
+    if (!entries[e].lookup) {
+      append_values(buf, params[entries[e].index]->values, wd);
+    } else {
+      append(buf, &rows[e][0], rows[e].size());
+      for (auto row : rows[e])
+        append_values(buf, lookup_params[entries[e].index]->values[row], wd);
+    }
+  }
+  write_all(fd, &buf[0], buf.size());
+}
+
+void ParameterServer::handle_pull(int fd) {
+  const auto & params = model->parameters_list();
+  const auto & lookup_params = model->lookup_parameters_list();
+  const float wd = model->weight_decay.current_weight_decay();
+  vector<char> buf;
+  MessageHeader reply = {MessageType::VALUES, 0, GradientCompression::NONE};
+  append(buf, &reply, 1);
+  for (unsigned i = shard; i < params.size(); i += num_shards) {
+    EntryHeader entry = {0, i, 0};
+    append(buf, &entry, 1);
+    append_values(buf, params[i]->values, wd);
+    ++reply.num_entries;
+  }
+  for (unsigned i = 0; i < lookup_params.size(); ++i) {
+    vector<unsigned> rows;
+    for (unsigned row = shard; row < lookup_params[i]->values.size(); row += num_shards)
+      rows.push_back(row);
+    if (rows.empty()) continue;
+    EntryHeader entry = {1, i, (uint32_t)rows.size()};
+    append(buf, &entry, 1);
+    append(buf, &rows[0], rows.size());
+    for (auto row : rows)
+      append_values(buf, lookup_params[i]->values[row], wd);
+    ++reply.num_entries;
+  }
+  memcpy(&buf[0], &reply, sizeof(reply));
+  write_all(fd, &buf[0], buf.size());
+}
+
+ParameterClient::ParameterClient(Model& model, const vector<pair<string, unsigned short> >& servers, unsigned staleness,
+                                 GradientCompression compression, float topk_ratio) :
+  model(&model), staleness(staleness), updates_since_pull(0), compressor(compression, topk_ratio) {
+  DYNET_ARG_CHECK(servers.size() > 0, "ParameterClient needs at least one server");
+  for (auto & server : servers) {
+    addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    ostringstream port; port << server.second;
+    if (getaddrinfo(server.first.c_str(), port.str().c_str(), &hints, &res) != 0)
+      DYNET_RUNTIME_ERR("Could not resolve parameter server " << server.first);
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+      freeaddrinfo(res);
+      DYNET_RUNTIME_ERR("Could not connect to parameter server " << server.first << ":" << server.second << ": " << strerror(errno));
+    }
+    freeaddrinfo(res);
+    set_nodelay(fd);
+    fds.push_back(fd);
+  }
+}
+
+ParameterClient::~ParameterClient() {
+  for (int fd : fds) close(fd);
+}
+
+void ParameterClient::read_values(int fd) {
+  const auto & params = model->parameters_list();
+  const auto & lookup_params = model->lookup_parameters_list();
+  const float wd = model->weight_decay.current_weight_decay();
+  MessageHeader header;
+  if (!read_all(fd, &header, sizeof(header)) || header.type != MessageType::VALUES)
+    DYNET_RUNTIME_ERR("Expected parameter values from the parameter server");
+  vector<unsigned> rows;
+  for (uint32_t e = 0; e < header.num_entries; ++e) {
+    EntryHeader entry;
+    read_all(fd, &entry, sizeof(entry));
+    if (!entry.lookup) {
+      Tensor & values = params[entry.index]->values;
+      read_all(fd, values.v, values.d.size() * sizeof(float));
+      values.vec() /= wd;
+    } else {
+      LookupParameterStorage* p = lookup_params[entry.index];
+      rows.resize(entry.nrows);
+      read_all(fd, &rows[0], entry.nrows * sizeof(unsigned));
+      for (auto row : rows) {
+        read_all(fd, p->values[row].v, p->dim.size() * sizeof(float));
+        p->values[row].vec() /= wd;
+      }
+    }
+  }
+}
+
+void ParameterClient::push() {
+  const unsigned num_shards = fds.size();
+  const auto & params = model->parameters_list();
+  const auto & lookup_params = model->lookup_parameters_list();
+  for (unsigned s = 0; s < num_shards; ++s) {
+    vector<char> buf;
+    MessageHeader header = {MessageType::PUSH, 0, compressor.type};
+    append(buf, &header, 1);
+    for (auto i : model->updated_parameters_list()) {
+      if (i % num_shards != s) continue;
+      EntryHeader entry = {0, i, 0};
+      append(buf, &entry, 1);
+      const size_t pos = buf.size();
+      uint32_t nbytes = 0;
+      append(buf, &nbytes, 1);
+      compressor.encode(params[i], buf);
+      nbytes = buf.size() - pos - sizeof(nbytes);
+      memcpy(&buf[pos], &nbytes, sizeof(nbytes));
+      ++header.num_entries;
+    }
+    for (auto i : model->updated_lookup_parameters_list()) {
+      LookupParameterStorage* p = lookup_params[i];
+      vector<unsigned> rows;
+      if (p->all_updated) {
+        for (unsigned row = s; row < p->values.size(); row += num_shards)
+          rows.push_back(row);
+      } else {
+        for (auto row : p->non_zero_grads)
+          if (row % num_shards == s) rows.push_back(row);
+      }
+      if (rows.empty()) continue;
+      EntryHeader entry = {1, i, (uint32_t)rows.size()};
+      append(buf, &entry, 1);
+      append(buf, &rows[0], rows.size());
+      for (auto row : rows)
+        append(buf, p->grads[row].v, p->dim.size());
+      ++header.num_entries;
+    }
+    memcpy(&buf[0], &header, sizeof(header));
+    write_all(fds[s], &buf[0], buf.size());
+  }
+  for (auto i : model->updated_parameters_list())
+    params[i]->clear();
+  for (auto i : model->updated_lookup_parameters_list())
+    lookup_params[i]->clear();
+  for (int fd : fds)
+    read_values(fd);
+}
+
+void ParameterClient::pull() {
+  MessageHeader header = {MessageType::PULL, 0, GradientCompression::NONE};
+  for (int fd : fds)
+    write_all(fd, &header, sizeof(header));
+  for (int fd : fds)
+    read_values(fd);
+  updates_since_pull = 0;
+}
+
+void ParameterClient::update() {
+  push();
+  if (++updates_since_pull >= staleness)
+    pull();
+}
+
+} // namespace ps
+} // namespace dynet
+#endif // !_WINDOWS
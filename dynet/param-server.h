@@ -0,0 +1,139 @@
+/**
+ * \file param-server.h
+ * \brief Asynchronous training against parameter servers over TCP
+ *
+ * The parameters of a Model are sharded across several ParameterServer
+ * processes: dense parameter `i` lives on server `i % num_shards`, and row `r`
+ * of every lookup parameter lives on server `r % num_shards`, which spreads
+ * large vocabularies evenly. Each worker builds the same Model locally, trains
+ * it as usual with backward(), and calls ParameterClient::update() instead of
+ * Trainer::update(). The client pushes the dense gradients and the touched
+ * lookup rows (LookupParameterStorage::non_zero_grads) to the servers, which
+ * apply their Trainer and answer with the new values of what was pushed.
+ * Everything else is refreshed by a full pull at least every `staleness`
+ * updates. Dense gradients can be compressed before they are pushed, with
+ * their residuals kept by the client.
+ */
+
+#ifndef DYNET_PARAM_SERVER_H_
+#define DYNET_PARAM_SERVER_H_
+#if !_WINDOWS
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dynet/grad-compression.h"
+#include "dynet/model.h"
+#include "dynet/training.h"
+
+namespace dynet {
+namespace ps {
+
+enum class MessageType : uint32_t { PUSH = 1, PULL = 2, VALUES = 3 };
+
+// Every message starts with this header, followed by `num_entries` entries.
+// `compression` tells how the dense gradients of a PUSH are encoded.
+struct MessageHeader {
+  MessageType type;
+  uint32_t num_entries;
+  GradientCompression compression;
+};
+
+// An entry holds either a dense parameter (`nrows == 0`) or some rows of a
+// lookup parameter. It is followed by `nrows` row ids and then by the floats
+// of the gradient or values, row after row. Dense gradients are instead
+// followed by their size in bytes and their encoding (see grad-compression.h).
+struct EntryHeader {
+  uint32_t lookup;
+  uint32_t index;
+  uint32_t nrows;
+};
+
+/**
+ * \brief Server owning one shard of a Model
+ */
+class ParameterServer {
+ public:
+  /**
+   * \param model Model with the same parameters as the workers' models
+   * \param trainer Trainer applied to the pushed gradients
+   * \param shard Id of the shard served
+   * \param num_shards Total number of shards
+   * \param port TCP port to listen on (0 picks a free port)
+   */
+  ParameterServer(Model& model, Trainer& trainer, unsigned shard, unsigned num_shards, unsigned short port = 0);
+  ~ParameterServer();
+  ParameterServer(const ParameterServer&) = delete;
+  ParameterServer& operator=(const ParameterServer&) = delete;
+
+  /**
+   * \brief Serve requests until `num_clients` clients have connected and disconnected
+   */
+  void serve(unsigned num_clients);
+
+  unsigned short port() const { return bound_port; }
+
+ private:
+  void handle_push(int fd, const MessageHeader& header);
+  void handle_pull(int fd);
+
+  Model* model;
+  Trainer* trainer;
+  unsigned shard;
+  unsigned num_shards;
+  int listen_fd;
+  unsigned short bound_port;
+};
+
+/**
+ * \brief Worker-side connection to all the shards of a Model
+ */
+class ParameterClient {
+ public:
+  /**
+   * \param model Local replica of the Model
+   * \param servers Host and port of every shard, in shard order
+   * \param staleness Maximum number of updates between two full pulls
+   * \param compression Encoding of the dense gradients pushed
+   * \param topk_ratio Fraction of the entries pushed with GradientCompression::TOPK
+   */
+  ParameterClient(Model& model, const std::vector<std::pair<std::string, unsigned short> >& servers, unsigned staleness = 1,
+                  GradientCompression compression = GradientCompression::NONE, float topk_ratio = 0.01);
+  ~ParameterClient();
+  ParameterClient(const ParameterClient&) = delete;
+  ParameterClient& operator=(const ParameterClient&) = delete;
+
+  /**
+   * \brief Push the local gradients and fetch the updated values
+   * \details Clears the local gradients, and performs a full pull every
+   *          `staleness` calls.
+   */
+  void update();
+
+  /**
+   * \brief Push the local gradients, and copy back the values the servers return
+   */
+  void push();
+
+  /**
+   * \brief Fetch the values of all parameters from the servers
+   */
+  void pull();
+
+ private:
+  void read_values(int fd);
+
+  Model* model;
+  std::vector<int> fds;
+  unsigned staleness;
+  unsigned updates_since_pull;
+  GradientCompressor compressor;
+};
+
+} // namespace ps
+} // namespace dynet
+
+#endif // !_WINDOWS
+#endif
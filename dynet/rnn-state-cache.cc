@@ -0,0 +1,71 @@
+#include "dynet/rnn-state-cache.h"
+
+#include "dynet/except.h"
+#include "dynet/tensor.h"
+
+using namespace std;
+
+namespace dynet {
+
+using namespace expr;
+
+RNNStateSnapshot RNNStateSnapshot::capture(const RNNBuilder& rnn) {
+  RNNStateSnapshot snapshot;
+  for (auto& s : rnn.final_s()) {
+    DYNET_ARG_CHECK(s.pg != nullptr, "RNNStateSnapshot::capture needs an RNN that has started a sequence");
+    vector<float> vals = as_vector(s.value());
+    snapshot.dims.push_back(s.dim());
+    snapshot.values.insert(snapshot.values.end(), vals.begin(), vals.end());
+  }
+  return snapshot;
+}
+
+vector<Expression> RNNStateSnapshot::restore(ComputationGraph& cg) const {
+  vector<Expression> state;
+  auto begin = values.begin();
+  for (auto& d : dims) {
+    state.push_back(input(cg, d, vector<float>(begin, begin + d.size())));
+    begin += d.size();
+  }
+  return state;
+}
+
+RNNStateCache::RNNStateCache(unsigned capacity) : max_size(capacity) {
+  DYNET_ARG_CHECK(capacity > 0, "RNNStateCache needs a capacity of at least 1");
+}
+
+const RNNStateSnapshot* RNNStateCache::get(const string& session) {
+  auto it = index.find(session);
+  if (it == index.end()) return nullptr;
+  entries.splice(entries.begin(), entries, it->second);
+  return &it->second->second;
+}
+
+void RNNStateCache::put(const string& session, RNNStateSnapshot state) {
+  auto it = index.find(session);
+  if (it != index.end()) {
+    it->second->second = std::move(state);
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+  if (entries.size() == max_size) {
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+  entries.emplace_front(session, std::move(state));
+  index[session] = entries.begin();
+}
+
+void RNNStateCache::erase(const string& session) {
+  auto it = index.find(session);
+  if (it == index.end()) return;
+  entries.erase(it->second);
+  index.erase(it);
+}
+
+void RNNStateCache::clear() {
+  entries.clear();
+  index.clear();
+}
+
+} // namespace dynet
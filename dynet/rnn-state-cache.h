@@ -0,0 +1,100 @@
+/**
+ * \file rnn-state-cache.h
+ * \brief Carrying RNN states from one computation graph to the next
+ *
+ * When every request continues a prefix that an earlier request has already
+ * read (autocomplete, streaming recognition, interactive decoding), the
+ * state the RNN reached at the end of the prefix can be copied out of the
+ * graph with RNNStateSnapshot::capture and fed to `start_new_sequence` of a
+ * later graph with RNNStateSnapshot::restore, instead of reading the prefix
+ * again. RNNStateCache keeps these snapshots for a bounded number of
+ * sessions, and drops the least recently used ones first.
+ */
+
+#ifndef DYNET_RNN_STATE_CACHE_H_
+#define DYNET_RNN_STATE_CACHE_H_
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dynet/dynet.h"
+#include "dynet/expr.h"
+#include "dynet/rnn.h"
+
+namespace dynet {
+
+/**
+ * \brief The state of an RNN, copied out of its computation graph
+ * \details All the components of `final_s()` are kept in host memory, one
+ *          after the other, so a snapshot does not depend on the graph or
+ *          memory pools it came from.
+ */
+struct RNNStateSnapshot {
+  /**
+   * \brief Copy the current state of an RNN
+   * \details This runs the forward pass up to the state, if needed.
+   */
+  static RNNStateSnapshot capture(const RNNBuilder& rnn);
+
+  /**
+   * \brief Recreate the state in a graph
+   *
+   * \return Inputs holding the state, to pass to `start_new_sequence`
+   */
+  std::vector<expr::Expression> restore(ComputationGraph& cg) const;
+
+  /**
+   * \brief Number of floats held by the snapshot
+   */
+  size_t size() const { return values.size(); }
+
+  std::vector<Dim> dims; /**< Shape of every state component */
+  std::vector<float> values; /**< Values of all the components, one after the other */
+};
+
+/**
+ * \brief Least recently used cache of RNN states, keyed by session
+ */
+class RNNStateCache {
+ public:
+  /**
+   * \param capacity Maximum number of sessions to keep
+   */
+  explicit RNNStateCache(unsigned capacity);
+
+  /**
+   * \brief Get the state of a session, and mark it as the most recently used
+   *
+   * \return The state, or nullptr if the session is not in the cache. The
+   *         pointer is valid until the session is evicted or replaced.
+   */
+  const RNNStateSnapshot* get(const std::string& session);
+
+  /**
+   * \brief Store or replace the state of a session
+   * \details Evicts the least recently used session if the cache is full.
+   */
+  void put(const std::string& session, RNNStateSnapshot state);
+
+  /**
+   * \brief Drop a session, e.g. when it has ended
+   */
+  void erase(const std::string& session);
+
+  void clear();
+  unsigned size() const { return entries.size(); }
+  unsigned capacity() const { return max_size; }
+
+ private:
+  typedef std::list<std::pair<std::string, RNNStateSnapshot>> EntryList;
+  unsigned max_size;
+  EntryList entries; // most recently used first
+  std::unordered_map<std::string, EntryList::iterator> index;
+};
+
+} // namespace dynet
+
+#endif
@@ -4,6 +4,7 @@
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 
 #include "dynet/nodes.h"
 #include "dynet/expr.h"
@@ -26,6 +27,83 @@ void RNNBuilder::load_parameters_pretraining(const string& fname) {
   throw std::runtime_error("RNNBuilder::load_parameters_pretraining not overridden.");
 }
 
+vector<Expression> RNNBuilder::add_inputs(const Expression& xs) {
+  const unsigned n = xs.dim().cols();
+  vector<Expression> ys = add_sequence_impl(cur, xs);
+  if (ys.size() > 0) {
+    for (unsigned t = 0; t < n; ++t) {
+      sm.transition(RNNOp::add_input);
+      head.push_back(cur);
+      cur = head.size() - 1;
+    }
+    return ys;
+  }
+  ys.resize(n);
+  Expression proj = project_inputs_impl(xs);
+  for (unsigned t = 0; t < n; ++t) {
+    if (proj.pg == nullptr) {
+      ys[t] = add_input(n == 1 ? xs : pick(xs, t, 1));
+    } else {
+      sm.transition(RNNOp::add_input);
+      head.push_back(cur);
+      int rcp = cur;
+      cur = head.size() - 1;
+      ys[t] = add_projected_input_impl(rcp, n == 1 ? proj : pick(proj, t, 1));
+    }
+  }
+  return ys;
+}
+
+vector<Expression> RNNBuilder::add_inputs(const vector<Expression>& xs) {
+  if (xs.size() == 0) return vector<Expression>();
+  return add_inputs(concatenate_cols(xs));
+}
+
+vector<Expression> RNNBuilder::add_packed_inputs(const vector<Expression>& xs) {
+  const unsigned n = xs.size();
+  vector<Expression> ys(n);
+  vector<RNNPointer> steps(n);
+  vector<unsigned> sizes(n);
+  for (unsigned t = 0; t < n; ++t) {
+    sizes[t] = xs[t].dim().bd;
+    if (t > 0 && sizes[t] != sizes[t - 1]) {
+      DYNET_ARG_CHECK(sizes[t] < sizes[t - 1],
+                      "Batch size grows from " << sizes[t - 1] << " to " << sizes[t] << " at timestep " << t << " in add_packed_inputs");
+      // Drop the state of the sequences that have ended
+      vector<unsigned> active(sizes[t]);
+      iota(active.begin(), active.end(), 0);
+      vector<Expression> s = get_s(cur);
+      for (auto & s_i : s)
+        s_i = pick_batch_elems(s_i, active);
+      set_s(cur, s);
+    }
+    ys[t] = add_input(xs[t]);
+    steps[t] = cur;
+  }
+  if (n == 0 || sizes[n - 1] == sizes[0]) return ys;
+  // The sequences in [sizes[t + 1], sizes[t]) end at timestep t; collect their
+  // last states from the last timestep backwards, which is batch order
+  vector<Expression> s_last = get_s(cur);
+  vector<vector<Expression>> parts(s_last.size());
+  for (int t = n - 1; t >= 0; --t) {
+    const unsigned begin = (t + 1 < (int)n ? sizes[t + 1] : 0);
+    if (begin == sizes[t]) continue;
+    vector<unsigned> ended(sizes[t] - begin);
+    iota(ended.begin(), ended.end(), begin);
+    vector<Expression> s = get_s(steps[t]);
+    for (unsigned k = 0; k < s.size(); ++k)
+      parts[k].push_back(begin == 0 ? s[k] : pick_batch_elems(s[k], ended));
+  }
+  for (unsigned k = 0; k < s_last.size(); ++k)
+    s_last[k] = concatenate_to_batch(parts[k]);
+  set_s(cur, s_last);
+  return ys;
+}
+
+Expression RNNBuilder::add_projected_input_impl(int prev, const Expression& x_proj) {
+  DYNET_RUNTIME_ERR("add_projected_input_impl() not implemented by this RNNBuilder");
+}
+
 DYNET_SERIALIZE_COMMIT(RNNBuilder, DYNET_SERIALIZE_DEFINE(cur, head, sm))
 DYNET_SERIALIZE_IMPL(RNNBuilder)
 
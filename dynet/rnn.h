@@ -149,6 +149,50 @@ struct RNNBuilder {
     return add_input_impl(prev, x);
   }
 
+  /**
+   *
+   * \brief Add a whole sequence of timesteps
+   * \details This is equivalent to calling `add_input` on each column of `xs`
+   * in turn, but builders that support it compute the input transformation of
+   * the first layer for all timesteps with a single matrix product, so that
+   * only the recurrent part is left to each step, or run each layer over the
+   * whole sequence as a single node.
+   *
+   * \param xs Input matrix with one column per timestep
+   *
+   * \return The hidden representation of the deepest layer at each timestep
+   */
+  std::vector<Expression> add_inputs(const Expression& xs);
+  /**
+   *
+   * \brief Add a whole sequence of timesteps
+   * \details Same as above, with the inputs given as a sequence of vectors
+   *
+   * \param xs Input variables
+   *
+   * \return The hidden representation of the deepest layer at each timestep
+   */
+  std::vector<Expression> add_inputs(const std::vector<Expression>& xs);
+
+  /**
+   *
+   * \brief Add a packed batch of sequences of different lengths
+   * \details `xs[t]` holds the inputs of timestep `t` for the sequences that
+   * are longer than `t`, so the sequences must be sorted by decreasing length
+   * and the batch size of `xs[t]` can only shrink. Before each step, the state
+   * of the sequences that have ended is dropped, so no computation is spent on
+   * padding.
+   * Afterwards, the current state holds the last state of every sequence, in
+   * batch order, so that `final_h()` and `final_s()` return it and the next
+   * `add_input` continues each sequence from its own end.
+   *
+   * \param xs Input variables
+   *
+   * \return The hidden representation of the deepest layer at each timestep,
+   * for the sequences that are active at that timestep
+   */
+  std::vector<Expression> add_packed_inputs(const std::vector<Expression>& xs);
+
   /**
    *
    * \brief Rewind the last timestep
@@ -278,6 +322,16 @@ protected:
   virtual Expression add_input_impl(int prev, const Expression& x) = 0;
   virtual Expression set_h_impl(int prev, const std::vector<Expression>& h_new) = 0;
   virtual Expression set_s_impl(int prev, const std::vector<Expression>& c_new) = 0;
+  // Builders that can transform the inputs of the first layer for a whole
+  // sequence at once return the result here, one column per timestep, and
+  // then get each column in add_projected_input_impl. An empty expression
+  // means that add_inputs falls back to add_input_impl.
+  virtual Expression project_inputs_impl(const Expression& xs) { return Expression(); }
+  virtual Expression add_projected_input_impl(int prev, const Expression& x_proj);
+  // Builders that can run each layer over the whole sequence as a single node
+  // return the outputs of all timesteps here, after recording their states.
+  // An empty result means that add_inputs runs the sequence step by step.
+  virtual std::vector<Expression> add_sequence_impl(int prev, const Expression& xs) { return std::vector<Expression>(); }
   RNNPointer cur;
   float dropout_rate;
 private:
@@ -0,0 +1,74 @@
+#include "dynet/sampler.h"
+
+#include <algorithm>
+#include <random>
+
+#include "dynet/except.h"
+#include "dynet/globals.h"
+
+using namespace std;
+
+namespace dynet {
+
+AliasSampler::AliasSampler(const vector<float>& weights) : probs(weights) {
+  const unsigned n = weights.size();
+  DYNET_ARG_CHECK(n > 0, "AliasSampler needs at least one weight");
+  double total = 0.0;
+  for (auto w : weights) {
+    DYNET_ARG_CHECK(w >= 0.f, "Negative weight " << w << " in AliasSampler");
+    total += w;
+  }
+  DYNET_ARG_CHECK(total > 0.0, "AliasSampler weights must not all be zero");
+  // Scale so that the average bucket holds exactly 1, then repeatedly top up
+  // an under-full bucket with the excess of an over-full one
+  cutoffs.resize(n);
+  aliases.resize(n);
+  vector<unsigned> small, large;
+  for (unsigned i = 0; i < n; ++i) {
+    probs[i] = weights[i] / total;
+    cutoffs[i] = weights[i] * n / total;
+    aliases[i] = i;
+    (cutoffs[i] < 1.f ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    const unsigned s = small.back(), l = large.back();
+    small.pop_back();
+    aliases[s] = l;
+    cutoffs[l] -= 1.f - cutoffs[s];
+    if (cutoffs[l] < 1.f) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // Whatever is left is only off from 1 by rounding error
+  for (auto i : small) cutoffs[i] = 1.f;
+  for (auto i : large) cutoffs[i] = 1.f;
+}
+
+unsigned AliasSampler::sample() const {
+  DYNET_ASSERT(probs.size() > 0, "Sampling from an empty AliasSampler");
+  uniform_int_distribution<unsigned> bucket(0, probs.size() - 1);
+  uniform_real_distribution<float> coin(0.f, 1.f);
+  const unsigned i = bucket(*rndeng);
+  return coin(*rndeng) < cutoffs[i] ? i : aliases[i];
+}
+
+void AliasSampler::sample_bag(unsigned n, vector<unsigned>& ids, vector<float>& counts) const {
+  vector<unsigned> draws(n);
+  for (auto& d : draws) d = sample();
+  sort(draws.begin(), draws.end());
+  ids.clear();
+  counts.clear();
+  for (unsigned j = 0; j < n; ++j) {
+    if (j == 0 || draws[j] != draws[j-1]) {
+      ids.push_back(draws[j]);
+      counts.push_back(0.f);
+    }
+    counts.back() += 1.f;
+  }
+}
+
+DYNET_SERIALIZE_COMMIT(AliasSampler, DYNET_SERIALIZE_DEFINE(probs, cutoffs, aliases))
+DYNET_SERIALIZE_IMPL(AliasSampler)
+
+} // namespace dynet
@@ -0,0 +1,41 @@
+#ifndef DYNET_SAMPLER_H
+#define DYNET_SAMPLER_H
+
+#include <vector>
+
+#include "dynet/io-macros.h"
+
+namespace dynet {
+
+// Draws from a fixed discrete distribution, such as the unigram distribution
+// of a vocabulary, with Walker's alias method: building the tables takes
+// O(n) time, after which every sample takes O(1) time whatever the size of
+// the distribution. Random numbers come from dynet::rndeng.
+class AliasSampler {
+ public:
+  AliasSampler() {}
+  // weights need not be normalized (e.g. raw counts), but must be >= 0
+  explicit AliasSampler(const std::vector<float>& weights);
+
+  unsigned sample() const;
+
+  // draws n samples with replacement, and returns every distinct value
+  // drawn once, in increasing order, together with the number of times it
+  // was drawn
+  void sample_bag(unsigned n, std::vector<unsigned>& ids, std::vector<float>& counts) const;
+
+  // normalized probability of drawing i
+  float prob(unsigned i) const { return probs[i]; }
+  unsigned size() const { return probs.size(); }
+
+ private:
+  std::vector<float> probs;
+  std::vector<float> cutoffs; // bucket i keeps i with probability cutoffs[i]
+  std::vector<unsigned> aliases; // and yields aliases[i] otherwise
+
+  DYNET_SERIALIZE_DECLARE()
+};
+
+} // namespace dynet
+
+#endif
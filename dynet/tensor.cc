@@ -1,6 +1,8 @@
 #include "dynet/tensor.h"
 #include "dynet/globals.h"
 
+#include <algorithm>
+#include <cmath>
 #include <random>
 #include <vector>
 #include <cstring>
@@ -315,6 +317,39 @@ real rand_normal() {
   return distribution(*rndeng);
 }
 
+// Views a tensor as inner x n x outer, where n is the length of dimension
+// dim, so that the fiber (i, o) along dim starts at i + inner * n * o and
+// has a stride of inner
+static void fiber_layout(const Dim& d, unsigned dim, size_t& inner, size_t& n, size_t& outer) {
+  inner = 1;
+  for (unsigned i = 0; i < dim; ++i) inner *= d[i];
+  n = d[dim];
+  outer = d.size() / (inner * n);
+}
+
+// Keeps the k best (value, index) pairs of a fiber in a heap with the worst
+// of them on top. A value that does not beat it costs one comparison, so
+// this is a single pass over the fiber whatever the value of k.
+static void topk_fiber(const float* x, size_t stride, size_t n, unsigned k,
+                       vector<pair<float, unsigned>>& heap) {
+  auto better = [](const pair<float, unsigned>& a, const pair<float, unsigned>& b) {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+  };
+  heap.clear();
+  for (unsigned j = 0; j < k; ++j)
+    heap.push_back(make_pair(x[j * stride], j));
+  make_heap(heap.begin(), heap.end(), better);
+  for (size_t j = k; j < n; ++j) {
+    const float xj = x[j * stride];
+    if (xj > heap.front().first) {
+      pop_heap(heap.begin(), heap.end(), better);
+      heap.back() = make_pair(xj, (unsigned)j);
+      push_heap(heap.begin(), heap.end(), better);
+    }
+  }
+  sort_heap(heap.begin(), heap.end(), better);
+}
+
 #endif
 
 // ---- CPU/GPU operations
@@ -369,7 +404,7 @@ void TensorTools::clip(Tensor& d, float left, float right) {
 template <class MyDevice>
 IndexTensor TensorTools::argmax_dev(MyDevice & dev, const Tensor& v, unsigned dim, unsigned num) {
   if(num > 1)
-    DYNET_RUNTIME_ERR("Currently do not support num > 1 in argmax");
+    return topk_dev(dev, v, num, dim).second;
   DYNET_ARG_CHECK(v.mem_pool != DeviceMempool::NONE, "Input Tensor to TensorTools::argmax must be associated with a memory pool.");
   Dim ids_dim = v.d; ids_dim.d[dim] = num;
   IndexTensor ids(ids_dim, nullptr, v.device, v.mem_pool);
@@ -397,15 +432,71 @@ IndexTensor TensorTools::argmax(const Tensor& d, unsigned dim, unsigned num) {
 #endif
 #endif
 
+template <class MyDevice>
+pair<Tensor, IndexTensor> TensorTools::topk_dev(MyDevice & dev, const Tensor& v, unsigned k, unsigned dim) {
+  DYNET_ARG_CHECK(v.mem_pool != DeviceMempool::NONE, "Input Tensor to TensorTools::topk must be associated with a memory pool.");
+  DYNET_ARG_CHECK(dim < v.d.nd && k >= 1 && k <= v.d[dim],
+                  "Bad arguments to TensorTools::topk: k=" << k << ", dim=" << dim << " for tensor " << v.d);
+  Dim out_dim = v.d; out_dim.d[dim] = k;
+  AlignedMemoryPool* pool = v.device->pools[(size_t)v.mem_pool];
+  Tensor vals(out_dim, static_cast<float*>(pool->allocate(out_dim.size() * sizeof(float))), v.device, v.mem_pool);
+  IndexTensor ids(out_dim, static_cast<Eigen::DenseIndex*>(pool->allocate(out_dim.size() * sizeof(Eigen::DenseIndex))), v.device, v.mem_pool);
+#ifdef __CUDACC__
+  if (k > 1)
+    DYNET_RUNTIME_ERR("TensorTools::topk with k > 1 not yet implemented for CUDA (contributions welcome!)");
+  Eigen::array<ptrdiff_t, 1> red_axis = {(ptrdiff_t)dim};
+  vals.tb<3>().device(*dev.edevice) = v.tb<4>().maximum(red_axis);
+  ids.tb<3>().device(*dev.edevice) = v.tb<4>().argmax(dim);
+#else
+  size_t inner, n, outer;
+  fiber_layout(v.d, dim, inner, n, outer);
+  vector<pair<float, unsigned>> heap;
+  heap.reserve(k);
+  for (size_t o = 0; o < outer; ++o) {
+    for (size_t i = 0; i < inner; ++i) {
+      topk_fiber(v.v + i + inner * n * o, inner, n, k, heap);
+      const size_t out = i + inner * k * o;
+      for (unsigned j = 0; j < k; ++j) {
+        vals.v[out + j * inner] = heap[j].first;
+        ids.v[out + j * inner] = heap[j].second;
+      }
+    }
+  }
+#endif
+  return make_pair(vals, ids);
+}
+#ifdef __CUDACC__
+template pair<Tensor, IndexTensor> TensorTools::topk_dev<Device_GPU>(Device_GPU & dev, const Tensor& d, unsigned k, unsigned dim);
+#else
+template pair<Tensor, IndexTensor> TensorTools::topk_dev<Device_CPU>(Device_CPU & dev, const Tensor& d, unsigned k, unsigned dim);
+#ifdef HAVE_CUDA
+extern template pair<Tensor, IndexTensor> TensorTools::topk_dev<Device_GPU>(Device_GPU & dev, const Tensor& d, unsigned k, unsigned dim);
+pair<Tensor, IndexTensor> TensorTools::topk(const Tensor& d, unsigned k, unsigned dim) {
+  if (d.device->type == DeviceType::CPU) { return topk_dev(*(Device_CPU*)d.device, d, k, dim); }
+  else if (d.device->type == DeviceType::GPU) { return topk_dev(*(Device_GPU*)d.device, d, k, dim); }
+  else { throw std::runtime_error("Bad device type"); }
+}
+#else
+pair<Tensor, IndexTensor> TensorTools::topk(const Tensor& d, unsigned k, unsigned dim) {
+  if (d.device->type == DeviceType::CPU) { return topk_dev(*(Device_CPU*)d.device, d, k, dim); }
+  else { throw std::runtime_error("Bad device type"); }
+}
+#endif
+#endif
+
 template <class MyDevice>
 IndexTensor TensorTools::categorical_sample_log_prob_dev(MyDevice & dev, const Tensor& v, unsigned dim, unsigned num) {
-  if(num > 1)
-    DYNET_RUNTIME_ERR("Currently do not support num > 1 in categorical_sample_log_prob");
-  DYNET_ARG_CHECK(v.mem_pool != DeviceMempool::NONE, "Input Tensor to TensorTools::argmax must be associated with a memory pool.");
+  DYNET_ARG_CHECK(v.mem_pool != DeviceMempool::NONE, "Input Tensor to TensorTools::categorical_sample_log_prob must be associated with a memory pool.");
+  DYNET_ARG_CHECK(dim < v.d.nd && num >= 1,
+                  "Bad arguments to TensorTools::categorical_sample_log_prob: num=" << num << ", dim=" << dim << " for tensor " << v.d);
   Dim ids_dim = v.d; ids_dim.d[dim] = num;
   IndexTensor ids(ids_dim, nullptr, v.device, v.mem_pool);
   AlignedMemoryPool* pool = v.device->pools[(int)v.mem_pool];
   ids.v = static_cast<Eigen::DenseIndex*>(pool->allocate(ids_dim.size() * sizeof(Eigen::DenseIndex)));
+#ifdef __CUDACC__
+  if(num > 1)
+    DYNET_RUNTIME_ERR("Currently do not support num > 1 in categorical_sample_log_prob");
+  // Gumbel-max trick
   size_t used = pool->used();
   Dim copy_dim = v.d; // TODO: make this match num to enable num
   Tensor copy(copy_dim, nullptr, v.device, v.mem_pool);
@@ -413,6 +504,30 @@ IndexTensor TensorTools::categorical_sample_log_prob_dev(MyDevice & dev, const T
   TensorTools::randomize_uniform(copy);
   ids.tb<3>().device(*dev.edevice) = (v.tb<4>() - (-copy.tb<4>().log()).log()).argmax(dim);
   pool->set_used(used);
+#else
+  // Inverse transform sampling: one exp per element to build the cumulative
+  // distribution of a fiber, then a binary search per sample
+  size_t inner, n, outer;
+  fiber_layout(v.d, dim, inner, n, outer);
+  vector<float> cdf(n);
+  for (size_t o = 0; o < outer; ++o) {
+    for (size_t i = 0; i < inner; ++i) {
+      const float* x = v.v + i + inner * n * o;
+      float m = x[0];
+      for (size_t j = 1; j < n; ++j) m = max(m, x[j * inner]);
+      float total = 0.f;
+      for (size_t j = 0; j < n; ++j) {
+        total += expf(x[j * inner] - m);
+        cdf[j] = total;
+      }
+      const size_t out = i + inner * num * o;
+      for (unsigned s = 0; s < num; ++s) {
+        const size_t j = upper_bound(cdf.begin(), cdf.end(), rand01() * total) - cdf.begin();
+        ids.v[out + s * inner] = min(j, n - 1);
+      }
+    }
+  }
+#endif
   return ids;
 }
 #ifdef __CUDACC__
@@ -8,6 +8,7 @@
 #define DYNET_EIGEN_TENSOR_H
 
 #include <initializer_list>
+#include <utility>
 #include <vector>
 #include <sstream>
 #include <stdexcept>
@@ -29,6 +30,10 @@
 
 #ifndef __CUDACC__
 #include <Eigen/Eigen>
+// Needed for Device_CPU_Threaded
+#ifndef EIGEN_USE_THREADS
+#define EIGEN_USE_THREADS
+#endif
 #endif
 
 #include <unsupported/Eigen/CXX11/Tensor>
@@ -686,12 +691,30 @@ struct TensorTools {
    * \param num The number of kmax values
    *
    * \returns A newly allocated LongTensor consisting of argmax IDs. The length of the
-   *          dimension "dim" will be "num", consisting of the appropriate IDs.
+   *          dimension "dim" will be "num", consisting of the appropriate IDs,
+   *          in decreasing order of their values.
    */
   static IndexTensor argmax(const Tensor& v, unsigned dim = 0, unsigned num = 1);
 
+  /**
+   * \brief Find the k largest values and their indices
+   * \details Every batch element is handled separately. The values come out in
+   *          decreasing order, and ties go to the lower index. On CPU, this takes a
+   *          single pass over the data, whatever the value of k. Both tensors are
+   *          allocated in the memory pool of v.
+   *
+   * \param v Input tensor
+   * \param k The number of values to keep
+   * \param dim Which dimension to select over
+   *
+   * \returns The values and their IDs. The length of the dimension "dim" in both will be "k".
+   */
+  static std::pair<Tensor, IndexTensor> topk(const Tensor& v, unsigned k, unsigned dim = 0);
+
   /**
    * \brief Calculate samples from a log probability
+   * \details The distributions do not need to be normalized. Every batch element is
+   *          handled separately, and samples are drawn with replacement.
    *
    * \param v A tensor where each row represents a log probability distribution
    * \param dim Which dimension to take the sample over
@@ -710,6 +733,8 @@ protected:
   template<class MyDevice>
   static IndexTensor argmax_dev(MyDevice & dev, const Tensor& v, unsigned dim = 0, unsigned num = 1);
   template<class MyDevice>
+  static std::pair<Tensor, IndexTensor> topk_dev(MyDevice & dev, const Tensor& v, unsigned k, unsigned dim = 0);
+  template<class MyDevice>
   static IndexTensor categorical_sample_log_prob_dev(MyDevice & dev, const Tensor& v, unsigned dim = 0, unsigned num = 1);
 
 };
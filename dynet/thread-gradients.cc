@@ -0,0 +1,99 @@
+#include "dynet/thread-gradients.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace dynet {
+
+thread_local ThreadGradients* thread_gradients = nullptr;
+
+void ThreadGradients::accumulate(ParameterStorage* p, const Tensor& g) {
+  auto it = grads.find(p);
+  if (it == grads.end()) {
+    Tensor buf(p->dim, nullptr, device, DeviceMempool::PS);
+    device->allocate_tensor(DeviceMempool::PS, buf);
+    TensorTools::zero(buf);
+    it = grads.insert(make_pair(p, buf)).first;
+  }
+  it->second.vec() += g.vec();
+  non_zero_params.insert(p);
+}
+
+Tensor& ThreadGradients::lookup_buffer(LookupParameterStorage* p, unsigned index) {
+  auto & rows = lookup_grads[p];
+  auto it = rows.find(index);
+  if (it == rows.end()) {
+    Tensor buf(p->dim, nullptr, device, DeviceMempool::PS);
+    device->allocate_tensor(DeviceMempool::PS, buf);
+    TensorTools::zero(buf);
+    it = rows.insert(make_pair(index, buf)).first;
+  }
+  non_zero_grads[p].insert(index);
+  return it->second;
+}
+
+void ThreadGradients::accumulate(LookupParameterStorage* p, const Tensor& g) {
+  const unsigned n = p->values.size();
+  vector<unsigned> ids(n);
+  for (unsigned i = 0; i < n; ++i) ids[i] = i;
+  accumulate(p, n, &ids[0], g.v);
+}
+
+void ThreadGradients::accumulate(LookupParameterStorage* p, unsigned index, const Tensor& g) {
+  lookup_buffer(p, index).vec() += g.vec();
+}
+
+void ThreadGradients::accumulate(LookupParameterStorage* p, unsigned n, const unsigned* ids, const float* g) {
+  const size_t gsize = p->dim.size();
+  for (unsigned i = 0; i < n; ++i) {
+    Tensor gt(p->dim, const_cast<float*>(g) + i * gsize, device, DeviceMempool::NONE);
+    lookup_buffer(p, ids[i]).vec() += gt.vec();
+  }
+}
+
+void ThreadGradients::add(const ThreadGradients& other) {
+  for (auto p : other.non_zero_params)
+    accumulate(p, other.grads.find(p)->second);
+  for (auto & kv : other.non_zero_grads) {
+    const auto & rows = other.lookup_grads.find(kv.first)->second;
+    for (auto i : kv.second)
+      accumulate(kv.first, i, rows.find(i)->second);
+  }
+}
+
+void ThreadGradients::accumulate_into_model() const {
+  for (auto p : non_zero_params)
+    p->accumulate_grad(grads.find(p)->second);
+  for (auto & kv : non_zero_grads) {
+    const auto & rows = lookup_grads.find(kv.first)->second;
+    for (auto i : kv.second)
+      kv.first->accumulate_grad(i, rows.find(i)->second);
+  }
+}
+
+float ThreadGradients::squared_l2norm() const {
+  float sqnorm = 0.f;
+  for (auto p : non_zero_params)
+    sqnorm += grads.find(p)->second.vec().squaredNorm();
+  for (auto & kv : non_zero_grads) {
+    const auto & rows = lookup_grads.find(kv.first)->second;
+    for (auto i : kv.second)
+      sqnorm += rows.find(i)->second.vec().squaredNorm();
+  }
+  return sqnorm;
+}
+
+void ThreadGradients::clear() {
+  for (auto p : non_zero_params)
+    TensorTools::zero(grads[p]);
+  for (auto & kv : non_zero_grads) {
+    auto & rows = lookup_grads[kv.first];
+    for (auto i : kv.second)
+      TensorTools::zero(rows[i]);
+  }
+  non_zero_params.clear();
+  non_zero_grads.clear();
+}
+
+} // namespace dynet
@@ -0,0 +1,53 @@
+#ifndef DYNET_THREAD_GRADIENTS_H_
+#define DYNET_THREAD_GRADIENTS_H_
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "dynet/devices.h"
+#include "dynet/model.h"
+#include "dynet/tensor.h"
+
+namespace dynet {
+
+/**
+ * \brief Gradients accumulated privately by one thread
+ * \details While bound to a thread (see `thread_gradients`), parameter nodes
+ *          accumulate here instead of into the gradients held by the Model.
+ *          Buffers are allocated lazily from the PS pool of `device`: one per
+ *          dense parameter and one per lookup row that was touched.
+ */
+struct ThreadGradients {
+  explicit ThreadGradients(Device* device) : device(device) {}
+  void accumulate(ParameterStorage* p, const Tensor& g);
+  void accumulate(LookupParameterStorage* p, const Tensor& g);
+  void accumulate(LookupParameterStorage* p, unsigned index, const Tensor& g);
+  void accumulate(LookupParameterStorage* p, unsigned n, const unsigned* ids, const float* g);
+  /**
+   * \brief Add the gradients held by another buffer to this one
+   */
+  void add(const ThreadGradients& other);
+  /**
+   * \brief Add these gradients to the gradients held by the parameters
+   * \details Afterwards the Model looks as if backward() had been called
+   *          without any buffer bound, so any Trainer can apply the update.
+   */
+  void accumulate_into_model() const;
+  float squared_l2norm() const;
+  void clear();
+
+  Device* device;
+  std::unordered_map<ParameterStorage*, Tensor> grads;
+  std::unordered_map<LookupParameterStorage*, std::unordered_map<unsigned, Tensor> > lookup_grads;
+  std::unordered_set<ParameterStorage*> non_zero_params;
+  std::unordered_map<LookupParameterStorage*, std::unordered_set<unsigned> > non_zero_grads;
+ private:
+  Tensor& lookup_buffer(LookupParameterStorage* p, unsigned index);
+};
+
+// gradients of the worker bound to the calling thread, or null
+extern thread_local ThreadGradients* thread_gradients;
+
+} // namespace dynet
+
+#endif
@@ -19,16 +19,24 @@
 #define DYNET_TRAINER_INST_DEV_IMPL(MyTrainer) \
   extern template void MyTrainer::update_rule_dev<Device_GPU>(const Device_GPU & dev, real scale, real gscale, const std::vector<Tensor*> & values); \
   template void MyTrainer::update_rule_dev<Device_CPU>(const Device_CPU & dev, real scale, real gscale, const std::vector<Tensor*> & values); \
+  template void MyTrainer::update_rule_dev<Device_CPU_Threaded>(const Device_CPU_Threaded & dev, real scale, real gscale, const std::vector<Tensor*> & values); \
   void MyTrainer::update_rule(real scale, real gscale, const std::vector<Tensor*> & values) { \
-    if(default_device->type == DeviceType::CPU) { update_rule_dev(*(Device_CPU*)default_device,scale,gscale,values); } \
+    if(default_device->type == DeviceType::CPU) { \
+      if(((Device_CPU*)default_device)->num_threads > 1) { update_rule_dev(*(Device_CPU_Threaded*)default_device,scale,gscale,values); } \
+      else { update_rule_dev(*(Device_CPU*)default_device,scale,gscale,values); } \
+    } \
     else if(default_device->type == DeviceType::GPU) { update_rule_dev(*(Device_GPU*)default_device,scale,gscale,values); } \
     else { throw std::runtime_error("Bad device in MyTrainer::update_rule"); } \
   }
 #else
 #define DYNET_TRAINER_INST_DEV_IMPL(MyTrainer) \
   template void MyTrainer::update_rule_dev<Device_CPU>(const Device_CPU & dev, real scale, real gscale, const std::vector<Tensor*> & values); \
+  template void MyTrainer::update_rule_dev<Device_CPU_Threaded>(const Device_CPU_Threaded & dev, real scale, real gscale, const std::vector<Tensor*> & values); \
   void MyTrainer::update_rule(real scale, real gscale, const std::vector<Tensor*> & values) { \
-    if(default_device->type == DeviceType::CPU) { update_rule_dev(*(Device_CPU*)default_device,scale,gscale,values); } \
+    if(default_device->type == DeviceType::CPU) { \
+      if(((Device_CPU*)default_device)->num_threads > 1) { update_rule_dev(*(Device_CPU_Threaded*)default_device,scale,gscale,values); } \
+      else { update_rule_dev(*(Device_CPU*)default_device,scale,gscale,values); } \
+    } \
     else { throw std::runtime_error("Bad device in MyTrainer::update_rule"); } \
   }
 #endif
@@ -1,4 +1,5 @@
 #include <dynet/dynet.h>
+#include <dynet/sampler.h>
 #define BOOST_TEST_MODULE DYNETBasicTest
 #include <boost/test/unit_test.hpp>
 
@@ -31,3 +32,17 @@ BOOST_AUTO_TEST_CASE( aligned_allocator ) {
   a.free(mem);
 }
 
+BOOST_AUTO_TEST_CASE( alias_sampler ) {
+  dynet::AliasSampler s({2.f, 0.f, 5.f, 1.f});
+  BOOST_CHECK_CLOSE(s.prob(2), 0.625f, 1e-3);
+  std::vector<unsigned> ids;
+  std::vector<float> counts;
+  s.sample_bag(8000, ids, counts);
+  BOOST_REQUIRE_EQUAL(ids.size(), 3);
+  BOOST_CHECK_EQUAL(ids[0], 0);
+  BOOST_CHECK_EQUAL(ids[1], 2);
+  BOOST_CHECK_EQUAL(ids[2], 3);
+  BOOST_CHECK_CLOSE(counts[0], 2000.f, 10);
+  BOOST_CHECK_CLOSE(counts[1], 5000.f, 10);
+  BOOST_CHECK_CLOSE(counts[2], 1000.f, 10);
+}
@@ -5,6 +5,7 @@
 #include <dynet/rnn.h>
 #include <dynet/lstm.h>
 #include <dynet/gru.h>
+#include <dynet/cfsm-builder.h>
 #include <boost/test/unit_test.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
@@ -104,5 +105,51 @@ BOOST_AUTO_TEST_CASE( lstm_io ) {
     BOOST_CHECK(rnn2.hid == 10);
 }
 
+// Saves a sampled output layer through a base class pointer, and checks that
+// the loaded one computes the same losses, samples included
+template <class Builder>
+void check_sampled_softmax_io(const std::string& filename) {
+    dynet::Model mod1;
+    SoftmaxBuilder* sm1 = new Builder(3, {1.f, 5.f, 2.f, 0.f, 8.f, 4.f}, 4, mod1);
+    std::ofstream out(filename);
+    boost::archive::text_oarchive oa(out);
+    oa << mod1 << sm1;
+    out.close();
+
+    dynet::Model mod2;
+    SoftmaxBuilder* sm2 = nullptr;
+    ifstream in(filename);
+    boost::archive::text_iarchive ia(in);
+    ia >> mod2 >> sm2;
+    in.close();
+    BOOST_REQUIRE(dynamic_cast<Builder*>(sm2) != nullptr);
+
+    vector<float> losses[2], dists[2];
+    SoftmaxBuilder* sms[2] = {sm1, sm2};
+    for (unsigned k = 0; k < 2; ++k) {
+        ComputationGraph cg;
+        sms[k]->new_graph(cg);
+        Expression rep = input(cg, Dim({3}, 2), {0.1f, -0.5f, 0.3f, 0.7f, 0.2f, -0.4f});
+        rndeng->seed(3);
+        losses[k] = as_vector(sms[k]->neg_log_softmax(rep, vector<unsigned>({4, 1})).value());
+        dists[k] = as_vector(sms[k]->full_log_distribution(rep).value());
+    }
+    BOOST_CHECK_EQUAL(losses[0].size(), 2);
+    BOOST_CHECK_EQUAL(dists[0].size(), 12);
+    for (unsigned i = 0; i < losses[0].size(); ++i)
+        BOOST_CHECK_CLOSE(losses[0][i], losses[1][i], 1e-3);
+    for (unsigned i = 0; i < dists[0].size(); ++i)
+        BOOST_CHECK_CLOSE(dists[0][i], dists[1][i], 1e-3);
+    delete sm1;
+    delete sm2;
+}
+
+BOOST_AUTO_TEST_CASE( sampled_softmax_io ) {
+    check_sampled_softmax_io<SampledSoftmaxBuilder>(filename);
+}
+
+BOOST_AUTO_TEST_CASE( nce_softmax_io ) {
+    check_sampled_softmax_io<NCESoftmaxBuilder>(filename);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
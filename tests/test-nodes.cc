@@ -5,6 +5,8 @@
 #include <dynet/expr.h>
 #include <dynet/grad-check.h>
 #include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <functional>
 #include <stdexcept>
 
 using namespace dynet;
@@ -28,6 +30,7 @@ struct NodeTest {
     first_one_vals = {1.f, 0.f, 0.f};
     ones2_vals = {1.f, 1.f};
     batch_vals = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f};
+    matrix_batch_vals = {.5f, -.2f, .1f, -.4f, .3f, .6f, .2f, .1f, -.3f, .7f, -.1f, .4f};
     // Create parameters
     std::vector<float> param1_vals = {1.1f, -2.2f, 3.3f};
     std::vector<float> param2_vals = {2.2f, 3.4f, -1.2f};
@@ -80,7 +83,31 @@ struct NodeTest {
     return oss.str();
   }
 
-  std::vector<float> ones3_vals, ones2_vals, first_one_vals, batch_vals;
+  // Whether f gives the same values for an input of dimension d holding vals
+  // as for each of its batch elements separately
+  bool check_batched(const Dim& d, const std::vector<float>& vals,
+                     std::function<Expression(ComputationGraph&, const Expression&)> f) {
+    dynet::ComputationGraph cg;
+    Expression x = input(cg, d, vals);
+    std::vector<float> batched = as_vector(f(cg, x).value()), looped;
+    for (unsigned b = 0; b < d.bd; ++b) {
+      std::vector<float> y = as_vector(f(cg, pick_batch_elem(x, b)).value());
+      looped.insert(looped.end(), y.begin(), y.end());
+    }
+    if (batched.size() != looped.size()) {
+      BOOST_TEST_MESSAGE("Batched size " << batched.size() << " != looped size " << looped.size());
+      return false;
+    }
+    for (size_t i = 0; i < batched.size(); ++i) {
+      if (batched[i] != looped[i] && std::fabs(batched[i] - looped[i]) > 1e-5f * std::max(1.f, std::fabs(looped[i]))) {
+        BOOST_TEST_MESSAGE("Batched " << print_vec(batched) << " != looped " << print_vec(looped));
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<float> ones3_vals, ones2_vals, first_one_vals, batch_vals, matrix_batch_vals;
   std::vector<char*> av;
   dynet::Model mod;
   dynet::Parameter param1, param2, param3, param4, param_scalar1, param_scalar2, param_kernel1, param_filter1, param_square1, param_cube1;
@@ -371,6 +398,26 @@ BOOST_AUTO_TEST_CASE( affine_batch3_gradient ) {
   BOOST_CHECK(check_grad(mod, z, 0));
 }
 
+// Expression operator*(const Expression& x, const Expression& y);
+BOOST_AUTO_TEST_CASE( multiply_batch_both_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression w = parameter(cg, param_kernel1) + input(cg, Dim({3, 2}, 2), {1.f, 2.f, 3.f, 4.f, 5.f, 6.f, -1.f, -2.f, -3.f, -4.f, -5.f, -6.f});
+  Expression x = parameter(cg, param1) + input(cg, Dim({3}, 2), batch_vals);
+  Expression y = transpose(w) * x;
+  Expression z = sum_batches(sum_elems(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression affine_transform(const std::initializer_list<Expression>& xs);
+BOOST_AUTO_TEST_CASE( affine_batch_both_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression w = parameter(cg, param_square1) + input(cg, Dim({3, 3}, 2), {.1f, .2f, .3f, .4f, .5f, .6f, .7f, .8f, .9f, -.1f, -.2f, -.3f, -.4f, -.5f, -.6f, -.7f, -.8f, -.9f});
+  Expression x = parameter(cg, param1) + input(cg, Dim({3}, 2), batch_vals);
+  Expression y = tanh(affine_transform({parameter(cg, param2), w, x}));
+  Expression z = sum_batches(sum_elems(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
 // Expression operator*(const Expression& x, float y);
 BOOST_AUTO_TEST_CASE( multiplyscalar_gradient ) {
   dynet::ComputationGraph cg;
@@ -1124,6 +1171,26 @@ BOOST_AUTO_TEST_CASE( filter1d_narrow_gradient ) {
   BOOST_CHECK(check_grad(mod, z, 0));
 }
 
+// Expression filter1d_narrow(const Expression& x, const Expression& f);
+BOOST_AUTO_TEST_CASE( filter1d_narrow_batch ) {
+  vector<float> x_batch_vals(27), filter_batch_vals(24);
+  for (unsigned i = 0; i < x_batch_vals.size(); ++i)
+    x_batch_vals[i] = 0.1f * ((i * 7) % 11) - 0.5f;
+  for (unsigned i = 0; i < filter_batch_vals.size(); ++i)
+    filter_batch_vals[i] = 0.2f * ((i * 5) % 9) - 0.8f;
+  BOOST_CHECK(check_batched(Dim({3, 3}, 3), x_batch_vals, [this](ComputationGraph& cg, const Expression& x) {
+    return filter1d_narrow(x, parameter(cg, param_filter1));
+  }));
+  dynet::ComputationGraph cg;
+  Expression xsquare = parameter(cg, param_square1);
+  Expression xfilter = parameter(cg, param_filter1);
+  Expression x = xsquare + input(cg, Dim({3, 3}, 3), x_batch_vals);
+  Expression f = xfilter + input(cg, Dim({3, 2, 2}, 2), filter_batch_vals);
+  Expression z = sum_batches(sum_elems(filter1d_narrow(x, xfilter))) +
+                 sum_batches(sum_elems(filter1d_narrow(xsquare, f)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
 // Expression kmax_pooling(const Expression& x, unsigned k);
 BOOST_AUTO_TEST_CASE( kmax_pooling_keq1_gradient ) {
   dynet::ComputationGraph cg;
@@ -1142,6 +1209,51 @@ BOOST_AUTO_TEST_CASE( kmax_pooling_keq2_gradient ) {
   BOOST_CHECK(check_grad(mod, z, 0));
 }
 
+// Expression kmax_pooling(const Expression& x, unsigned k, unsigned d = 1);
+BOOST_AUTO_TEST_CASE( kmax_pooling_value ) {
+  // Ties are broken in favor of the earlier element
+  const unsigned dims[3] = {3, 4, 2}, k = 2, bd = 2;
+  vector<float> x_vals(3 * 4 * 2 * bd);
+  for (unsigned i = 0; i < x_vals.size(); ++i) x_vals[i] = (float)((i * 7) % 5);
+  for (unsigned d = 0; d < 3; ++d) {
+    dynet::ComputationGraph cg;
+    Expression x = input(cg, Dim({dims[0], dims[1], dims[2]}, bd), x_vals);
+    vector<float> y_vals = as_vector(kmax_pooling(x, k, d).value());
+    BOOST_REQUIRE_EQUAL(y_vals.size(), x_vals.size() / dims[d] * k);
+    unsigned inner = 1, n = dims[d];
+    for (unsigned e = 0; e < d; ++e) inner *= dims[e];
+    const unsigned outer = x_vals.size() / (inner * n);
+    for (unsigned o = 0; o < outer; ++o) {
+      for (unsigned i = 0; i < inner; ++i) {
+        unsigned t = 0;
+        for (unsigned l = 0; l < n; ++l) {
+          const float v = x_vals[i + inner * (l + n * o)];
+          unsigned rank = 0;
+          for (unsigned m = 0; m < n; ++m) {
+            const float w = x_vals[i + inner * (m + n * o)];
+            if (w > v || (w == v && m < l)) ++rank;
+          }
+          if (rank < k)
+            BOOST_CHECK_EQUAL(y_vals[i + inner * (t++ + k * o)], v);
+        }
+      }
+    }
+  }
+}
+
+// Expression kmax_pooling(const Expression& x, unsigned k, unsigned d = 1);
+BOOST_AUTO_TEST_CASE( kmax_pooling_batch ) {
+  for (unsigned d = 0; d < 2; ++d) {
+    BOOST_CHECK(check_batched(Dim({3, 2}, 2), matrix_batch_vals, [d](ComputationGraph& cg, const Expression& x) {
+      return kmax_pooling(x, 2, d);
+    }));
+  }
+  dynet::ComputationGraph cg;
+  Expression x = parameter(cg, param_kernel1) + input(cg, Dim({3, 2}, 2), matrix_batch_vals);
+  Expression z = sum_batches(squared_norm(kmax_pooling(x, 2, 0)) + squared_norm(kmax_pooling(x, 1, 1)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
 // Expression fold_rows(const Expression& x, unsigned nrows=2);
 BOOST_AUTO_TEST_CASE( fold_rows_gradient ) {
   dynet::ComputationGraph cg;
@@ -1208,6 +1320,75 @@ BOOST_AUTO_TEST_CASE( conv2d_same_gradient ) {
   BOOST_CHECK(check_grad(mod, z, 0));
 }
 
+BOOST_AUTO_TEST_CASE( conv2d_pointwise_gradient ) {
+  dynet::ComputationGraph cg;
+  Parameter param_kernel = mod.add_parameters({1, 1, 3, 2});
+  Parameter param_bias = mod.add_parameters({2});
+  std::vector<float> conv2d_batch_vals(3 * 3 * 3 * 2);
+  for (unsigned i = 0; i < conv2d_batch_vals.size(); ++i) {
+    conv2d_batch_vals[i] = i * 0.011f - 0.2f;
+  }
+  Expression x = parameter(cg, param_cube1) + input(cg, Dim({3, 3, 3}, 2), conv2d_batch_vals);
+  Expression kernel = parameter(cg, param_kernel);
+  Expression bias = parameter(cg, param_bias);
+  vector<unsigned> stride = {1, 1};
+  Expression y = conv2d(x, kernel, bias, stride);
+  Expression z = sum_batches(squared_norm(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+BOOST_AUTO_TEST_CASE( conv2d_bias_gradient ) {
+  dynet::ComputationGraph cg;
+  Parameter param_kernel = mod.add_parameters({2, 3, 3, 2});
+  Parameter param_bias = mod.add_parameters({2});
+  std::vector<float> conv2d_batch_vals(3 * 3 * 3 * 2);
+  for (unsigned i = 0; i < conv2d_batch_vals.size(); ++i) {
+    conv2d_batch_vals[i] = i * 0.011f - 0.2f;
+  }
+  Expression x = parameter(cg, param_cube1) + input(cg, Dim({3, 3, 3}, 2), conv2d_batch_vals);
+  Expression kernel = parameter(cg, param_kernel);
+  Expression bias = parameter(cg, param_bias);
+  vector<unsigned> stride = {2, 1}; bool is_valid = false;
+  Expression y = conv2d(x, kernel, bias, stride, is_valid);
+  Expression z = sum_batches(squared_norm(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression conv2d(const Expression& x, const Expression& f, const Expression& b, const std::vector<unsigned>& stride, bool is_valid = true);
+BOOST_AUTO_TEST_CASE( conv2d_value ) {
+  const int H = 5, W = 6, C = 3, KH = 3, KW = 2, F = 4, N = 2;
+  vector<float> x_vals(H * W * C * N), f_vals(KH * KW * C * F), b_vals(F);
+  for (unsigned i = 0; i < x_vals.size(); ++i) x_vals[i] = 0.1f * ((i * 7) % 13) - 0.6f;
+  for (unsigned i = 0; i < f_vals.size(); ++i) f_vals[i] = 0.05f * ((i * 5) % 11) - 0.25f;
+  for (unsigned i = 0; i < b_vals.size(); ++i) b_vals[i] = 0.3f * i - 0.4f;
+  const vector<vector<unsigned>> strides = {{1, 1}, {2, 1}, {2, 3}, {1, 2}};
+  for (auto& stride : strides) {
+    for (bool is_valid : {true, false}) {
+      dynet::ComputationGraph cg;
+      Expression x = input(cg, Dim({H, W, C}, N), x_vals);
+      Expression f = input(cg, {KH, KW, C, F}, f_vals);
+      Expression b = input(cg, {F}, b_vals);
+      Expression y = conv2d(x, f, b, stride, is_valid);
+      const int OH = y.dim()[0], OW = y.dim()[1];
+      // Same padding puts the extra row or column, if any, at the end
+      const int pt = is_valid ? 0 : std::max(0, ((OH - 1) * (int)stride[0] + KH - H) / 2);
+      const int pl = is_valid ? 0 : std::max(0, ((OW - 1) * (int)stride[1] + KW - W) / 2);
+      vector<float> y_vals = as_vector(y.value());
+      BOOST_REQUIRE_EQUAL(y_vals.size(), (size_t)(OH * OW * F * N));
+      for (int n = 0; n < N; ++n) for (int k = 0; k < F; ++k)
+      for (int ow = 0; ow < OW; ++ow) for (int oh = 0; oh < OH; ++oh) {
+        float expected = b_vals[k];
+        for (int c = 0; c < C; ++c) for (int kw = 0; kw < KW; ++kw) for (int kh = 0; kh < KH; ++kh) {
+          const int h = oh * stride[0] + kh - pt, w = ow * stride[1] + kw - pl;
+          if (h >= 0 && h < H && w >= 0 && w < W)
+            expected += x_vals[h + H * (w + W * (c + C * n))] * f_vals[kh + KH * (kw + KW * (c + C * k))];
+        }
+        BOOST_CHECK_SMALL(y_vals[oh + OH * (ow + OW * (k + F * n))] - expected, 1e-4f);
+      }
+    }
+  }
+}
+
 // TODO: These are all unimplemented
 // Expression kmh_ngram(const Expression& x, unsigned n);
 
@@ -1595,4 +1776,359 @@ BOOST_AUTO_TEST_CASE( sanity_test ) {
   BOOST_CHECK_THROW(x.value() , std::runtime_error);
 }
 
+// Expression lstm_cell(const Expression& gates, const Expression& c_tm1, bool coupled, bool output_gate, float forget_bias);
+BOOST_AUTO_TEST_CASE( lstm_cell_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression a = concatenate({parameter(cg, param1), parameter(cg, param2), parameter(cg, param3), parameter(cg, param1)});
+  Expression gates = a + input(cg, Dim({12}, 2), {.1f, -.2f, .3f, -.4f, .5f, -.6f, .7f, -.8f, .9f, -1.f, 1.1f, -1.2f,
+                                                  .5f, .4f, .3f, .2f, .1f, 0.f, -.1f, -.2f, -.3f, -.4f, -.5f, -.6f});
+  Expression y = lstm_cell(gates, parameter(cg, param3), false, true, 1.f);
+  Expression z = sum_batches(squared_norm(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression lstm_cell(const Expression& gates, const Expression& c_tm1, bool coupled, bool output_gate, float forget_bias);
+BOOST_AUTO_TEST_CASE( lstm_cell_coupled_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression gates = concatenate({parameter(cg, param1), parameter(cg, param2)});
+  Expression c_tm1 = parameter(cg, param3) + input(cg, Dim({3}, 2), batch_vals);
+  Expression y = lstm_cell(gates, c_tm1, true, false);
+  Expression z = sum_batches(squared_norm(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression lstm_cell(const Expression& gates, const Expression& c_tm1, const Expression& p_i, const Expression& p_o, bool coupled, float forget_bias);
+BOOST_AUTO_TEST_CASE( lstm_cell_peephole_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression gates = concatenate({parameter(cg, param1), parameter(cg, param2), parameter(cg, param3)});
+  Expression c_tm1 = parameter(cg, param3) + input(cg, Dim({3}, 2), {-1.f, -2.f, -3.f, -1.f, -1.5f, -2.5f});
+  Expression y = lstm_cell(gates, c_tm1, parameter(cg, param2), parameter(cg, param1), true);
+  Expression z = sum_batches(squared_norm(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression gru_cell(const Expression& gates, const Expression& h_tm1, const Expression& u_z, const Expression& u_r, const Expression& u_h);
+BOOST_AUTO_TEST_CASE( gru_cell_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression gates = concatenate({parameter(cg, param1), parameter(cg, param2), parameter(cg, param3)}) * 0.1f;
+  Expression h_tm1 = input(cg, Dim({3}, 2), {.5f, -.2f, .1f, -.4f, .3f, .6f});
+  Expression u = parameter(cg, param_square1) * 0.1f;
+  Expression y = gru_cell(gates, h_tm1, u, transpose(u), u * -0.5f);
+  Expression z = sum_batches(squared_norm(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression gru_cell(const Expression& gates);
+BOOST_AUTO_TEST_CASE( gru_cell_first_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression gates = concatenate({parameter(cg, param1), parameter(cg, param2), parameter(cg, param3)});
+  Expression y = gru_cell(gates);
+  Expression z = squared_norm(y);
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression lstm_sequence(const Expression& xs, const Expression& w_x, const Expression& w_h, const Expression& b, float forget_bias = 0.f);
+BOOST_AUTO_TEST_CASE( lstm_sequence_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression w = parameter(cg, param_square1) * 0.1f;
+  Expression w_x = concatenate({w, transpose(w), w * -0.5f, w * 2.f});
+  Expression w_h = concatenate({transpose(w), w * 0.5f, w, transpose(w) * -1.f});
+  Expression b = concatenate({parameter(cg, param1), parameter(cg, param2), parameter(cg, param3), parameter(cg, param1)}) * 0.1f;
+  Expression xs = input(cg, Dim({3, 2}, 2), {.5f, -.2f, .1f, -.4f, .3f, .6f, .2f, .1f, -.3f, .7f, -.1f, .4f});
+  Expression y = lstm_sequence(xs, w_x, w_h, b, 1.f);
+  Expression z = sum_batches(squared_norm(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression lstm_sequence(const Expression& xs, const Expression& w_x, const Expression& w_h, const Expression& b, const Expression& h_0, const Expression& c_0, float forget_bias = 0.f);
+BOOST_AUTO_TEST_CASE( lstm_sequence_initial_state_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression w = parameter(cg, param_square1) * 0.1f;
+  Expression w_x = concatenate({w, transpose(w), w * -0.5f, w * 2.f});
+  Expression w_h = concatenate({transpose(w), w * 0.5f, w, transpose(w) * -1.f});
+  Expression b = concatenate({parameter(cg, param1), parameter(cg, param2), parameter(cg, param3), parameter(cg, param1)}) * 0.1f;
+  Expression xs = reshape(parameter(cg, param4), Dim({3, 2})) * 0.1f;
+  Expression h_0 = input(cg, Dim({3}, 2), {.5f, -.2f, .1f, -.4f, .3f, .6f});
+  Expression c_0 = parameter(cg, param3) * 0.1f;
+  Expression y = lstm_sequence(xs, w_x, w_h, b, h_0, c_0);
+  Expression z = sum_batches(squared_norm(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression gru_sequence(const Expression& xs, const Expression& w_x, const Expression& b, const Expression& u_zr, const Expression& u_h, const Expression& h_0);
+BOOST_AUTO_TEST_CASE( gru_sequence_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression w = parameter(cg, param_square1) * 0.1f;
+  Expression w_x = concatenate({w, transpose(w), w * -0.5f});
+  Expression b = concatenate({parameter(cg, param1), parameter(cg, param2), parameter(cg, param3)}) * 0.1f;
+  Expression xs = input(cg, Dim({3, 2}, 2), {.5f, -.2f, .1f, -.4f, .3f, .6f, .2f, .1f, -.3f, .7f, -.1f, .4f});
+  Expression h_0 = parameter(cg, param2) * 0.1f;
+  Expression y = gru_sequence(xs, w_x, b, concatenate({transpose(w), w * 0.5f}), w * -1.f, h_0);
+  Expression z = sum_batches(squared_norm(y));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression affine_pickneglogsoftmax(const Expression& b, const Expression& w, const Expression& x, const std::vector<unsigned> & v, unsigned tile_size = 1024);
+BOOST_AUTO_TEST_CASE( affine_pickneglogsoftmax_forward ) {
+  vector<unsigned> ids = {2, 0};
+  dynet::ComputationGraph cg;
+  Expression b = parameter(cg, param1);
+  Expression w = parameter(cg, param_square1);
+  Expression x = input(cg, Dim({3}, 2), matrix_batch_vals);
+  vector<float> expected = as_vector(pickneglogsoftmax(affine_transform({b, w, x}), ids).value());
+  for (unsigned tile_size : {1u, 2u, 1024u}) {
+    vector<float> fused = as_vector(affine_pickneglogsoftmax(b, w, x, ids, tile_size).value());
+    BOOST_REQUIRE_EQUAL(fused.size(), expected.size());
+    for (size_t i = 0; i < fused.size(); ++i)
+      BOOST_CHECK_CLOSE(fused[i], expected[i], 1e-3);
+  }
+}
+
+// Expression affine_pickneglogsoftmax(const Expression& b, const Expression& w, const Expression& x, unsigned v, unsigned tile_size = 1024);
+BOOST_AUTO_TEST_CASE( affine_pickneglogsoftmax_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression b = parameter(cg, param1);
+  Expression w = parameter(cg, param_square1) * 0.5f;
+  Expression y = affine_pickneglogsoftmax(b, w, parameter(cg, param2), 1u, 2);
+  BOOST_CHECK(check_grad(mod, y, 0));
+}
+
+// Expression affine_pickneglogsoftmax(const Expression& b, const Expression& w, const Expression& x, const std::vector<unsigned> & v, unsigned tile_size = 1024);
+BOOST_AUTO_TEST_CASE( affine_pickneglogsoftmax_batch_gradient ) {
+  vector<unsigned> ids = {2, 0};
+  dynet::ComputationGraph cg;
+  Expression b = parameter(cg, param1);
+  Expression w = parameter(cg, param_square1) * 0.5f;
+  Expression x = parameter(cg, param2) * 0.5f + input(cg, Dim({3}, 2), matrix_batch_vals);
+  Expression z = sum_batches(square(affine_pickneglogsoftmax(b, w, x, ids, 2)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression scaled_dot_product_attention(const Expression& q, const Expression& k, const Expression& v, const Expression& mask, unsigned tile_size = 256);
+BOOST_AUTO_TEST_CASE( scaled_dot_product_attention_forward ) {
+  const unsigned d = 3, m = 5, dv = 2, n = 4, bd = 2;
+  vector<float> q_vals(d * n * bd), k_vals(d * m * bd), v_vals(dv * m), mask_vals(m * n);
+  for (unsigned i = 0; i < q_vals.size(); ++i) q_vals[i] = 0.3f * ((i * 7) % 11) - 1.5f;
+  for (unsigned i = 0; i < k_vals.size(); ++i) k_vals[i] = 0.4f * ((i * 5) % 9) - 1.6f;
+  for (unsigned i = 0; i < v_vals.size(); ++i) v_vals[i] = 0.5f * ((i * 3) % 7) - 1.f;
+  for (unsigned i = 0; i < mask_vals.size(); ++i) mask_vals[i] = (i % 3 == 1) ? -1e9f : 0.f;
+  // Reference: the softmax of each column computed directly
+  vector<float> expected(dv * n * bd, 0.f);
+  for (unsigned b = 0; b < bd; ++b) {
+    for (unsigned j = 0; j < n; ++j) {
+      vector<float> p(m);
+      float z = 0.f, mx = -1e30f;
+      for (unsigned l = 0; l < m; ++l) {
+        p[l] = mask_vals[l + m * j];
+        for (unsigned r = 0; r < d; ++r)
+          p[l] += q_vals[r + d * (j + n * b)] * k_vals[r + d * (l + m * b)] / std::sqrt((float)d);
+        mx = std::max(mx, p[l]);
+      }
+      for (unsigned l = 0; l < m; ++l) z += (p[l] = std::exp(p[l] - mx));
+      for (unsigned l = 0; l < m; ++l)
+        for (unsigned c = 0; c < dv; ++c)
+          expected[c + dv * (j + n * b)] += v_vals[c + dv * l] * p[l] / z;
+    }
+  }
+  for (unsigned tile_size : {1u, 2u, 256u}) {
+    dynet::ComputationGraph cg;
+    Expression q = input(cg, Dim({d, n}, bd), q_vals);
+    Expression k = input(cg, Dim({d, m}, bd), k_vals);
+    Expression v = input(cg, {dv, m}, v_vals);
+    Expression mask = input(cg, {m, n}, mask_vals);
+    vector<float> fused = as_vector(scaled_dot_product_attention(q, k, v, mask, tile_size).value());
+    BOOST_REQUIRE_EQUAL(fused.size(), expected.size());
+    for (size_t i = 0; i < fused.size(); ++i)
+      BOOST_CHECK_SMALL(fused[i] - expected[i], 1e-4f);
+  }
+}
+
+// Expression scaled_dot_product_attention(const Expression& q, const Expression& k, const Expression& v, unsigned tile_size = 256);
+BOOST_AUTO_TEST_CASE( scaled_dot_product_attention_gradient ) {
+  dynet::ComputationGraph cg;
+  Expression q = parameter(cg, param_kernel1);
+  Expression k = parameter(cg, param_square1) * 0.5f;
+  Expression v = parameter(cg, param_cube1);
+  Expression y = scaled_dot_product_attention(q, k, reshape(v, {9, 3}), 2);
+  Expression z = squared_norm(y);
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression scaled_dot_product_attention(const Expression& q, const Expression& k, const Expression& v, const Expression& mask, unsigned tile_size = 256);
+BOOST_AUTO_TEST_CASE( scaled_dot_product_attention_batch_gradient ) {
+  BOOST_CHECK(check_batched(Dim({3, 2}, 2), matrix_batch_vals, [this](ComputationGraph& cg, const Expression& x) {
+    return scaled_dot_product_attention(x, parameter(cg, param_square1), parameter(cg, param_square1) * -1.f,
+                                        parameter(cg, param1), 2);
+  }));
+  dynet::ComputationGraph cg;
+  Expression q = parameter(cg, param1) + input(cg, Dim({3}, 2), batch_vals) * 0.2f;
+  Expression k = parameter(cg, param_square1) * 0.5f;
+  Expression v = transpose(parameter(cg, param_kernel1)) + input(cg, Dim({2, 3}, 2), matrix_batch_vals);
+  Expression mask = parameter(cg, param2) * 0.1f;
+  Expression z = sum_batches(squared_norm(scaled_dot_product_attention(q, k, v, mask, 2)) +
+                             squared_norm(scaled_dot_product_attention(q, k, v, mask)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+BOOST_AUTO_TEST_CASE( threaded_device_gradient ) {
+  Device* saved = default_device;
+  Device_CPU_Threaded threaded(devices.size(), DeviceMempoolSizes(10), false, 4);
+  vector<float> results;
+  for (Device* device : {saved, (Device*)&threaded}) {
+    default_device = device;
+    dynet::ComputationGraph cg;
+    Expression x1 = parameter(cg, param_square1);
+    Expression x2 = input(cg, Dim({3}, 2), batch_vals);
+    Expression y = affine_transform({parameter(cg, param1), x1, x2});
+    Expression w = x1 + input(cg, Dim({3, 3}, 2), {.1f, .2f, .3f, .4f, .5f, .6f, .7f, .8f, .9f, -.1f, -.2f, -.3f, -.4f, -.5f, -.6f, -.7f, -.8f, -.9f});
+    Expression z = sum_batches(squared_norm(tanh(x1 * y)) + sum_elems(w * y));
+    results.push_back(as_scalar(z.value()));
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+  default_device = saved;
+  BOOST_CHECK_CLOSE(results[0], results[1], 1e-4);
+}
+
+// Expression select_rows(const Expression& x, vector<unsigned>& rows);
+BOOST_AUTO_TEST_CASE( select_rows_batch ) {
+  vector<unsigned> rows = {2, 0, 2};
+  BOOST_CHECK(check_batched(Dim({3, 2}, 2), matrix_batch_vals,
+                            [&](ComputationGraph& cg, const Expression& x) { return select_rows(x, rows); }));
+  dynet::ComputationGraph cg;
+  Expression x = parameter(cg, param_kernel1) + input(cg, Dim({3, 2}, 2), matrix_batch_vals);
+  Expression z = sum_batches(squared_norm(select_rows(x, rows)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression select_cols(const Expression& x, vector<unsigned>& cols);
+BOOST_AUTO_TEST_CASE( select_cols_batch ) {
+  vector<unsigned> cols = {1, 1, 0};
+  BOOST_CHECK(check_batched(Dim({3, 2}, 2), matrix_batch_vals,
+                            [&](ComputationGraph& cg, const Expression& x) { return select_cols(x, cols); }));
+  dynet::ComputationGraph cg;
+  Expression x = parameter(cg, param_kernel1) + input(cg, Dim({3, 2}, 2), matrix_batch_vals);
+  Expression z = sum_batches(squared_norm(select_cols(x, cols)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression kmh_ngram(const Expression& x, unsigned n);
+BOOST_AUTO_TEST_CASE( kmh_ngram_batch ) {
+  BOOST_CHECK(check_batched(Dim({2, 3}, 2), matrix_batch_vals,
+                            [](ComputationGraph& cg, const Expression& x) { return kmh_ngram(x, 2); }));
+  dynet::ComputationGraph cg;
+  Expression x = reshape(parameter(cg, param4), Dim({2, 3})) + input(cg, Dim({2, 3}, 2), matrix_batch_vals);
+  Expression z = sum_batches(squared_norm(kmh_ngram(x, 2)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression fold_rows(const Expression& x, unsigned nrows=2);
+BOOST_AUTO_TEST_CASE( fold_rows_batch ) {
+  BOOST_CHECK(check_batched(Dim({6}, 2), matrix_batch_vals,
+                            [](ComputationGraph& cg, const Expression& x) { return fold_rows(x, 2); }));
+  dynet::ComputationGraph cg;
+  Expression x = parameter(cg, param4) + input(cg, Dim({6}, 2), matrix_batch_vals);
+  Expression z = sum_batches(squared_norm(fold_rows(x, 3)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression huber_distance(const Expression& x, const Expression& y, float c = 1.345f);
+BOOST_AUTO_TEST_CASE( huber_distance_batch ) {
+  BOOST_CHECK(check_batched(Dim({3}, 4), matrix_batch_vals, [](ComputationGraph& cg, const Expression& x) {
+    return huber_distance(x, input(cg, {3}, {1.f, -.5f, .2f})) + huber_distance(x * -3.f, x, .5f);
+  }));
+  dynet::ComputationGraph cg;
+  Expression x1 = parameter(cg, param1) + input(cg, Dim({3}, 2), batch_vals);
+  Expression x2 = parameter(cg, param2);
+  Expression z = sum_batches(square(huber_distance(x1, x2)) + square(huber_distance(x2, x1 * 0.5f)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression l1_distance(const Expression& x, const Expression& y);
+BOOST_AUTO_TEST_CASE( l1_distance_batch ) {
+  BOOST_CHECK(check_batched(Dim({3}, 4), matrix_batch_vals, [](ComputationGraph& cg, const Expression& x) {
+    return l1_distance(x, input(cg, {3}, {1.f, -.5f, .2f})) + l1_distance(x * -3.f, x);
+  }));
+  dynet::ComputationGraph cg;
+  Expression x1 = parameter(cg, param1) + input(cg, Dim({3}, 2), batch_vals);
+  Expression x2 = parameter(cg, param2);
+  Expression z = sum_batches(square(l1_distance(x1, x2)) + square(l1_distance(x2, x1 * 0.5f)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression binary_log_loss(const Expression& x, const Expression& y);
+BOOST_AUTO_TEST_CASE( binary_log_loss_batch ) {
+  BOOST_CHECK(check_batched(Dim({3}, 4), matrix_batch_vals, [](ComputationGraph& cg, const Expression& x) {
+    return binary_log_loss(logistic(x), input(cg, {3}, {1.f, 0.f, .3f})) + binary_log_loss(logistic(x), logistic(x * -2.f));
+  }));
+  dynet::ComputationGraph cg;
+  Expression x = logistic(parameter(cg, param1) * 0.1f + input(cg, Dim({3}, 2), matrix_batch_vals));
+  Expression z = sum_batches(square(binary_log_loss(x, input(cg, {3}, {1.f, 0.f, .3f}))));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression poisson_loss(const Expression& x, unsigned y);
+BOOST_AUTO_TEST_CASE( poisson_loss_batch ) {
+  BOOST_CHECK(check_batched(Dim({1}, 3), matrix_batch_vals,
+                            [](ComputationGraph& cg, const Expression& x) { return poisson_loss(x, 3); }));
+  dynet::ComputationGraph cg;
+  Expression x = parameter(cg, param_scalar1) * 0.1f + input(cg, Dim({1}, 3), matrix_batch_vals);
+  Expression z = sum_batches(square(poisson_loss(x, 2)));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression log_softmax(const Expression& x, const std::vector<unsigned>& restriction);
+BOOST_AUTO_TEST_CASE( restricted_log_softmax_batch ) {
+  vector<unsigned> restriction = {0, 2};
+  BOOST_CHECK(check_batched(Dim({3}, 4), matrix_batch_vals,
+                            [&](ComputationGraph& cg, const Expression& x) { return log_softmax(x, restriction); }));
+  dynet::ComputationGraph cg;
+  Expression x = parameter(cg, param3) + input(cg, Dim({3}, 2), matrix_batch_vals);
+  Expression y = log_softmax(x, restriction);
+  Expression z = sum_batches(square(pick(y, 0u)) + pick(y, 2u));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression sparsemax(const Expression& x);
+BOOST_AUTO_TEST_CASE( sparsemax_batch ) {
+  BOOST_CHECK(check_batched(Dim({3}, 4), matrix_batch_vals,
+                            [](ComputationGraph& cg, const Expression& x) { return sparsemax(x * 2.f); }));
+  dynet::ComputationGraph cg;
+  Expression x = parameter(cg, param1) * 0.1f + input(cg, Dim({3}, 2), matrix_batch_vals);
+  Expression z = sum_batches(dot_product(sparsemax(x), input(cg, {3}, {1.f, -2.f, .5f})));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Expression contract3d_1d(const Expression& x, const Expression& y, const Expression& b);
+BOOST_AUTO_TEST_CASE( contract3d_1d_batch ) {
+  BOOST_CHECK(check_batched(Dim({3}, 4), matrix_batch_vals, [&](ComputationGraph& cg, const Expression& x) {
+    return contract3d_1d(parameter(cg, param_cube1), x);
+  }));
+  vector<float> cube_vals(27 * 2);
+  for (size_t i = 0; i < cube_vals.size(); ++i) cube_vals[i] = matrix_batch_vals[i % 12] * (i % 5 + 1) * 0.1f;
+  BOOST_CHECK(check_batched(Dim({3, 3, 3}, 2), cube_vals, [&](ComputationGraph& cg, const Expression& x) {
+    return contract3d_1d(x, parameter(cg, param1));
+  }));
+  dynet::ComputationGraph cg;
+  Expression cube = parameter(cg, param_cube1);
+  Expression x = parameter(cg, param1) * 0.1f + input(cg, Dim({3}, 2), matrix_batch_vals);
+  Expression bias = parameter(cg, param_square1) * 0.1f + input(cg, Dim({3, 3}, 2), cube_vals);
+  Expression batch_cube = cube + input(cg, Dim({3, 3, 3}, 2), cube_vals);
+  Expression z1 = sum_batches(squared_norm(contract3d_1d(cube, x, bias)));
+  BOOST_CHECK(check_grad(mod, z1, 0));
+  Expression z2 = sum_batches(squared_norm(contract3d_1d(batch_cube, parameter(cg, param2))));
+  BOOST_CHECK(check_grad(mod, z2, 0));
+}
+
+// Expression weight_norm(x,g);
+BOOST_AUTO_TEST_CASE( weight_norm_batch ) {
+  BOOST_CHECK(check_batched(Dim({3}, 4), matrix_batch_vals, [&](ComputationGraph& cg, const Expression& x) {
+    return weight_norm(x, parameter(cg, param_scalar1));
+  }));
+  dynet::ComputationGraph cg;
+  Expression w = parameter(cg, param1) + input(cg, Dim({3}, 2), matrix_batch_vals);
+  Expression y = weight_norm(w, parameter(cg, param_scalar1));
+  Expression z = sum_batches(dot_product(y, input(cg, {3}, {1.f, -2.f, .5f})));
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
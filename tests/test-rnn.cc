@@ -7,6 +7,8 @@
 #include <dynet/fast-lstm.h>
 #include <dynet/gru.h>
 #include <dynet/grad-check.h>
+#include <dynet/beam-search.h>
+#include <dynet/rnn-state-cache.h>
 #include <boost/test/unit_test.hpp>
 #include "test.h"
 #include <stdexcept>
@@ -92,5 +94,416 @@ BOOST_AUTO_TEST_CASE( vanilla_lstm_ln_gradient ) {
   BOOST_CHECK(check_grad(mod, z, 0));
 }
 
+BOOST_AUTO_TEST_CASE( lstm_stacked_gradient ) {
+  dynet::Model mod;
+  dynet::LSTMBuilder lstm(2, 3, 10, mod, true);
+  dynet::ComputationGraph cg;
+  lstm.new_graph(cg);
+  lstm.start_new_sequence();
+  for (unsigned i = 0; i < 4; i++) {
+    Expression x = dynet::input(cg, Dim({3}), ones_vals);
+    lstm.add_input(x);
+  }
+  Expression z = squared_norm(lstm.final_h()[1]);
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+BOOST_AUTO_TEST_CASE( vanilla_lstm_stacked_gradient ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder vanilla_lstm(2, 3, 10, mod, false, true);
+  dynet::ComputationGraph cg;
+  vanilla_lstm.new_graph(cg);
+  vanilla_lstm.start_new_sequence();
+  for (unsigned i = 0; i < 4; i++) {
+    Expression x = dynet::input(cg, Dim({3}), ones_vals);
+    vanilla_lstm.add_input(x);
+  }
+  Expression z = squared_norm(vanilla_lstm.final_h()[1]);
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+// Both layouts compute the same function once the stacked matrices are
+// filled with the column-major concatenation of the separate ones
+template <class Builder>
+vector<float> run_batched(Builder& rnn, const vector<float>& vals) {
+  dynet::ComputationGraph cg;
+  rnn.new_graph(cg);
+  rnn.start_new_sequence();
+  for (unsigned i = 0; i < 3; i++)
+    rnn.add_input(dynet::input(cg, Dim({3}, 4), vals));
+  return as_vector(rnn.final_h()[1].value());
+}
+
+void stack_params(const vector<Parameter>& from, const vector<Parameter>& to) {
+  vector<float> vals;
+  for (auto& p : from) {
+    vector<float> v = as_vector(p.get()->values);
+    vals.insert(vals.end(), v.begin(), v.end());
+  }
+  TensorTools::set_elements(to[0].get()->values, vals);
+}
+
+BOOST_AUTO_TEST_CASE( lstm_stacked_matches ) {
+  dynet::Model mod;
+  dynet::LSTMBuilder lstm(2, 3, 10, mod), stacked_lstm(2, 3, 10, mod, true);
+  for (unsigned i = 0; i < 2; ++i) {
+    const vector<Parameter>& p = lstm.params[i], & sp = stacked_lstm.params[i];
+    stack_params({p[0], p[1], p[2]}, {sp[0]});
+    stack_params({p[3]}, {sp[1]});
+    stack_params({p[4], p[5], p[6]}, {sp[2]});
+    stack_params({p[7]}, {sp[3]});
+    stack_params({p[8], p[9]}, {sp[4]});
+    stack_params({p[10]}, {sp[5]});
+  }
+  vector<float> vals = {1.f, 0.f, -1.f, .5f, .2f, -.3f, 0.f, 2.f, 1.f, -1.f, -.5f, .3f};
+  vector<float> y = run_batched(lstm, vals), sy = run_batched(stacked_lstm, vals);
+  BOOST_REQUIRE_EQUAL(y.size(), sy.size());
+  for (size_t i = 0; i < y.size(); ++i)
+    BOOST_CHECK_SMALL(y[i] - sy[i], 1e-5f);
+}
+
+BOOST_AUTO_TEST_CASE( vanilla_lstm_stacked_matches ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder lstm(2, 3, 10, mod), stacked_lstm(2, 3, 10, mod, false, true);
+  for (unsigned i = 0; i < 2; ++i) {
+    stack_params({lstm.params[i][0], lstm.params[i][1]}, {stacked_lstm.params[i][0]});
+    stack_params({lstm.params[i][2]}, {stacked_lstm.params[i][1]});
+  }
+  vector<float> vals = {1.f, 0.f, -1.f, .5f, .2f, -.3f, 0.f, 2.f, 1.f, -1.f, -.5f, .3f};
+  vector<float> y = run_batched(lstm, vals), sy = run_batched(stacked_lstm, vals);
+  BOOST_REQUIRE_EQUAL(y.size(), sy.size());
+  for (size_t i = 0; i < y.size(); ++i)
+    BOOST_CHECK_SMALL(y[i] - sy[i], 1e-5f);
+}
+
+// The fused cell computes the same function as the individual operations
+template <class Builder>
+void check_fused_cell(Builder& rnn, dynet::Model& mod) {
+  const vector<float> vals = {1.f, 0.f, -1.f, .5f, .2f, -.3f, 0.f, 2.f, 1.f, -1.f, -.5f, .3f};
+  vector<float> y = run_batched(rnn, vals);
+  rnn.fused_cell = true;
+  vector<float> fy = run_batched(rnn, vals);
+  BOOST_REQUIRE_EQUAL(y.size(), fy.size());
+  for (size_t i = 0; i < y.size(); ++i)
+    BOOST_CHECK_SMALL(y[i] - fy[i], 1e-5f);
+  dynet::ComputationGraph cg;
+  rnn.new_graph(cg);
+  rnn.start_new_sequence();
+  for (unsigned i = 0; i < 4; i++)
+    rnn.add_input(dynet::input(cg, Dim({3}), {1.f, 1.f, 1.f}));
+  Expression z = squared_norm(rnn.final_h()[1]);
+  BOOST_CHECK(check_grad(mod, z, 0));
+}
+
+#define DYNET_RNN_FUSED_CELL_TEST_CASE(name, RNN_TYPE, ...) \
+BOOST_AUTO_TEST_CASE( name ) {                              \
+  dynet::Model mod;                                         \
+  RNN_TYPE rnn(2, 3, 10, mod, ##__VA_ARGS__);               \
+  check_fused_cell(rnn, mod);                               \
+}
+
+DYNET_RNN_FUSED_CELL_TEST_CASE(lstm_fused_cell, dynet::LSTMBuilder)
+
+DYNET_RNN_FUSED_CELL_TEST_CASE(lstm_stacked_fused_cell, dynet::LSTMBuilder, true)
+
+DYNET_RNN_FUSED_CELL_TEST_CASE(vanilla_lstm_fused_cell, dynet::VanillaLSTMBuilder)
+
+DYNET_RNN_FUSED_CELL_TEST_CASE(fast_lstm_fused_cell, dynet::FastLSTMBuilder)
+
+DYNET_RNN_FUSED_CELL_TEST_CASE(gru_fused_cell, dynet::GRUBuilder)
+
+// add_inputs computes the same outputs as a sequence of add_input
+template <class Builder>
+void check_add_inputs(Builder& rnn, dynet::Model& mod) {
+  const vector<float> vals = {1.f, 0.f, -1.f, .5f, .2f, -.3f, 0.f, 2.f, 1.f, -1.f, -.5f, .3f, .1f, .7f, -.2f, .4f, 0.f, -.6f};
+  dynet::ComputationGraph cg;
+  rnn.new_graph(cg);
+  vector<Expression> xs;
+  for (unsigned t = 0; t < 3; ++t)
+    xs.push_back(dynet::input(cg, Dim({3}, 2), vector<float>(vals.begin() + 6 * t, vals.begin() + 6 * (t + 1))));
+  rnn.start_new_sequence();
+  vector<Expression> ys;
+  for (auto & x : xs)
+    ys.push_back(rnn.add_input(x));
+  vector<float> y_last = as_vector(rnn.final_h()[0].value());
+  rnn.start_new_sequence();
+  vector<Expression> zs = rnn.add_inputs(xs);
+  vector<float> z_last = as_vector(rnn.final_h()[0].value());
+  BOOST_REQUIRE_EQUAL(ys.size(), zs.size());
+  vector<Expression> losses;
+  for (size_t t = 0; t < ys.size(); ++t) {
+    vector<float> y = as_vector(ys[t].value()), z = as_vector(zs[t].value());
+    BOOST_REQUIRE_EQUAL(y.size(), z.size());
+    for (size_t i = 0; i < y.size(); ++i)
+      BOOST_CHECK_SMALL(y[i] - z[i], 1e-5f);
+    losses.push_back(squared_norm(zs[t]));
+  }
+  for (size_t i = 0; i < y_last.size(); ++i)
+    BOOST_CHECK_SMALL(y_last[i] - z_last[i], 1e-5f);
+  Expression l = sum_batches(sum(losses));
+  BOOST_CHECK(check_grad(mod, l, 0));
+}
+
+#define DYNET_RNN_ADD_INPUTS_TEST_CASE(name, RNN_TYPE, ...) \
+BOOST_AUTO_TEST_CASE( name ) {                              \
+  dynet::Model mod;                                         \
+  RNN_TYPE rnn(2, 3, 10, mod, ##__VA_ARGS__);               \
+  check_add_inputs(rnn, mod);                               \
+}
+
+DYNET_RNN_ADD_INPUTS_TEST_CASE(lstm_add_inputs, dynet::LSTMBuilder)
+
+DYNET_RNN_ADD_INPUTS_TEST_CASE(lstm_stacked_add_inputs, dynet::LSTMBuilder, true)
+
+DYNET_RNN_ADD_INPUTS_TEST_CASE(vanilla_lstm_add_inputs, dynet::VanillaLSTMBuilder)
+
+DYNET_RNN_ADD_INPUTS_TEST_CASE(vanilla_lstm_stacked_add_inputs, dynet::VanillaLSTMBuilder, false, true)
+
+DYNET_RNN_ADD_INPUTS_TEST_CASE(gru_add_inputs, dynet::GRUBuilder)
+
+BOOST_AUTO_TEST_CASE( gru_fused_add_inputs ) {
+  dynet::Model mod;
+  dynet::GRUBuilder rnn(2, 3, 10, mod);
+  rnn.fused_cell = true;
+  check_add_inputs(rnn, mod);
+}
+
+BOOST_AUTO_TEST_CASE( vanilla_lstm_sequence_node ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder rnn(2, 3, 10, mod);
+  rnn.sequence_node = true;
+  check_add_inputs(rnn, mod);
+}
+
+BOOST_AUTO_TEST_CASE( vanilla_lstm_stacked_sequence_node ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder rnn(2, 3, 10, mod, false, true);
+  rnn.sequence_node = true;
+  check_add_inputs(rnn, mod);
+}
+
+BOOST_AUTO_TEST_CASE( gru_sequence_node ) {
+  dynet::Model mod;
+  dynet::GRUBuilder rnn(2, 3, 10, mod);
+  rnn.sequence_node = true;
+  check_add_inputs(rnn, mod);
+}
+
+// The sequence node continues from the current state and keeps the state of every step
+BOOST_AUTO_TEST_CASE( vanilla_lstm_sequence_node_state ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder rnn(2, 3, 10, mod);
+  dynet::ComputationGraph cg;
+  rnn.new_graph(cg);
+  vector<Expression> xs;
+  for (unsigned t = 0; t < 3; ++t)
+    xs.push_back(dynet::input(cg, Dim({3}), {.1f * t, -.2f, .3f}));
+  rnn.start_new_sequence();
+  for (auto & x : xs)
+    rnn.add_input(x);
+  vector<float> c = as_vector(rnn.get_s(RNNPointer(1))[0].value()), h = as_vector(rnn.final_h()[1].value());
+  rnn.sequence_node = true;
+  rnn.start_new_sequence();
+  rnn.add_input(xs[0]);
+  rnn.add_inputs({xs[1], xs[2]});
+  BOOST_CHECK_EQUAL((int)rnn.state(), 2);
+  vector<float> sc = as_vector(rnn.get_s(RNNPointer(1))[0].value()), sh = as_vector(rnn.final_h()[1].value());
+  for (size_t i = 0; i < c.size(); ++i)
+    BOOST_CHECK_SMALL(c[i] - sc[i], 1e-5f);
+  for (size_t i = 0; i < h.size(); ++i)
+    BOOST_CHECK_SMALL(h[i] - sh[i], 1e-5f);
+}
+
+// Each sequence of a packed batch gets the same outputs and final state as on its own
+template <class Builder>
+void check_packed_inputs(Builder& rnn, dynet::Model& mod) {
+  const vector<vector<float>> seqs = {{1.f, 0.f, -1.f, .5f, .2f, -.3f, 0.f, 2.f, 1.f},
+                                      {-1.f, -.5f, .3f, .1f, .7f, -.2f},
+                                      {.4f, 0.f, -.6f}};
+  dynet::ComputationGraph cg;
+  rnn.new_graph(cg);
+  vector<vector<vector<float>>> ref_y(seqs.size());
+  vector<vector<float>> ref_h(seqs.size());
+  for (size_t b = 0; b < seqs.size(); ++b) {
+    rnn.start_new_sequence();
+    for (size_t t = 0; t < seqs[b].size() / 3; ++t) {
+      Expression y = rnn.add_input(dynet::input(cg, Dim({3}), vector<float>(seqs[b].begin() + 3 * t, seqs[b].begin() + 3 * (t + 1))));
+      ref_y[b].push_back(as_vector(y.value()));
+    }
+    ref_h[b] = as_vector(rnn.final_h().back().value());
+  }
+  vector<Expression> xs;
+  for (size_t t = 0; t < seqs[0].size() / 3; ++t) {
+    vector<float> vals;
+    unsigned active = 0;
+    for (; active < seqs.size() && seqs[active].size() > 3 * t; ++active)
+      vals.insert(vals.end(), seqs[active].begin() + 3 * t, seqs[active].begin() + 3 * (t + 1));
+    xs.push_back(dynet::input(cg, Dim({3}, active), vals));
+  }
+  rnn.start_new_sequence();
+  vector<Expression> ys = rnn.add_packed_inputs(xs);
+  BOOST_REQUIRE_EQUAL(ys.size(), xs.size());
+  vector<Expression> losses;
+  for (size_t t = 0; t < ys.size(); ++t) {
+    vector<float> y = as_vector(ys[t].value());
+    const size_t hid = ref_y[0][t].size();
+    BOOST_REQUIRE_EQUAL(y.size(), hid * xs[t].dim().bd);
+    for (size_t b = 0; b < xs[t].dim().bd; ++b)
+      for (size_t i = 0; i < hid; ++i)
+        BOOST_CHECK_SMALL(y[b * hid + i] - ref_y[b][t][i], 1e-5f);
+    losses.push_back(sum_batches(squared_norm(ys[t])));
+  }
+  vector<float> h = as_vector(rnn.final_h().back().value());
+  BOOST_REQUIRE_EQUAL(h.size(), ref_h[0].size() * seqs.size());
+  for (size_t b = 0; b < seqs.size(); ++b)
+    for (size_t i = 0; i < ref_h[b].size(); ++i)
+      BOOST_CHECK_SMALL(h[b * ref_h[b].size() + i] - ref_h[b][i], 1e-5f);
+  losses.push_back(sum_batches(squared_norm(rnn.final_h().back())));
+  Expression l = sum(losses);
+  BOOST_CHECK(check_grad(mod, l, 0));
+}
+
+#define DYNET_RNN_PACKED_INPUTS_TEST_CASE(name, RNN_TYPE, ...) \
+BOOST_AUTO_TEST_CASE( name ) {                                 \
+  dynet::Model mod;                                            \
+  RNN_TYPE rnn(2, 3, 10, mod, ##__VA_ARGS__);                  \
+  check_packed_inputs(rnn, mod);                               \
+}
+
+DYNET_RNN_PACKED_INPUTS_TEST_CASE(lstm_packed_inputs, dynet::LSTMBuilder)
+
+DYNET_RNN_PACKED_INPUTS_TEST_CASE(vanilla_lstm_packed_inputs, dynet::VanillaLSTMBuilder)
+
+DYNET_RNN_PACKED_INPUTS_TEST_CASE(gru_packed_inputs, dynet::GRUBuilder)
+
+BOOST_AUTO_TEST_CASE( rnn_add_inputs_matrix ) {
+  dynet::Model mod;
+  dynet::SimpleRNNBuilder rnn(1, 3, 4, mod);
+  dynet::ComputationGraph cg;
+  rnn.new_graph(cg);
+  rnn.start_new_sequence();
+  vector<Expression> ys = rnn.add_inputs(dynet::input(cg, Dim({3, 2}), {1.f, 0.f, -1.f, .5f, .2f, -.3f}));
+  BOOST_CHECK_EQUAL(ys.size(), 2u);
+  BOOST_CHECK_EQUAL((int)rnn.state(), 1);
+}
+
+// The log probability of an output sequence under the model used by the beam search tests
+static float beam_test_score(dynet::Model& mod, dynet::RNNBuilder& rnn, LookupParameter p_e, Parameter p_w, Parameter p_b,
+                             unsigned sos, const vector<unsigned>& words) {
+  dynet::ComputationGraph cg;
+  rnn.new_graph(cg);
+  rnn.start_new_sequence();
+  Expression w = parameter(cg, p_w), b = parameter(cg, p_b);
+  vector<Expression> lps;
+  unsigned prev = sos;
+  for (auto word : words) {
+    Expression h = rnn.add_input(lookup(cg, p_e, prev));
+    lps.push_back(pick(log_softmax(affine_transform({b, w, h})), word));
+    prev = word;
+  }
+  return as_scalar(cg.forward(sum(lps)));
+}
+
+// With a beam wide enough to keep everything, the beam search scores every
+// possible output
+BOOST_AUTO_TEST_CASE( beam_search_exhaustive ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder rnn(1, 2, 3, mod);
+  LookupParameter p_e = mod.add_lookup_parameters(4, {2});
+  Parameter p_w = mod.add_parameters({4, 3}), p_b = mod.add_parameters({4});
+  const unsigned sos = 0, eos = 3, max_len = 3;
+  // Outputs stop at the end symbol or after max_len words
+  vector<vector<unsigned>> outputs, partial(1);
+  for (unsigned len = 1; len <= max_len; ++len) {
+    vector<vector<unsigned>> longer;
+    for (auto& prefix : partial) {
+      for (unsigned word = 0; word < 4; ++word) {
+        vector<unsigned> output(prefix);
+        output.push_back(word);
+        (word == eos || len == max_len ? outputs : longer).push_back(output);
+      }
+    }
+    partial.swap(longer);
+  }
+  vector<float> scores;
+  for (auto& output : outputs)
+    scores.push_back(beam_test_score(mod, rnn, p_e, p_w, p_b, sos, output));
+  const unsigned best = max_element(scores.begin(), scores.end()) - scores.begin();
+
+  for (unsigned beam_size : {1u, 64u}) {
+    dynet::ComputationGraph cg;
+    rnn.new_graph(cg);
+    Expression w = parameter(cg, p_w), b = parameter(cg, p_b);
+    BeamSearchDecoder decoder(rnn,
+                              [&](ComputationGraph& g, const vector<unsigned>& ws) { return lookup(g, p_e, ws); },
+                              [&](const Expression& h) { return log_softmax(affine_transform({b, w, h})); },
+                              beam_size, eos, max_len);
+    vector<BeamHypothesis> hyps = decoder.decode(cg, sos);
+    BOOST_REQUIRE_EQUAL(hyps.size(), min<size_t>(beam_size, outputs.size()));
+    for (auto& hyp : hyps) {
+      const unsigned i = find(outputs.begin(), outputs.end(), hyp.words) - outputs.begin();
+      BOOST_REQUIRE(i < outputs.size());
+      BOOST_CHECK_CLOSE(hyp.score, scores[i], 1e-3);
+    }
+    if (beam_size > 1)
+      DYNET_CHECK_EQUAL(hyps[0].words, outputs[best]);
+  }
+}
+
+// Continuing from a cached state gives the same output as reading the whole
+// sequence in one graph
+BOOST_AUTO_TEST_CASE( rnn_state_cache_continue ) {
+  dynet::Model mod;
+  dynet::VanillaLSTMBuilder rnn(2, 3, 4, mod);
+  vector<float> expected;
+  {
+    dynet::ComputationGraph cg;
+    rnn.new_graph(cg);
+    rnn.start_new_sequence();
+    for (unsigned t = 0; t < 4; ++t)
+      rnn.add_input(dynet::input(cg, Dim({3}), {.1f * t, -.2f, .3f}));
+    expected = as_vector(rnn.back().value());
+  }
+  RNNStateCache cache(2);
+  {
+    dynet::ComputationGraph cg;
+    rnn.new_graph(cg);
+    rnn.start_new_sequence();
+    for (unsigned t = 0; t < 2; ++t)
+      rnn.add_input(dynet::input(cg, Dim({3}), {.1f * t, -.2f, .3f}));
+    cache.put("session", RNNStateSnapshot::capture(rnn));
+  }
+  dynet::ComputationGraph cg;
+  rnn.new_graph(cg);
+  const RNNStateSnapshot* state = cache.get("session");
+  BOOST_REQUIRE(state != nullptr);
+  BOOST_CHECK_EQUAL(state->size(), 4u * 4u);
+  rnn.start_new_sequence(state->restore(cg));
+  for (unsigned t = 2; t < 4; ++t)
+    rnn.add_input(dynet::input(cg, Dim({3}), {.1f * t, -.2f, .3f}));
+  vector<float> actual = as_vector(rnn.back().value());
+  for (unsigned i = 0; i < expected.size(); ++i)
+    BOOST_CHECK_CLOSE(expected[i], actual[i], 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE( rnn_state_cache_lru ) {
+  RNNStateCache cache(2);
+  RNNStateSnapshot state;
+  state.dims.push_back(Dim({1}));
+  for (auto session : {"a", "b"}) {
+    state.values = {session[0] * 1.f};
+    cache.put(session, state);
+  }
+  BOOST_CHECK(cache.get("a") != nullptr);
+  // "b" is now the least recently used
+  cache.put("c", state);
+  BOOST_CHECK_EQUAL(cache.size(), 2u);
+  BOOST_CHECK(cache.get("b") == nullptr);
+  BOOST_REQUIRE(cache.get("a") != nullptr);
+  BOOST_CHECK_EQUAL(cache.get("a")->values[0], 'a' * 1.f);
+  cache.erase("a");
+  BOOST_CHECK(cache.get("a") == nullptr);
+  BOOST_CHECK(cache.get("c") != nullptr);
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,103 @@
+#define BOOST_TEST_MODULE TEST_SOFTMAX
+
+#include <dynet/dynet.h>
+#include <dynet/expr.h>
+#include <dynet/dict.h>
+#include <dynet/cfsm-builder.h>
+#include <dynet/hsm-builder.h>
+#include <dynet/grad-check.h>
+#include <boost/test/unit_test.hpp>
+#include "test.h"
+#include <stdexcept>
+#include <fstream>
+
+using namespace dynet;
+using namespace dynet::expr;
+using namespace std;
+
+
+struct SoftmaxTest {
+  SoftmaxTest() {
+    // initialize if necessary
+    if (default_device == nullptr) {
+      for (auto x : {"SoftmaxTest", "--dynet-mem", "10"}) {
+        av.push_back(strdup(x));
+      }
+      char **argv = &av[0];
+      int argc = av.size();
+      dynet::initialize(argc, argv);
+    }
+    // Two clusters of several words, and a singleton cluster
+    cfsm_file = "softmax-test.cfsm";
+    ofstream cfsm(cfsm_file);
+    cfsm << "c1 a\nc1 b\nc2 c\nc3 d\nc3 e\nc3 f\n";
+    // Leaves with two words, one word and three words at different depths
+    hsm_file = "softmax-test.hsm";
+    ofstream hsm(hsm_file);
+    hsm << "0 0\ta\n0 0\tb\n0 1\tc\n1\td\n1\te\n1\tf\n";
+    rep_vals = {0.1f, -0.5f, 0.3f, 0.7f, 0.2f, -0.4f, -0.6f, 0.2f, 0.1f,
+                0.4f, 0.4f, -0.3f, 0.2f, -0.1f, 0.5f, -0.2f, 0.6f, 0.3f};
+  }
+  ~SoftmaxTest() {
+    for (auto x : av) free(x);
+  }
+
+  // Checks the batched neg_log_softmax against one call per batch element,
+  // and its gradient
+  void check_batched_softmax(Model& mod, SoftmaxBuilder& sm, const vector<unsigned>& words) {
+    const unsigned bd = words.size();
+    vector<float> losses;
+    {
+      ComputationGraph cg;
+      sm.new_graph(cg);
+      Expression rep = input(cg, Dim({3}, bd), rep_vals);
+      for (unsigned i = 0; i < bd; ++i)
+        losses.push_back(as_scalar(sm.neg_log_softmax(pick_batch_elem(rep, i), words[i]).value()));
+    }
+    ComputationGraph cg;
+    sm.new_graph(cg);
+    Expression rep = input(cg, Dim({3}, bd), rep_vals);
+    Expression batched = sm.neg_log_softmax(rep, words);
+    vector<float> batched_losses = as_vector(batched.value());
+    BOOST_REQUIRE_EQUAL(batched_losses.size(), bd);
+    for (unsigned i = 0; i < bd; ++i)
+      BOOST_CHECK_CLOSE(losses[i], batched_losses[i], 1e-3);
+    Expression z = sum_batches(batched);
+    BOOST_CHECK(check_grad(mod, z, 0));
+  }
+
+  std::string cfsm_file, hsm_file;
+  std::vector<float> rep_vals;
+  std::vector<char*> av;
+};
+
+// define the test suite
+BOOST_FIXTURE_TEST_SUITE(softmax_test, SoftmaxTest);
+
+BOOST_AUTO_TEST_CASE( cfsm_batched ) {
+  Model mod;
+  Dict d;
+  ClassFactoredSoftmaxBuilder sm(3, cfsm_file, d, mod);
+  vector<unsigned> words;
+  for (auto w : {"a", "d", "c", "b", "f", "d"})
+    words.push_back(d.convert(w));
+  check_batched_softmax(mod, sm, words);
+}
+
+BOOST_AUTO_TEST_CASE( hsm_batched ) {
+  Model mod;
+  Dict d;
+  HierarchicalSoftmaxBuilder sm(3, hsm_file, d, mod);
+  vector<unsigned> words;
+  for (auto w : {"a", "d", "c", "b", "f", "d"})
+    words.push_back(d.convert(w));
+  check_batched_softmax(mod, sm, words);
+}
+
+BOOST_AUTO_TEST_CASE( standard_batched ) {
+  Model mod;
+  StandardSoftmaxBuilder sm(3, 6, mod);
+  check_batched_softmax(mod, sm, {0, 3, 2, 1, 5, 3});
+}
+
+BOOST_AUTO_TEST_SUITE_END()
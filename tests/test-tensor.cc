@@ -67,4 +67,57 @@ BOOST_AUTO_TEST_CASE( categorical_sample_log_prob ) {
   vector<Eigen::DenseIndex> idx_exp = {0, 2};
 }
 
+// test whether top-k returns the right values and IDs for every batch element
+BOOST_AUTO_TEST_CASE( topk ) {
+  dynet::ComputationGraph cg;
+  Expression x1 = input(cg, Dim({ 3 }, 2), batch_vals);
+  pair<Tensor, IndexTensor> top = TensorTools::topk(x1.value(), 2);
+  BOOST_CHECK_EQUAL(top.first.d, Dim({2}, 2));
+  vector<float> val_act = as_vector(top.first);
+  vector<float> val_exp = {2.f, 1.f, 6.f, 5.f};
+  BOOST_CHECK_EQUAL_COLLECTIONS(val_exp.begin(), val_exp.end(),
+                                val_act.begin(), val_act.end());
+  // ties go to the lower ID
+  vector<Eigen::DenseIndex> idx_act = as_vector(top.second);
+  vector<Eigen::DenseIndex> idx_exp = {1, 0, 2, 1};
+  BOOST_CHECK_EQUAL_COLLECTIONS(idx_exp.begin(), idx_exp.end(),
+                                idx_act.begin(), idx_act.end());
+  idx_act = as_vector(TensorTools::argmax(x1.value(), 0, 2));
+  BOOST_CHECK_EQUAL_COLLECTIONS(idx_exp.begin(), idx_exp.end(),
+                                idx_act.begin(), idx_act.end());
+}
+
+// test top-k over the columns of a matrix
+BOOST_AUTO_TEST_CASE( topk_dim1 ) {
+  dynet::ComputationGraph cg;
+  Expression x1 = input(cg, Dim({ 2, 3 }), batch_vals);
+  pair<Tensor, IndexTensor> top = TensorTools::topk(x1.value(), 2, 1);
+  vector<float> val_act = as_vector(top.first);
+  vector<float> val_exp = {5.f, 6.f, 1.f, 4.f};
+  BOOST_CHECK_EQUAL_COLLECTIONS(val_exp.begin(), val_exp.end(),
+                                val_act.begin(), val_act.end());
+  vector<Eigen::DenseIndex> idx_act = as_vector(top.second);
+  vector<Eigen::DenseIndex> idx_exp = {2, 2, 0, 1};
+  BOOST_CHECK_EQUAL_COLLECTIONS(idx_exp.begin(), idx_exp.end(),
+                                idx_act.begin(), idx_act.end());
+}
+
+// test whether several samples per batch element follow the distribution
+BOOST_AUTO_TEST_CASE( categorical_sample_log_prob_num ) {
+  dynet::ComputationGraph cg;
+  vector<float> log_probs = {log(0.2f), log(0.8f), -1e10f, 0.f, -1e10f, 0.f};
+  Expression x1 = input(cg, Dim({ 3 }, 2), log_probs);
+  IndexTensor idx_tens = TensorTools::categorical_sample_log_prob(x1.value(), 0, 1000);
+  BOOST_CHECK_EQUAL(idx_tens.d, Dim({1000}, 2));
+  vector<Eigen::DenseIndex> idx_act = as_vector(idx_tens);
+  unsigned ones = 0, twos = 0;
+  for (unsigned i = 0; i < 1000; ++i) {
+    BOOST_CHECK(idx_act[i] == 0 || idx_act[i] == 1);
+    ones += (idx_act[i] == 1);
+    twos += (idx_act[1000 + i] == 2);
+  }
+  BOOST_CHECK(ones > 700 && ones < 900);
+  BOOST_CHECK(twos > 400 && twos < 600);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
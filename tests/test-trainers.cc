@@ -4,8 +4,13 @@
 #include <dynet/expr.h>
 #include <dynet/training.h>
 #include <dynet/grad-check.h>
+#include <dynet/hogwild.h>
+#include <dynet/data-parallel.h>
+#include <dynet/grad-compression.h>
+#include <dynet/param-server.h>
 #include <boost/test/unit_test.hpp>
 #include <stdexcept>
+#include <thread>
 
 using namespace dynet;
 using namespace dynet::expr;
@@ -44,6 +49,21 @@ struct TrainerTest {
   std::vector<char*> av;
 };
 
+struct TanhLearner {
+  TanhLearner(Parameter p, LookupParameter lp, const vector<float>& ones) : p(p), lp(lp), ones(ones) {}
+  float LearnFromDatum(unsigned datum, bool learn) {
+    dynet::ComputationGraph cg;
+    Expression y = input(cg, {1,3}, ones);
+    Expression z = y * tanh(parameter(cg, p) + lookup(cg, lp, datum));
+    float loss = as_scalar(cg.forward(z));
+    if (learn) cg.backward(z);
+    return loss;
+  }
+  Parameter p;
+  LookupParameter lp;
+  vector<float> ones;
+};
+
 // define the test suite
 BOOST_FIXTURE_TEST_SUITE(trainer_test, TrainerTest);
 
@@ -183,4 +203,132 @@ BOOST_AUTO_TEST_CASE( adam_direction ) {
   BOOST_CHECK_LT(after, before);
 }
 
+BOOST_AUTO_TEST_CASE( hogwild_sgd_direction ) {
+  dynet::Model mod;
+  dynet::Parameter param = mod.add_parameters({3});
+  dynet::LookupParameter lparam = mod.add_lookup_parameters(4, {3});
+  TensorTools::set_elements(param.get()->values,param_vals);
+  vector<float> unused_row = as_vector(lparam.get()->values[3]);
+  SimpleSGDTrainer trainer(mod);
+  TanhLearner l1(param, lparam, ones_vals), l2(param, lparam, ones_vals);
+  vector<TanhLearner*> learners = {&l1, &l2};
+  vector<unsigned> data = {0, 1, 2, 0, 1, 2};
+  float before = run_hogwild(learners, trainer, data);
+  float after = run_hogwild(learners, trainer, data);
+  BOOST_CHECK_LT(after, before);
+  BOOST_CHECK_EQUAL(trainer.updates, 12);
+  // updates go straight to the values, the shared gradients are untouched
+  BOOST_CHECK_EQUAL(mod.gradient_l2_norm(), 0.f);
+  vector<float> row = as_vector(lparam.get()->values[3]);
+  for (unsigned i = 0; i < row.size(); ++i)
+    BOOST_CHECK_EQUAL(row[i], unused_row[i]);
+}
+
+BOOST_AUTO_TEST_CASE( data_parallel_deterministic ) {
+  vector<unsigned> data = {0, 1, 2, 3, 0, 1, 2, 3, 3, 2};
+  std::mt19937 saved = *rndeng;
+  vector<vector<float> > results;
+  for (unsigned num_threads : {1, 3}) {
+    *rndeng = saved;
+    dynet::Model mod;
+    dynet::Parameter param = mod.add_parameters({3});
+    dynet::LookupParameter lparam = mod.add_lookup_parameters(4, {3});
+    TensorTools::set_elements(param.get()->values,param_vals);
+    TensorTools::set_elements(lparam.get()->all_values,{.1f,.2f,.3f,-.1f,-.2f,-.3f,.5f,.4f,.3f,-.5f,.1f,.2f});
+    MomentumSGDTrainer trainer(mod);
+    vector<TanhLearner> ls(num_threads, TanhLearner(param, lparam, ones_vals));
+    vector<TanhLearner*> learners;
+    for (auto & l : ls) learners.push_back(&l);
+    float before = run_data_parallel(learners, trainer, data, 4, 4);
+    float after = run_data_parallel(learners, trainer, data, 4, 4);
+    BOOST_CHECK_LT(after, before);
+    BOOST_CHECK_EQUAL(trainer.updates, 6);
+    vector<float> vals = as_vector(param.get()->values);
+    for (auto v : as_vector(lparam.get()->all_values)) vals.push_back(v);
+    results.push_back(vals);
+  }
+  BOOST_CHECK(results[0] == results[1]);
+}
+
+BOOST_AUTO_TEST_CASE( param_server_matches_local ) {
+  vector<unsigned> data = {0, 1, 2, 0, 1, 2, 1};
+  // server models, worker replica and local reference all start identical
+  vector<dynet::Model> mods(4);
+  vector<Parameter> params;
+  vector<LookupParameter> lparams;
+  for (auto & mod : mods) {
+    params.push_back(mod.add_parameters({3}));
+    lparams.push_back(mod.add_lookup_parameters(4, {3}));
+    TensorTools::set_elements(params.back().get()->values,param_vals);
+    TensorTools::set_elements(lparams.back().get()->all_values,{.1f,.2f,.3f,-.1f,-.2f,-.3f,.5f,.4f,.3f,-.5f,.1f,.2f});
+  }
+  vector<float> unused_row = as_vector(lparams[1].get()->values[3]);
+  SimpleSGDTrainer t0(mods[0]), t1(mods[1]), local_trainer(mods[3]);
+  // clipping would only see the norm of each shard
+  t0.clipping_enabled = t1.clipping_enabled = local_trainer.clipping_enabled = false;
+  dynet::ps::ParameterServer s0(mods[0], t0, 0, 2), s1(mods[1], t1, 1, 2);
+  std::thread th0([&]() { s0.serve(1); }), th1([&]() { s1.serve(1); });
+  {
+    dynet::ps::ParameterClient client(mods[2], {{"localhost", s0.port()}, {"localhost", s1.port()}}, 2);
+    TanhLearner remote(params[2], lparams[2], ones_vals), local(params[3], lparams[3], ones_vals);
+    for (auto datum : data) {
+      remote.LearnFromDatum(datum, true);
+      client.update();
+      local.LearnFromDatum(datum, true);
+      local_trainer.update();
+    }
+    client.pull();
+  }
+  th0.join();
+  th1.join();
+  // shard 1 owns no dense parameter and only sees pushes for row 1
+  BOOST_CHECK_EQUAL(t0.updates, 7);
+  BOOST_CHECK_EQUAL(t1.updates, 3);
+  vector<float> local_vals = as_vector(params[3].get()->values);
+  vector<float> remote_vals = as_vector(params[2].get()->values);
+  vector<float> server_vals = as_vector(params[0].get()->values);
+  for (unsigned i = 0; i < 3; ++i) {
+    BOOST_CHECK_CLOSE(remote_vals[i], local_vals[i], 1e-4);
+    BOOST_CHECK_CLOSE(server_vals[i], local_vals[i], 1e-4);
+  }
+  for (unsigned r = 0; r < 4; ++r) {
+    vector<float> local_row = as_vector(lparams[3].get()->values[r]);
+    vector<float> remote_row = as_vector(lparams[2].get()->values[r]);
+    vector<float> server_row = as_vector(lparams[r % 2].get()->values[r]);
+    for (unsigned i = 0; i < 3; ++i) {
+      BOOST_CHECK_CLOSE(remote_row[i], local_row[i], 1e-4);
+      BOOST_CHECK_CLOSE(server_row[i], local_row[i], 1e-4);
+    }
+  }
+  vector<float> row = as_vector(lparams[1].get()->values[3]);
+  for (unsigned i = 0; i < row.size(); ++i)
+    BOOST_CHECK_EQUAL(row[i], unused_row[i]);
+}
+
+BOOST_AUTO_TEST_CASE( gradient_compression_error_feedback ) {
+  dynet::Model mod;
+  dynet::Parameter param = mod.add_parameters({50});
+  vector<float> g(50);
+  for (unsigned i = 0; i < g.size(); ++i) g[i] = 0.01f * (i % 7) - 0.02f * (i % 3);
+  const unsigned steps = 400;
+  for (auto type : {GradientCompression::NONE, GradientCompression::TOPK,
+                    GradientCompression::INT8, GradientCompression::SIGN}) {
+    GradientCompressor compressor(type, 0.1);
+    vector<float> sum(g.size(), 0.f);
+    size_t max_bytes = 0;
+    for (unsigned t = 0; t < steps; ++t) {
+      TensorTools::set_elements(param.get()->g, g);
+      vector<char> buf;
+      compressor.encode(param.get(), buf);
+      max_bytes = std::max(max_bytes, buf.size());
+      GradientCompressor::decode(type, &buf[0], buf.size(), &sum[0], sum.size());
+    }
+    if (type != GradientCompression::NONE)
+      BOOST_CHECK_LT(max_bytes, g.size() * sizeof(float));
+    // what was not sent yet is carried over, so the average converges
+    for (unsigned i = 0; i < g.size(); ++i)
+      BOOST_CHECK_SMALL(sum[i] / steps - g[i], 2e-3f);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()